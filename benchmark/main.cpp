@@ -0,0 +1,319 @@
+#include "assembler.hpp"
+#include "instruction_set.hpp"
+#include "simd_scan.hpp"
+
+// std
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace cforge;
+
+// Counts every heap allocation so the encoder benchmark can report them
+static std::atomic<size_t> g_allocations{0};
+
+void *operator new(size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *ptr = std::malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { std::free(ptr); }
+
+namespace
+{
+    /**
+     * @brief Builds a synthetic assembly source of roughly `target_bytes` bytes.
+     * The mix of labels, instructions, data and comments mirrors generated code.
+     */
+    std::string GenerateSource(size_t target_bytes)
+    {
+        std::string source;
+        source.reserve(target_bytes + 256);
+        source += "    .section .data\n";
+
+        size_t i = 0;
+        while (source.size() < target_bytes)
+        {
+            std::string n = std::to_string(i++);
+            source += "table_" + n + ":\n";
+            source += "    .word 0x12345678, 0b1010, 42, 0xDEADBEEF # table entry " + n + "\n";
+            source += "    .byte 0x01, 0x02, 0x03, 0x04\n";
+            source += "loop_" + n + ":\n";
+            source += "\taddi x1, zero, 1\n";
+            source += "\tadd  a0, a1, a2      # accumulate\n";
+            source += "\tj loop_" + n + "\n";
+            source += "\n";
+        }
+        return source;
+    }
+
+    bool SameTokens(const TokenBuffer &a, const TokenBuffer &b)
+    {
+        if (a.size() != b.size())
+            return false;
+        for (size_t i = 0; i < a.size(); ++i)
+        {
+            if (a.type(i) != b.type(i) ||
+                a.offset(i) != b.offset(i) ||
+                a.value(i) != b.value(i))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Returns the best-of-`runs` throughput in MB/s, chunked on `pool` if given
+    double MeasureLexer(Lexer &lexer, size_t bytes, int runs, ThreadPool *pool = nullptr, size_t chunks = 0)
+    {
+        double best = 0.0;
+        for (int run = 0; run < runs; ++run)
+        {
+            auto begin = std::chrono::steady_clock::now();
+            if (pool != nullptr)
+            {
+                lexer.AnalyzeParallel(*pool, chunks);
+            }
+            else
+            {
+                lexer.Analyze();
+            }
+            auto end = std::chrono::steady_clock::now();
+
+            double seconds = std::chrono::duration<double>(end - begin).count();
+            double mbps = (static_cast<double>(bytes) / (1024.0 * 1024.0)) / seconds;
+            best = mbps > best ? mbps : best;
+        }
+        return best;
+    }
+
+    struct EncoderSample
+    {
+        Mnemonic mnemonic;
+        std::array<std::string_view, 3> operands;
+        size_t operand_count;
+    };
+
+    // Instruction mix for the encoder benchmark, includes relocating ones
+    const EncoderSample kEncoderSamples[] = {
+        {Mnemonic::ADD, {"a0", "a1", "a2"}, 3},
+        {Mnemonic::SUB, {"t0", "t1", "t2"}, 3},
+        {Mnemonic::ADDI, {"x1", "zero", "1"}, 3},
+        {Mnemonic::XORI, {"s1", "s2", "0x7F"}, 3},
+        {Mnemonic::JAL, {"ra", "loop", ""}, 2},
+        {Mnemonic::LA, {"a0", "table", ""}, 2},
+        {Mnemonic::J, {"loop", "", ""}, 1},
+    };
+
+    struct EncoderResult
+    {
+        double instructions_per_second;
+        double allocations_per_instruction;
+        uint64_t checksum; // Sum of the encoded bytes, equal for both encoders
+    };
+
+    /**
+     * @brief Encodes `count` instructions from the sample mix, either through
+     * `CompileInstruction` (one `CompiledInstruction` per call) or through
+     * `EncodeInstruction` into a pre-reserved buffer.
+     */
+    EncoderResult MeasureEncoder(bool allocation_free, size_t count, int runs)
+    {
+        constexpr size_t kSamples = sizeof(kEncoderSamples) / sizeof(kEncoderSamples[0]);
+        EncoderResult best{0.0, 0.0, 0};
+        for (int run = 0; run < runs; ++run)
+        {
+            AssemblyContext context;
+            context.current_section = context.SectionNamed(".text");
+            std::vector<uint8_t> code(count * InstructionSet::kMaxInstructionSize);
+            context.relocations.reserve(count);
+            uint8_t *out = code.data();
+            uint64_t checksum = 0; // Consumes the results, so no encoding can be optimized away
+
+            size_t allocations = g_allocations.load(std::memory_order_relaxed);
+            auto begin = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < count; ++i)
+            {
+                const EncoderSample &sample = kEncoderSamples[i % kSamples];
+                OperandList operands(sample.operands.data(), sample.operand_count);
+                if (allocation_free)
+                {
+                    size_t offset = static_cast<size_t>(out - code.data());
+                    size_t written = InstructionSet::EncodeInstruction(sample.mnemonic, operands, context, out, offset);
+                    for (size_t b = 0; b < written; ++b)
+                    {
+                        checksum += out[b];
+                    }
+                    out += written;
+                }
+                else
+                {
+                    CompiledInstruction compiled = InstructionSet::CompileInstruction(sample.mnemonic, operands, context, i * 4);
+                    for (uint8_t byte : compiled.bytes)
+                    {
+                        checksum += byte;
+                    }
+                }
+            }
+            auto end = std::chrono::steady_clock::now();
+            allocations = g_allocations.load(std::memory_order_relaxed) - allocations;
+
+            double seconds = std::chrono::duration<double>(end - begin).count();
+            double ips = static_cast<double>(count) / seconds;
+            if (ips > best.instructions_per_second)
+            {
+                best.instructions_per_second = ips;
+                best.allocations_per_instruction = static_cast<double>(allocations) / static_cast<double>(count);
+            }
+            best.checksum = checksum;
+        }
+        return best;
+    }
+
+    // Instruction-only program of `count` lines, a quarter of them relocating
+    std::string GenerateTextSource(size_t count)
+    {
+        std::string source = "    .section .text\nstart:\n";
+        for (size_t i = 0; i < count; ++i)
+        {
+            switch (i % 4)
+            {
+            case 0:
+                source += "\tadd  a0, a1, a2\n";
+                break;
+            case 1:
+                source += "\taddi x1, zero, 1\n";
+                break;
+            case 2:
+                source += "\txori s1, s2, 0x7F\n";
+                break;
+            default:
+                source += "\tbeq  a0, a1, start\n";
+                break;
+            }
+        }
+        return source;
+    }
+
+    // Returns the best-of-`runs` parse + encode rate in instructions per second
+    double MeasureParser(const TokenBuffer &tokens, size_t count, int runs, ThreadPool *pool, IR &ir)
+    {
+        double best = 0.0;
+        for (int run = 0; run < runs; ++run)
+        {
+            Parser parser;
+            parser.set_verbose(false);
+            parser.set_thread_pool(pool);
+
+            auto begin = std::chrono::steady_clock::now();
+            ir = parser.Parse(tokens);
+            auto end = std::chrono::steady_clock::now();
+
+            double seconds = std::chrono::duration<double>(end - begin).count();
+            double ips = static_cast<double>(count) / seconds;
+            best = ips > best ? ips : best;
+        }
+        return best;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    // Usage: CForgeBenchmark [source size in MB] [runs]
+    size_t megabytes = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 64;
+    int runs = argc > 2 ? std::atoi(argv[2]) : 5;
+
+    std::string source = GenerateSource(megabytes * 1024 * 1024);
+    std::cout << "Lexer benchmark: " << source.size() << " bytes, "
+              << runs << " runs, SIMD: " << simd::InstructionSetName() << "\n";
+
+    Lexer scalar;
+    scalar.set_verbose(false);
+    scalar.set_scan_mode(Lexer::ScanMode::SCALAR);
+    scalar.set_source(source);
+
+    Lexer vectorized;
+    vectorized.set_verbose(false);
+    vectorized.set_scan_mode(Lexer::ScanMode::VECTORIZED);
+    vectorized.set_source(source);
+
+    double scalar_mbps = MeasureLexer(scalar, source.size(), runs);
+    double vectorized_mbps = MeasureLexer(vectorized, source.size(), runs);
+
+    // Several chunks per worker, so stealing can even out uneven chunks
+    ThreadPool pool;
+    size_t chunks = pool.size() * 4;
+    Lexer parallel;
+    parallel.set_verbose(false);
+    parallel.set_source(source);
+    double parallel_mbps = MeasureLexer(parallel, source.size(), runs, &pool, chunks);
+
+    if (!SameTokens(scalar.get_tokens(), vectorized.get_tokens()))
+    {
+        std::cerr << "Token streams differ between scalar and vectorized lexers" << std::endl;
+        return 1;
+    }
+    if (!SameTokens(vectorized.get_tokens(), parallel.get_tokens()))
+    {
+        std::cerr << "Token streams differ between single and chunked lexing" << std::endl;
+        return 1;
+    }
+
+    std::cout << "  tokens:     " << scalar.get_tokens().size() << " ("
+              << scalar.get_tokens().memory_usage() / (1024 * 1024) << " MB packed)\n";
+    std::cout << "  scalar:     " << scalar_mbps << " MB/s\n";
+    std::cout << "  vectorized: " << vectorized_mbps << " MB/s\n";
+    std::cout << "  speedup:    " << vectorized_mbps / scalar_mbps << "x" << std::endl;
+    std::cout << "  parallel:   " << parallel_mbps << " MB/s (" << pool.size() << " threads, "
+              << chunks << " chunks)\n";
+    std::cout << "  scaling:    " << parallel_mbps / vectorized_mbps << "x" << std::endl;
+
+    size_t instructions = megabytes * 64 * 1024;
+    std::cout << "Encoder benchmark: " << instructions << " instructions, " << runs << " runs\n";
+
+    EncoderResult compiled = MeasureEncoder(false, instructions, runs);
+    EncoderResult encoded = MeasureEncoder(true, instructions, runs);
+    if (compiled.checksum != encoded.checksum)
+    {
+        std::cerr << "Encoders disagree on the encoded bytes" << std::endl;
+        return 1;
+    }
+
+    std::cout << "  CompileInstruction: " << compiled.instructions_per_second / 1e6 << " M instr/s, "
+              << compiled.allocations_per_instruction << " allocations/instr\n";
+    std::cout << "  EncodeInstruction:  " << encoded.instructions_per_second / 1e6 << " M instr/s, "
+              << encoded.allocations_per_instruction << " allocations/instr\n";
+    std::cout << "  speedup:    " << encoded.instructions_per_second / compiled.instructions_per_second
+              << "x" << std::endl;
+
+    std::string text = GenerateTextSource(instructions);
+    Lexer text_lexer;
+    text_lexer.set_verbose(false);
+    text_lexer.set_source(text);
+    text_lexer.Analyze();
+
+    std::cout << "Parser benchmark: " << instructions << " instructions, " << runs << " runs\n";
+    IR serial_ir;
+    IR parallel_ir;
+    double serial_ips = MeasureParser(text_lexer.get_tokens(), instructions, runs, nullptr, serial_ir);
+    double parallel_ips = MeasureParser(text_lexer.get_tokens(), instructions, runs, &pool, parallel_ir);
+    if (serial_ir.sections != parallel_ir.sections)
+    {
+        std::cerr << "Sections differ between serial and parallel encoding" << std::endl;
+        return 1;
+    }
+
+    std::cout << "  serial encode:   " << serial_ips / 1e6 << " M instr/s\n";
+    std::cout << "  parallel encode: " << parallel_ips / 1e6 << " M instr/s (" << pool.size() << " threads)\n";
+    std::cout << "  scaling:    " << parallel_ips / serial_ips << "x" << std::endl;
+    return 0;
+}
@@ -0,0 +1,38 @@
+#include "server.hpp"
+
+// std
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace cforge;
+
+// Thin front end: forwards the command line to a resident `CForge --server`
+int main(int argc, char **argv)
+{
+    try
+    {
+        // Response files are read here, relative to the client's directory
+        std::vector<std::string> args = Driver::ExpandResponseFiles(std::vector<std::string>(argv + 1, argv + argc));
+
+        // The socket option addresses the server, it is not part of the command
+        std::string socket_path = Server::DefaultSocketPath();
+        for (size_t i = 0; i < args.size(); ++i)
+        {
+            if (args[i] == "--socket" && i + 1 < args.size())
+            {
+                socket_path = args[i + 1];
+                args.erase(args.begin() + i, args.begin() + i + 2);
+                break;
+            }
+        }
+
+        return SendRequest(socket_path, std::filesystem::current_path().string(), args, std::cout, std::cerr);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace cforge
+{
+
+	/**
+	 * @brief Bump allocator handing out memory from large blocks.
+	 * Allocations are never freed individually: the whole arena is released
+	 * (or rewound with `Reset`) at once. Objects placed in it must therefore be
+	 * trivially destructible or have their lifetime managed by the owner.
+	 */
+	class Arena
+	{
+	public:
+		static constexpr size_t kDefaultBlockSize = 64 * 1024;
+
+		explicit Arena(size_t block_size = kDefaultBlockSize)
+			: block_size_(block_size) {}
+
+		Arena(const Arena &) = delete;
+		Arena &operator=(const Arena &) = delete;
+		Arena(Arena &&other) noexcept { *this = std::move(other); }
+		Arena &operator=(Arena &&other) noexcept
+		{
+			if (this != &other)
+			{
+				block_size_ = other.block_size_;
+				blocks_ = std::move(other.blocks_);
+				block_sizes_ = std::move(other.block_sizes_);
+				cursor_ = std::exchange(other.cursor_, nullptr);
+				limit_ = std::exchange(other.limit_, nullptr);
+				other.blocks_.clear();
+				other.block_sizes_.clear();
+			}
+			return *this;
+		}
+
+		void *Allocate(size_t size, size_t alignment = alignof(std::max_align_t))
+		{
+			uintptr_t current = reinterpret_cast<uintptr_t>(cursor_);
+			uintptr_t aligned = (current + alignment - 1) & ~(uintptr_t(alignment) - 1);
+			if (cursor_ == nullptr || aligned + size > reinterpret_cast<uintptr_t>(limit_))
+			{
+				NewBlock(size + alignment);
+				current = reinterpret_cast<uintptr_t>(cursor_);
+				aligned = (current + alignment - 1) & ~(uintptr_t(alignment) - 1);
+			}
+			cursor_ = reinterpret_cast<char *>(aligned + size);
+			return reinterpret_cast<void *>(aligned);
+		}
+
+		// Constructs a `T` in the arena, `T` must be trivially destructible
+		template <typename T, typename... Args>
+		T *New(Args &&...args)
+		{
+			static_assert(std::is_trivially_destructible_v<T>, "Arena objects are never destroyed");
+			return new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+		}
+
+		// Uninitialized array of `count` trivially destructible elements
+		template <typename T>
+		T *NewArray(size_t count)
+		{
+			static_assert(std::is_trivially_destructible_v<T>, "Arena objects are never destroyed");
+			return static_cast<T *>(Allocate(sizeof(T) * (count ? count : 1), alignof(T)));
+		}
+
+		// Copies `str` into the arena, the returned view stays valid until `Reset`
+		std::string_view CopyString(std::string_view str)
+		{
+			char *dst = static_cast<char *>(Allocate(str.size() ? str.size() : 1, 1));
+			std::memcpy(dst, str.data(), str.size());
+			return std::string_view(dst, str.size());
+		}
+
+		/**
+		 * Rewinds the arena to empty, keeping the first block for reuse.
+		 * Everything allocated so far is invalidated.
+		 */
+		void Reset()
+		{
+			if (blocks_.size() > 1)
+			{
+				blocks_.erase(blocks_.begin() + 1, blocks_.end());
+				block_sizes_.erase(block_sizes_.begin() + 1, block_sizes_.end());
+			}
+			if (blocks_.empty())
+			{
+				cursor_ = limit_ = nullptr;
+				return;
+			}
+			cursor_ = blocks_.front().get();
+			limit_ = cursor_ + block_sizes_.front();
+		}
+
+		// Bytes reserved from the system
+		size_t capacity() const
+		{
+			size_t total = 0;
+			for (size_t size : block_sizes_)
+				total += size;
+			return total;
+		}
+
+	private:
+		void NewBlock(size_t min_size)
+		{
+			size_t size = min_size > block_size_ ? min_size : block_size_;
+			blocks_.emplace_back(new char[size]);
+			block_sizes_.push_back(size);
+			cursor_ = blocks_.back().get();
+			limit_ = cursor_ + size;
+		}
+
+		size_t block_size_ = kDefaultBlockSize;
+		std::vector<std::unique_ptr<char[]>> blocks_;
+		std::vector<size_t> block_sizes_;
+		char *cursor_ = nullptr;
+		char *limit_ = nullptr;
+	};
+
+} // cforge
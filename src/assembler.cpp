@@ -1,7 +1,16 @@
 #include "assembler.hpp"
+#include "literal.hpp"
+#include "mapped_file.hpp"
+#include "simd_scan.hpp"
 
 // lib
+#include <algorithm>
+#include <cctype>
+#include <cstring>
 #include <iostream>
+#include <limits>
+#include <thread>
+#include <type_traits>
 
 namespace cforge
 {
@@ -9,34 +18,201 @@ namespace cforge
     /// Lexer Implementation
     ///////////////////////////////////////////////////////////////////////////
 
+    namespace
+    {
+        // A '-' or '+' directly followed by a digit is the sign of a number literal
+        bool StartsSignedNumber(const char *src, size_t pos, size_t end)
+        {
+            return (src[pos] == '-' || src[pos] == '+') && pos + 1 < end &&
+                   std::isdigit(static_cast<unsigned char>(src[pos + 1]));
+        }
+    }
+
     void Lexer::Analyze()
+    {
+        tokens_.clear();
+        tokens_.set_source(source_);
+        AnalyzeRange(0, source_.size());
+
+        // Print all tokens for debugging
+        if (verbose_)
+        {
+            PrintTokens();
+        }
+    }
+
+    void Lexer::AnalyzeParallel(ThreadPool &pool, size_t chunks)
+    {
+        if (chunks == 0)
+        {
+            chunks = std::min(pool.size(), source_.size() / kMinChunkSize);
+        }
+        if (chunks <= 1)
+        {
+            Analyze();
+            return;
+        }
+
+        // Cut just after a newline, so no token or statement straddles two chunks
+        std::vector<size_t> bounds{0};
+        for (size_t i = 1; i < chunks; ++i)
+        {
+            size_t cut = source_.size() * i / chunks;
+            cut = std::max(cut, bounds.back());
+            size_t newline = source_.find('\n', cut);
+            if (newline == std::string_view::npos)
+            {
+                break;
+            }
+            if (newline + 1 > bounds.back())
+            {
+                bounds.push_back(newline + 1);
+            }
+        }
+        bounds.push_back(source_.size());
+
+        // Each chunk lexer sees the whole source but stops at its bound, so
+        // token offsets (and the lines derived from them) are already absolute
+        std::vector<Lexer> lexers(bounds.size() - 1);
+        pool.ParallelFor(lexers.size(), [&](size_t i)
+                         {
+                             Lexer &lexer = lexers[i];
+                             lexer.source_ = source_;
+                             lexer.scan_mode_ = scan_mode_;
+                             lexer.tokens_.set_source(source_);
+                             lexer.AnalyzeRange(bounds[i], bounds[i + 1]); });
+
+        // Stitch the chunks together in source order
+        size_t total = 0;
+        for (const Lexer &lexer : lexers)
+        {
+            total += lexer.tokens_.size();
+        }
+        tokens_.clear();
+        tokens_.set_source(source_);
+        tokens_.reserve(total);
+        for (const Lexer &lexer : lexers)
+        {
+            tokens_.append(lexer.tokens_);
+        }
+        pos_ = source_.size();
+
+        if (verbose_)
+        {
+            PrintTokens();
+        }
+    }
+
+    void Lexer::AnalyzeRange(size_t begin, size_t end)
+    {
+        pos_ = begin;
+        end_ = end;
+        curr_ = '\0';
+
+        if (scan_mode_ == ScanMode::VECTORIZED)
+        {
+            TokenizeVectorized();
+        }
+        else
+        {
+            Tokenize();
+        }
+    }
+
+    void Lexer::PrintTokens() const
+    {
+        for (size_t i = 0; i < tokens_.size(); ++i)
+        {
+            std::cout << "Token: " << tokens_.value(i) << " (Type: "
+                      << static_cast<int>(tokens_.type(i)) << ", Line: "
+                      << tokens_.line(i) << ")\n";
+        }
+    }
+
+    void Lexer::Analyze(TokenStream &stream)
     {
         pos_ = 0;
-        line_ = 1;
+        end_ = source_.size();
         curr_ = '\0';
         tokens_.clear();
-        Tokenize();
+        tokens_.set_source(source_);
+        stream_ = &stream;
+        batch_ = nullptr;
+        stream.set_source(source_);
+
+        try
+        {
+            if (scan_mode_ == ScanMode::VECTORIZED)
+            {
+                TokenizeVectorized();
+            }
+            else
+            {
+                Tokenize();
+            }
+            FlushBatch();
+            stream.Close();
+        }
+        catch (...)
+        {
+            stream.Close(std::current_exception());
+        }
+
+        stream_ = nullptr;
+        batch_ = nullptr;
+    }
+
+    void Lexer::Emit(Token::Type type, std::string_view value)
+    {
+        size_t offset = static_cast<size_t>(value.data() - source_.data());
+        if (stream_ == nullptr)
+        {
+            tokens_.push_back(type, offset, value.size());
+            return;
+        }
+
+        if (value.size() > TokenBuffer::kMaxTokenLength)
+        {
+            throw Error(value.substr(0, 32), tokens_.LineOf(offset), "Token exceeds 65535 characters");
+        }
+        if (batch_ == nullptr)
+        {
+            batch_ = &stream_->AcquireWriteBatch();
+        }
+        batch_->offsets[batch_->count] = static_cast<uint32_t>(offset);
+        batch_->lengths[batch_->count] = static_cast<uint16_t>(value.size());
+        batch_->types[batch_->count] = type;
+        ++batch_->count;
+        if (batch_->count == TokenStream::Batch::kCapacity)
+        {
+            FlushBatch();
+        }
+    }
+
+    void Lexer::FlushBatch()
+    {
+        if (batch_ != nullptr)
+        {
+            stream_->PublishBatch();
+            batch_ = nullptr;
+        }
     }
 
     char Lexer::Peek() const
     {
-        return pos_ < source_.size() ? source_[pos_] : EOF;
+        return pos_ < end_ ? source_[pos_] : EOF;
     }
 
     char Lexer::Advance()
     {
         curr_ = Peek();
         ++pos_;
-        if (curr_ == '\n')
-        {
-            ++line_;
-        }
         return curr_;
     }
 
     bool Lexer::IsAtEnd() const
     {
-        return pos_ >= source_.size();
+        return pos_ >= end_;
     }
 
     /**
@@ -86,10 +262,7 @@ namespace cforge
             { return std::isalnum(c) || c == '_'; },
             start);
 
-        tokens_.push_back(Token{
-            Token::Type::DIRECTIVE,
-            view,
-            line_});
+        Emit(Token::Type::DIRECTIVE, view);
     }
 
     void Lexer::LexLabelOrIdentifier()
@@ -106,17 +279,11 @@ namespace cforge
         if (Peek() == ':')
         {
             Advance(); // Consume the ':'
-            tokens_.push_back(Token{
-                Token::Type::LABEL,
-                view,
-                line_});
+            Emit(Token::Type::LABEL, view);
         }
         else
         {
-            tokens_.push_back(Token{
-                Token::Type::IDENTIFIER,
-                view,
-                line_});
+            Emit(Token::Type::IDENTIFIER, view);
         }
     }
 
@@ -125,28 +292,47 @@ namespace cforge
         // Check for newline character
         if (curr_ == '\n')
         {
-            tokens_.push_back(Token{
-                Token::Type::NEWLINE,
-                std::string_view("\n"),
-                line_});
+            Emit(Token::Type::NEWLINE, source_.substr(pos_, 1));
             return;
         }
         else if (curr_ == ',')
         {
-            tokens_.push_back(Token{
-                Token::Type::COMMA,
-                std::string_view(","),
-                line_});
+            Emit(Token::Type::COMMA, source_.substr(pos_, 1));
             return;
         }
     }
 
+    /**
+     * Creates a token from a double-quoted string on a single line, without escapes.
+     */
+    void Lexer::LexString()
+    {
+        // Opening '"' already consumed
+        size_t start = pos_;
+        auto view = ConsumeWhile(
+            [](char c)
+            { return c != '"' && c != '\n'; },
+            start);
+
+        if (Peek() != '"')
+        {
+            throw Error(view.substr(0, 32), tokens_.LineOf(start), "Unterminated string");
+        }
+        Advance(); // Consume the closing '"'
+        Emit(Token::Type::STRING, view);
+    }
+
     /**
      * Creates a token from a number, can be of type bin, hex or decimal.
+     * A leading sign is kept in the token, the literal decoders handle it.
      */
     void Lexer::LexNumber()
     {
         size_t start = pos_;
+        if (Peek() == '-' || Peek() == '+')
+        {
+            Advance(); // Consume the sign
+        }
 
         // Consume digits and optional prefix
         auto view = ConsumeWhile(
@@ -159,10 +345,7 @@ namespace cforge
 
         if (!view.empty())
         {
-            tokens_.push_back(Token{
-                Token::Type::NUMBER,
-                view,
-                line_});
+            Emit(Token::Type::NUMBER, view);
         }
     }
 
@@ -185,10 +368,15 @@ namespace cforge
 
             LexSpecialCharacter();
 
-            if (isdigit(static_cast<unsigned char>(curr_)))
+            if (isdigit(static_cast<unsigned char>(curr_)) || StartsSignedNumber(source_.data(), pos_, end_))
             {
                 LexNumber();
             }
+            else if (curr_ == '"')
+            {
+                Advance(); // Consume the '"'
+                LexString();
+            }
             else if (curr_ == '.')
             {
                 Advance(); // Consume the '.'
@@ -203,42 +391,237 @@ namespace cforge
                 Advance();
             }
         }
+    }
 
-        // Print all tokens for debugging
-        for (const auto &token : tokens_)
+    /**
+     * Vectorized counterpart of `Tokenize`.
+     * Runs of blanks, comments, identifiers and numbers are skipped 16-32 bytes
+     * at a time, single-character tokens are dispatched on a class table.
+     * The emitted token stream is identical to the scalar path.
+     */
+    void Lexer::TokenizeVectorized()
+    {
+        const char *src = source_.data();
+        const size_t end = end_;
+        size_t pos = pos_;
+
+        while (pos < end)
         {
-            std::cout << "Token: " << token.value << " (Type: "
-                      << static_cast<int>(token.type) << ", Line: "
-                      << token.line_number << ")\n";
+            pos = simd::SkipBlanks(src, pos, end);
+            if (pos >= end)
+                break;
+
+            char c = src[pos];
+            uint8_t cls = simd::ClassOf(c);
+
+            if (cls & simd::kComment)
+            {
+                // Comment runs until (not including) the newline
+                pos = simd::FindNewline(src, pos, end);
+            }
+            else if (cls & simd::kNewline)
+            {
+                Emit(Token::Type::NEWLINE, std::string_view(src + pos, 1));
+                ++pos;
+            }
+            else if (cls & simd::kComma)
+            {
+                Emit(Token::Type::COMMA, std::string_view(src + pos, 1));
+                ++pos;
+            }
+            else if ((cls & simd::kDigit) || StartsSignedNumber(src, pos, end))
+            {
+                size_t start = pos;
+                pos = simd::SkipNumber(src, pos + 1, end);
+                Emit(Token::Type::NUMBER, std::string_view(src + start, pos - start));
+            }
+            else if (c == '"')
+            {
+                size_t start = pos + 1;
+                size_t close = source_.find('"', start);
+                size_t newline = simd::FindNewline(src, start, end);
+                if (close == std::string_view::npos || close >= newline)
+                {
+                    throw Error(source_.substr(start, std::min<size_t>(newline - start, 32)),
+                                tokens_.LineOf(start), "Unterminated string");
+                }
+                Emit(Token::Type::STRING, std::string_view(src + start, close - start));
+                pos = close + 1;
+            }
+            else if (c == '.')
+            {
+                size_t start = pos;
+                pos = simd::SkipIdentifier(src, pos + 1, end);
+                Emit(Token::Type::DIRECTIVE, std::string_view(src + start, pos - start));
+            }
+            else if (cls & simd::kAlpha)
+            {
+                size_t start = pos;
+                pos = simd::SkipIdentifier(src, pos, end);
+                std::string_view view(src + start, pos - start);
+                if (pos < end && src[pos] == ':')
+                {
+                    ++pos; // Consume the ':'
+                    Emit(Token::Type::LABEL, view);
+                }
+                else
+                {
+                    Emit(Token::Type::IDENTIFIER, view);
+                }
+            }
+            else
+            {
+                ++pos; // Unknown character, skipped like the scalar path does
+            }
         }
+
+        pos_ = pos;
     }
 
     ///////////////////////////////////////////////////////////////////////////
     /// Parser Implementation
     ///////////////////////////////////////////////////////////////////////////
 
-    Token &Parser::Peek()
+    namespace
+    {
+        // True if argument `i` of `d` was a double-quoted string
+        bool IsStringArg(const DirectiveStmt *d, size_t i)
+        {
+            return i < d->arg_types.size() && d->arg_types[i] == Token::Type::STRING;
+        }
+
+        // Parses the count or size operand of a generator directive
+        size_t ParseCount(std::string_view value, uint32_t line)
+        {
+            uint64_t count = 0;
+            if (!DecodeUnsigned(value, count) || count > std::numeric_limits<size_t>::max())
+            {
+                throw Error(value, line, "Expected a non-negative integer");
+            }
+            return static_cast<size_t>(count);
+        }
+
+        /**
+         * Appends `copies` more copies of data[start, end), copying from the
+         * already replicated prefix so every memcpy doubles the filled range.
+         */
+        void Replicate(std::vector<uint8_t> &data, size_t start, size_t copies)
+        {
+            const size_t block = data.size() - start;
+            const size_t total = block * (copies + 1);
+            data.resize(start + total);
+            for (size_t filled = block; filled < total;)
+            {
+                size_t chunk = std::min(filled, total - filled);
+                std::memcpy(data.data() + start + filled, data.data() + start, chunk);
+                filled += chunk;
+            }
+        }
+    }
+
+    bool Parser::AtEnd()
     {
-        if (index_ >= tokens_.size())
+        if (index_ < token_count_)
         {
-            throw Error("Unexpected end of input", 0, "No more tokens available");
+            return false;
         }
-        return tokens_[index_];
+        // Included files are complete token buffers, only the top-level source streams
+        if (stream_ == nullptr || !include_stack_.empty())
+        {
+            return true;
+        }
+
+        // Current batch is exhausted, hand it back and wait for the next one
+        if (holding_batch_)
+        {
+            stream_->ReleaseReadBatch();
+            holding_batch_ = false;
+        }
+        const TokenStream::Batch *batch = stream_->AcquireReadBatch();
+        if (batch == nullptr)
+        {
+            token_count_ = 0;
+            index_ = 0;
+            return true;
+        }
+        holding_batch_ = true;
+        source_ = stream_->source();
+        offsets_ = batch->offsets.data();
+        lengths_ = batch->lengths.data();
+        types_ = batch->types.data();
+        token_count_ = batch->count;
+        index_ = 0;
+        return token_count_ == 0;
     }
-    Token &Parser::Consume()
+
+    void Parser::EnterInclude(const std::string &path)
     {
-        if (index_ >= tokens_.size())
+        // Included before, e.g. by another header: nothing left to do
+        if (included_paths_.count(path) != 0)
         {
-            throw Error("Unexpected end of input", 0, "No more tokens available");
+            return;
         }
-        return tokens_[index_++];
+
+        IncludeCache::FilePtr file = include_cache_->Get(path);
+        included_files_.push_back(file);
+        included_paths_.insert(file->path);
+
+        include_stack_.push_back({source_, offsets_, lengths_, types_, token_count_, index_, line_, current_path_});
+        source_ = file->tokens.source();
+        offsets_ = file->tokens.offsets();
+        lengths_ = file->tokens.lengths();
+        types_ = file->tokens.types();
+        token_count_ = file->tokens.size();
+        index_ = 0;
+        line_ = 1;
+        current_path_ = file->path;
+    }
+
+    bool Parser::LeaveInclude()
+    {
+        if (include_stack_.empty())
+        {
+            return false;
+        }
+
+        const IncludeFrame &frame = include_stack_.back();
+        source_ = frame.source;
+        offsets_ = frame.offsets;
+        lengths_ = frame.lengths;
+        types_ = frame.types;
+        token_count_ = frame.token_count;
+        index_ = frame.index;
+        line_ = frame.line;
+        current_path_ = frame.path;
+        include_stack_.pop_back();
+        return true;
+    }
+
+    Token Parser::Peek()
+    {
+        if (AtEnd())
+        {
+            throw Error("Unexpected end of input", line_, "No more tokens available");
+        }
+        return Token{types_[index_], source_.substr(offsets_[index_], lengths_[index_])};
+    }
+    Token Parser::Consume()
+    {
+        Token token = Peek();
+        ++index_;
+        if (token.type == Token::Type::NEWLINE)
+        {
+            ++line_;
+        }
+        return token;
     }
 
     template <typename Pred>
-    std::vector<std::string> Parser::ConsumeWhileTokens(Pred &&pred)
+    OperandList Parser::ConsumeWhileTokens(Pred &&pred, Span<Token::Type> *types)
     {
-        std::vector<std::string> items;
-        while (index_ < tokens_.size() && pred(Peek()))
+        operand_scratch_.clear();
+        operand_type_scratch_.clear();
+        while (!AtEnd() && pred(Peek()))
         {
             if (Peek().type == Token::Type::COMMA)
             {
@@ -246,66 +629,98 @@ namespace cforge
             }
             else
             {
-                items.push_back(std::string(Consume().value));
+                Token token = Consume();
+                operand_scratch_.push_back(token.value);
+                if (types != nullptr)
+                {
+                    operand_type_scratch_.push_back(token.type);
+                }
             }
         }
-        return items;
+
+        if (types != nullptr)
+        {
+            auto *type_items = stmt_arena_.NewArray<Token::Type>(operand_type_scratch_.size());
+            std::copy(operand_type_scratch_.begin(), operand_type_scratch_.end(), type_items);
+            *types = Span<Token::Type>(type_items, operand_type_scratch_.size());
+        }
+
+        auto *items = stmt_arena_.NewArray<std::string_view>(operand_scratch_.size());
+        std::copy(operand_scratch_.begin(), operand_scratch_.end(), items);
+        return OperandList(items, operand_scratch_.size());
     }
 
     template <typename StmtT>
-    std::unique_ptr<Stmt> Parser::MakeSingleTokenStmt()
+    StmtT *Parser::MakeSingleTokenStmt()
     {
+        uint32_t line = line_;
         Token t = Consume();
-        auto ptr = std::make_unique<StmtT>(std::string(t.value));
-        ptr->line = t.line_number;
+        StmtT *ptr = stmt_arena_.New<StmtT>(context_.symbols.Intern(t.value));
+        ptr->line = line;
         return ptr;
     }
 
     template <typename StmtT>
-    std::unique_ptr<Stmt> Parser::MakeListTokenStmt()
+    StmtT *Parser::MakeListTokenStmt()
     {
+        uint32_t line = line_;
         Token head = Consume();
+        // Directives need to tell string arguments from symbols, instructions never take strings
+        constexpr bool kKeepTypes = std::is_same_v<StmtT, DirectiveStmt>;
+        Span<Token::Type> types;
         // stop on NEWLINE
-        std::vector<std::string> args = ConsumeWhileTokens(
+        OperandList args = ConsumeWhileTokens(
             [](auto const &tk)
             {
                 return tk.type != Token::Type::NEWLINE;
-            });
-        auto ptr = std::make_unique<StmtT>(std::string(head.value), std::move(args));
-        ptr->line = head.line_number;
+            },
+            kKeepTypes ? &types : nullptr);
+        StmtT *ptr = stmt_arena_.New<StmtT>(head.value, args);
+        if constexpr (kKeepTypes)
+        {
+            ptr->arg_types = types;
+        }
+        ptr->line = line;
         return ptr;
     }
 
-    std::unique_ptr<Stmt> Parser::ParseLabelStmt()
+    Stmt *Parser::ParseLabelStmt()
     {
-        std::unique_ptr<Stmt> ptr = MakeSingleTokenStmt<LabelStmt>();
+        LabelStmt *ptr = MakeSingleTokenStmt<LabelStmt>();
 
         // Must be inside a section
-        if (current_section_.empty())
+        if (!context_.InSection())
         {
             throw Error("Label used outside of a section", ptr->line);
         }
 
-        // Add the label to the symbol map
-        std::string name = static_cast<LabelStmt *>(ptr.get())->name;
-        if (symbol_map_.find(name) != symbol_map_.end())
+        // Every repetition would define it again
+        if (!repeat_stack_.empty())
+        {
+            throw Error(context_.symbols.Get(ptr->name), ptr->line, "Label defined inside a .rept block");
+        }
+
+        // Add the label to the symbol table
+        SymbolId name = ptr->name;
+        SymbolEntry &entry = context_.SymbolAt(name);
+        if (entry.defined)
         {
-            throw Error(std::string(name), ptr->line, "Label defined multiple times");
+            throw Error(context_.symbols.Get(name), ptr->line, "Label defined multiple times");
         }
-        auto offset = UnLocalizedOffset(
-            current_section_,
-            section_size_map_[current_section_]);
-        symbol_map_[name] = offset;
+        entry.location = UnLocalizedOffset(
+            context_.current_section,
+            context_.CurrentSection().size);
+        entry.defined = true;
 
         return ptr;
     }
 
-    std::unique_ptr<Stmt> Parser::ParseDirectiveStmt()
+    Stmt *Parser::ParseDirectiveStmt()
     {
-        auto ptr = MakeListTokenStmt<DirectiveStmt>();
-        auto *d = static_cast<DirectiveStmt *>(ptr.get());
-        std::string directive_name(d->name);
-        if (!InstructionSet::IsValidDirective(d->name))
+        DirectiveStmt *d = MakeListTokenStmt<DirectiveStmt>();
+        std::string_view directive_name = d->name;
+        Directive directive = InstructionSet::LookupDirective(directive_name);
+        if (directive == Directive::INVALID)
         {
             throw Error(directive_name, d->line, "Invalid directive");
         }
@@ -313,26 +728,28 @@ namespace cforge
         // FIX: Remember to handle errors for:
         // - globl label not defined
         // - multiple equal definitions for globl labels
-        if (directive_name == ".globl")
+        if (directive == Directive::GLOBL)
         {
             // Handle global directive
             if (d->args.size() != 1)
             {
                 throw Error(directive_name, d->line, "Expected exactly one argument for .globl directive");
             }
-            auto label = d->args[0];
-            global_symbols_.insert(std::string(label));
+            context_.SymbolAt(context_.symbols.Intern(d->args[0])).global = true;
         }
-        else if (directive_name == ".align")
+        else if (directive == Directive::ALIGN)
         {
-            std::cout << "Aligning section with .align directive\n";
+            if (verbose_)
+            {
+                std::cout << "Aligning section with .align directive\n";
+            }
             // Expect one or two arguments
             if (d->args.size() == 1)
             {
                 try
                 {
                     // Get alignment value
-                    int alignment_n = std::stoi(d->args[0]);
+                    int alignment_n = std::stoi(std::string(d->args[0]));
 
                     if (alignment_n <= 0 || alignment_n >= 32)
                     {
@@ -340,21 +757,25 @@ namespace cforge
                     }
 
                     // Ensure we're in a section
-                    if (current_section_.empty())
+                    if (!context_.InSection())
                     {
                         throw Error("Align directive used outside of a section", d->line);
                     }
 
                     // Calculate required padding
-                    size_t current_size = section_size_map_[current_section_];
+                    Section &section = context_.CurrentSection();
+                    size_t current_size = section.size;
                     size_t alignment = 1 << alignment_n; // 2^alignment_n
                     size_t padding = (alignment - (current_size % alignment)) % alignment;
 
-                    std::cout << "Aligning section '" << current_section_ << "' by " << padding << " bytes\n";
+                    if (verbose_)
+                    {
+                        std::cout << "Aligning section '" << context_.CurrentSectionName() << "' by " << padding << " bytes\n";
+                    }
                     // Update section size and insert padding
-                    section_size_map_[current_section_] += padding;
-                    section_data_map_[current_section_].insert(
-                        section_data_map_[current_section_].end(),
+                    section.size += padding;
+                    section.data.insert(
+                        section.data.end(),
                         padding, 0); // Fill with zeros
                 }
                 catch (const std::exception &e)
@@ -367,13 +788,13 @@ namespace cforge
                 try
                 {
                     // Get alignment value
-                    int alignment_n = std::stoi(d->args[0]);
+                    int alignment_n = std::stoi(std::string(d->args[0]));
 
                     // Get fill value, default to 0
                     uint8_t fill_value = 0;
                     if (!d->args[1].empty())
                     {
-                        fill_value = static_cast<uint8_t>(std::stoi(d->args[1]));
+                        fill_value = static_cast<uint8_t>(std::stoi(std::string(d->args[1])));
                     }
 
                     // Validate alignment_n
@@ -389,20 +810,21 @@ namespace cforge
                     }
 
                     // Ensure we're in a section
-                    if (current_section_.empty())
+                    if (!context_.InSection())
                     {
                         throw Error("Align directive used outside of a section", d->line);
                     }
 
                     // Calculate required padding
-                    size_t current_size = section_size_map_[current_section_];
+                    Section &section = context_.CurrentSection();
+                    size_t current_size = section.size;
                     size_t alignment = 1 << alignment_n; // 2^alignment_n
                     size_t padding = (alignment - (current_size % alignment)) % alignment;
 
                     // Update section size and insert padding
-                    section_size_map_[current_section_] += padding;
-                    section_data_map_[current_section_].insert(
-                        section_data_map_[current_section_].end(),
+                    section.size += padding;
+                    section.data.insert(
+                        section.data.end(),
                         padding, fill_value); // Fill with specified value
                 }
                 catch (const std::exception &e)
@@ -416,22 +838,83 @@ namespace cforge
             }
         }
         // Check for .section directive
-        else if (directive_name == ".section")
+        else if (directive == Directive::SECTION)
         {
             if (d->args.size() != 1)
             {
                 throw Error(directive_name, d->line, "Expected exactly one argument for .section directive");
             }
-            std::string section_name = d->args[0];
+            // Switch to the section, creating it empty on first use
+            context_.current_section = context_.SectionNamed(d->args[0]);
+        }
+        else if (directive == Directive::INCLUDE)
+        {
+            if (d->args.size() != 1 || !IsStringArg(d, 0))
+            {
+                throw Error(directive_name, d->line, ".include directive must be in the form \".include \"<file>\"\"");
+            }
+            if (include_cache_ == nullptr)
+            {
+                throw Error(directive_name, d->line, "Includes are not enabled for this parse");
+            }
 
-            // Switch to the next section while safely initializing `section_map_`
-            if (section_size_map_.find(section_name) == section_size_map_.end())
+            // Finish the line here, the next token comes from the included file
+            if (!AtEnd() && Peek().type == Token::Type::NEWLINE)
             {
-                section_size_map_[section_name] = 0; // Initialize section size to 0
+                Consume();
+            }
+            try
+            {
+                EnterInclude(include_cache_->Resolve(std::string(current_path_), d->args[0]));
+            }
+            catch (const std::exception &e)
+            {
+                throw Error(d->args[0], d->line, e.what());
             }
-            current_section_ = section_name;
         }
-        else if (directive_name == ".space")
+        else if (directive == Directive::INCBIN)
+        {
+            if (d->args.empty() || d->args.size() > 3 || !IsStringArg(d, 0))
+            {
+                throw Error(directive_name, d->line, ".incbin directive must be in the form \".incbin \"<file>\" [, <offset> [, <length>]]\"");
+            }
+            if (include_cache_ == nullptr)
+            {
+                throw Error(directive_name, d->line, "Includes are not enabled for this parse");
+            }
+            if (!context_.InSection())
+            {
+                throw Error("Incbin directive used outside of a section", d->line);
+            }
+
+            // The blob is never tokenized, its bytes are copied straight out of the mapping
+            MappedFile blob;
+            try
+            {
+                blob = MappedFile(include_cache_->Resolve(std::string(current_path_), d->args[0]));
+            }
+            catch (const std::exception &e)
+            {
+                throw Error(d->args[0], d->line, e.what());
+            }
+
+            size_t offset = d->args.size() > 1 ? ParseCount(d->args[1], d->line) : 0;
+            size_t length = d->args.size() > 2 ? ParseCount(d->args[2], d->line) : blob.size() - std::min(offset, blob.size());
+            if (offset > blob.size() || length > blob.size() - offset)
+            {
+                throw Error(directive_name, d->line, "Range is past the end of the file");
+            }
+
+            Section &section = context_.CurrentSection();
+            section.size += length;
+            section.data.insert(section.data.end(), blob.data() + offset, blob.data() + offset + length);
+        }
+        else if (directive == Directive::REPT || directive == Directive::ENDR ||
+                 directive == Directive::FILL || directive == Directive::ZERO)
+        {
+            ParseRepeatDirective(directive, d);
+        }
+        else if (directive == Directive::SPACE)
         {
             if (d->args.size() != 1)
             {
@@ -440,37 +923,28 @@ namespace cforge
             // Convert the argument to a size_t
             size_t space_size = std::stoul(std::string(d->args[0]));
             // Make sure we're in a valid section for .space
-            if (current_section_.empty())
+            if (!context_.InSection())
             {
                 throw Error("Space directive used outside of a section", d->line);
             }
-            // Update the section size map
-            section_size_map_[current_section_] += space_size;
+            // Update the section size
+            Section &section = context_.CurrentSection();
+            section.size += space_size;
             // Initialize the section data with zeros
-            section_data_map_[current_section_].resize(
-                section_data_map_[current_section_].size() + space_size, 0);
+            section.data.resize(section.data.size() + space_size, 0);
         }
         // Check for valid data directive
-        else if (IsValidDataType(d->name))
+        else if (DataEntrySize(directive) != 0)
         {
             // make sure the data directive exists in a valid section
-            if (!IsValidDataTypeSection(current_section_))
+            if (!context_.InSection() || !InstructionSet::IsValidDataTypeSection(context_.CurrentSectionName()))
             {
                 throw Error(directive_name, d->line, "Data directive used in invalid section");
             }
 
-            // Calculate the size of the data
-            size_t data_size = InstructionSet::CalculateDataSize(d->name, d->args);
-            section_size_map_[current_section_] += data_size;
-
-            // Convert data to bytes
-            std::vector<uint8_t> data_bytes = InstructionSet::GetDataBytes(d->name, d->args);
-
-            // Store the data in the section data map
-            section_data_map_[current_section_].insert(
-                section_data_map_[current_section_].end(),
-                data_bytes.begin(),
-                data_bytes.end());
+            // Decode the values straight into the section
+            Section &section = context_.CurrentSection();
+            section.size += InstructionSet::AppendDataBytes(d->name, d->args, section.data);
         }
         else
         {
@@ -478,121 +952,442 @@ namespace cforge
             throw Error(directive_name, d->line, "Directive is valid but not handled by the assembler");
         }
 
-        return ptr;
+        return d;
+    }
+
+    void Parser::ParseRepeatDirective(Directive directive, const DirectiveStmt *d)
+    {
+        if (!context_.InSection())
+        {
+            throw Error(d->name, d->line, "Directive used outside of a section");
+        }
+        const SectionId section = context_.current_section;
+        auto &data = context_.sections[section].data;
+        const size_t size_before = data.size();
+
+        if (directive == Directive::REPT)
+        {
+            if (d->args.size() != 1)
+            {
+                throw Error(d->name, d->line, "Expected exactly one argument for .rept directive");
+            }
+
+            // Encode what came before, so only the block's own relocations get copied
+            EncodePendingInstructions();
+            repeat_stack_.push_back({ParseCount(d->args[0], d->line), section, size_before,
+                                     context_.relocations.size(), d->line});
+            return;
+        }
+        else if (directive == Directive::ENDR)
+        {
+            if (!d->args.empty())
+            {
+                throw Error(d->name, d->line, ".endr directive takes no arguments");
+            }
+            if (repeat_stack_.empty())
+            {
+                throw Error(d->name, d->line, ".endr without a matching .rept");
+            }
+            RepeatFrame frame = std::move(repeat_stack_.back());
+            repeat_stack_.pop_back();
+            if (frame.section != section)
+            {
+                throw Error(d->name, d->line, "Section changed inside a .rept block");
+            }
+
+            // The block is complete, encode it once and copy the result
+            EncodePendingInstructions();
+            const size_t block = data.size() - frame.data_start;
+            const size_t relocation_end = context_.relocations.size();
+            if (frame.count == 0)
+            {
+                data.resize(frame.data_start);
+                context_.relocations.resize(frame.relocation_start);
+            }
+            else
+            {
+                if (block != 0 && frame.count > std::numeric_limits<size_t>::max() / block)
+                {
+                    throw Error(d->name, frame.line, "Repeated block is too large");
+                }
+                if (relocation_end != frame.relocation_start && block % 4 != 0)
+                {
+                    throw Error(d->name, frame.line, "Repeated instructions must span a multiple of 4 bytes");
+                }
+
+                Replicate(data, frame.data_start, frame.count - 1);
+
+                // Relocations name instruction words, shift each copy by the block length
+                context_.relocations.reserve(frame.relocation_start + (relocation_end - frame.relocation_start) * frame.count);
+                for (size_t copy = 1; copy < frame.count; ++copy)
+                {
+                    for (size_t r = frame.relocation_start; r < relocation_end; ++r)
+                    {
+                        RelocationEntry relocation = context_.relocations[r];
+                        relocation.instruction_id += copy * block / 4;
+                        context_.relocations.push_back(relocation);
+                    }
+                }
+            }
+        }
+        else if (directive == Directive::FILL)
+        {
+            // .fill <count> [, <size> [, <value>]], `value` is stored little-endian in `size` bytes
+            if (d->args.empty() || d->args.size() > 3)
+            {
+                throw Error(d->name, d->line, ".fill directive must be in the form \".fill <count> [, <size> [, <value>]]\"");
+            }
+            size_t count = ParseCount(d->args[0], d->line);
+            size_t entry_size = d->args.size() > 1 ? ParseCount(d->args[1], d->line) : 1;
+            if (entry_size == 0 || entry_size > 8)
+            {
+                throw Error(d->args[1], d->line, "Fill size must be in range [1, 8]");
+            }
+            int64_t value = 0;
+            if (d->args.size() > 2 && !DecodeInteger(d->args[2], value))
+            {
+                throw Error(d->args[2], d->line, "Invalid fill value");
+            }
+            if (count != 0 && count > std::numeric_limits<size_t>::max() / entry_size)
+            {
+                throw Error(d->name, d->line, "Fill region is too large");
+            }
+
+            if (count != 0)
+            {
+                for (size_t i = 0; i < entry_size; ++i)
+                {
+                    data.push_back(static_cast<uint8_t>(static_cast<uint64_t>(value) >> (i * 8)));
+                }
+                Replicate(data, size_before, count - 1);
+            }
+        }
+        else // ZERO
+        {
+            if (d->args.size() != 1)
+            {
+                throw Error(d->name, d->line, "Expected exactly one argument for .zero directive");
+            }
+            data.resize(size_before + ParseCount(d->args[0], d->line), 0);
+        }
+
+        // Keep the section size in step with its data
+        context_.sections[section].size += data.size() - size_before;
     }
 
-    std::unique_ptr<Stmt> Parser::ParseInstructionStmt()
+    Stmt *Parser::ParseInstructionStmt()
     {
-        std::unique_ptr<Stmt> ptr = MakeListTokenStmt<InstrStmt>();
+        InstrStmt *ptr = MakeListTokenStmt<InstrStmt>();
         // Make sure the instruction lives in a valid section
-        if (current_section_ != ".text")
+        if (!context_.InSection() || context_.CurrentSectionName() != ".text")
         {
             throw Error("Instruction used in non \".text\" section", ptr->line);
         }
 
-        std::string mnemonic =
-            static_cast<InstrStmt *>(ptr.get())->mnemonic;
-        std::vector<std::string> operands =
-            static_cast<InstrStmt *>(ptr.get())->operands;
+        std::string_view mnemonic = ptr->mnemonic;
+        OperandList operands = ptr->operands;
 
-        size_t instruction_size = CalculateInstructionSize(
-            mnemonic,
-            operands);
+        Mnemonic id = InstructionSet::LookupMnemonic(mnemonic);
+        if (id == Mnemonic::INVALID)
+        {
+            throw Error(mnemonic, ptr->line, "Instruction info not found");
+        }
+        size_t instruction_size = InstructionSize(id);
 
         // Will always be .text section*, but this is consistent
-        section_size_map_[current_section_] += instruction_size;
+        Section &section = context_.CurrentSection();
+
+        // Relocations address instructions by word, data emitted into .text may have misaligned it
+        if (section.size % 4 != 0)
+        {
+            throw Error(mnemonic, ptr->line, "Instruction at unaligned offset " + std::to_string(section.size) +
+                                                 " of \".text\", use \".align 2\" before it");
+        }
+        section.size += instruction_size;
+
+        auto &section_data = section.data;
+        size_t start = section_data.size();
 
-        // Compile the instruction
-        CompiledInstruction compiled = InstructionSet::CompileInstruction(
-            mnemonic,
+        if (retain_statements_)
+        {
+            // Layout only: reserve the slot, encoding happens once parsing is done
+            section_data.resize(start + instruction_size);
+            pending_instructions_.push_back({id, operands, start,
+                                             static_cast<uint32_t>(instruction_size), ptr->line});
+            return ptr;
+        }
+
+        // Streaming drops the operands with the statement, encode straight into the section tail
+        section_data.resize(start + InstructionSet::kMaxInstructionSize);
+        size_t written = InstructionSet::EncodeInstruction(
+            id,
             operands,
+            context_,
+            section_data.data() + start,
+            start,
             ptr->line);
+        section_data.resize(start + written);
 
-        // Store the compiled instruction in the section data map
-        auto &section_data = section_data_map_[std::string(current_section_)];
-        section_data.insert(
-            section_data.end(),
-            compiled.bytes.begin(),
-            compiled.bytes.end());
+        return ptr;
+    }
 
-        // Add relocations if any
-        for (const auto &reloc : compiled.relocations)
+    void Parser::EncodePendingInstructions()
+    {
+        const size_t count = pending_instructions_.size();
+        if (count == 0)
         {
-            relocations_.push_back(reloc);
+            return;
         }
 
-        return ptr;
+        size_t blocks = 1;
+        if (pool_ != nullptr)
+        {
+            blocks = std::max<size_t>(1, std::min(pool_->size() * 4, count / kMinEncodeBlock));
+        }
+
+        // Sections no longer grow, so the slots reserved during layout stay put
+        const SectionId text_section = context_.section_names.Find(".text");
+        uint8_t *text = context_.sections[text_section].data.data();
+
+        // Every block collects its relocations in a context of its own,
+        // their symbols are re-interned in source order afterwards
+        std::vector<AssemblyContext> block_contexts(blocks);
+        std::vector<std::exception_ptr> block_errors(blocks);
+        auto encode_block = [&](size_t b)
+        {
+            AssemblyContext &block = block_contexts[b];
+            block.current_section = text_section;
+            try
+            {
+                for (size_t i = count * b / blocks; i < count * (b + 1) / blocks; ++i)
+                {
+                    const PendingInstruction &instruction = pending_instructions_[i];
+                    size_t written = InstructionSet::EncodeInstruction(
+                        instruction.mnemonic,
+                        instruction.operands,
+                        block,
+                        text + instruction.offset,
+                        instruction.offset,
+                        instruction.line);
+                    if (written != instruction.size)
+                    {
+                        throw Error(MnemonicName(instruction.mnemonic), instruction.line,
+                                    "Encoded size does not match the instruction layout");
+                    }
+                }
+            }
+            catch (...)
+            {
+                block_errors[b] = std::current_exception();
+            }
+        };
+
+        if (blocks == 1)
+        {
+            encode_block(0);
+        }
+        else
+        {
+            pool_->ParallelFor(blocks, encode_block);
+        }
+
+        // Report the error closest to the start of the source
+        for (const std::exception_ptr &error : block_errors)
+        {
+            if (error)
+            {
+                std::rethrow_exception(error);
+            }
+        }
+
+        for (AssemblyContext &block : block_contexts)
+        {
+            for (size_t r = 0; r < block.relocations.size(); ++r)
+            {
+                RelocationEntry relocation = block.relocations[r];
+                relocation.symbol = context_.Reference(block.symbols.Get(relocation.symbol));
+                context_.relocations.push_back(relocation);
+            }
+        }
+        pending_instructions_.clear();
     }
 
     IR Parser::Parse(
-        const std::vector<Token> &tokens)
+        const TokenBuffer &tokens)
     {
-        tokens_ = tokens;
+        source_ = tokens.source();
+        offsets_ = tokens.offsets();
+        lengths_ = tokens.lengths();
+        types_ = tokens.types();
+        token_count_ = tokens.size();
         index_ = 0;
+        line_ = 1;
+        stream_ = nullptr;
+        return ParseStatements();
+    }
 
-        // Reset section management
-        section_size_map_.clear();
-        current_section_ = "";
-        relocations_.clear();
+    IR Parser::Parse(TokenStream &stream)
+    {
+        token_count_ = 0;
+        index_ = 0;
+        line_ = 1;
+        stream_ = &stream;
+        holding_batch_ = false;
 
-        std::vector<std::unique_ptr<Stmt>> stmts;
-        while (index_ < tokens_.size())
+        try
         {
-            // skip blank lines
-            while (index_ < tokens_.size() &&
-                   Peek().type == Token::Type::NEWLINE)
-            {
-                Consume();
-            }
-            if (index_ >= tokens_.size())
-                break;
+            IR ir = ParseStatements();
+            stream_ = nullptr;
+            return ir;
+        }
+        catch (...)
+        {
+            // Unblock the producer before unwinding
+            stream.Cancel();
+            stream_ = nullptr;
+            throw;
+        }
+    }
 
-            Token const tok = Peek();
-            std::unique_ptr<Stmt> stmt;
-            switch (tok.type)
+    IR Parser::ParsePipelined(Lexer &lexer)
+    {
+        auto stream = std::make_unique<TokenStream>();
+        std::thread lexer_thread([&lexer, &stream]()
+                                 { lexer.Analyze(*stream); });
+
+        try
+        {
+            IR ir = Parse(*stream);
+            lexer_thread.join();
+            return ir;
+        }
+        catch (...)
+        {
+            lexer_thread.join();
+            throw;
+        }
+    }
+
+    IR Parser::ParseStatements()
+    {
+        // Reset sections, symbols and relocations
+        context_.Reset();
+
+        // Reset statement storage
+        statements_.clear();
+        stmt_arena_.Reset();
+        pending_instructions_.clear();
+
+        // Reset include and repeat state
+        repeat_stack_.clear();
+        include_stack_.clear();
+        included_files_.clear();
+        included_paths_.clear();
+        current_path_ = source_path_;
+        if (!source_path_.empty())
+        {
+            included_paths_.insert(source_path_); // Including yourself is a no-op
+        }
+
+        try
+        {
+            // An exhausted included file resumes the one that included it
+            while (!AtEnd() || LeaveInclude())
             {
-            case Token::Type::LABEL:
-                stmt = ParseLabelStmt();
-                break;
-            case Token::Type::DIRECTIVE:
-                stmt = ParseDirectiveStmt();
-                break;
-            case Token::Type::IDENTIFIER:
-                stmt = ParseInstructionStmt();
-                break;
-            default:
-                throw Error("Unexpected token '" + std::string(tok.value) + "'",
-                            tok.line_number,
-                            "Expected label, directive or instruction");
+                // skip blank lines
+                while (!AtEnd() &&
+                       Peek().type == Token::Type::NEWLINE)
+                {
+                    Consume();
+                }
+                if (AtEnd())
+                    continue;
+
+                Token const tok = Peek();
+                uint32_t line = line_;
+                Stmt *stmt = nullptr;
+                switch (tok.type)
+                {
+                case Token::Type::LABEL:
+                    stmt = ParseLabelStmt();
+                    break;
+                case Token::Type::DIRECTIVE:
+                    stmt = ParseDirectiveStmt();
+                    break;
+                case Token::Type::IDENTIFIER:
+                    stmt = ParseInstructionStmt();
+                    break;
+                default:
+                    throw Error("Unexpected token '" + std::string(tok.value) + "'",
+                                line,
+                                "Expected label, directive or instruction");
+                }
+
+                // consume a trailing newline if present
+                if (!AtEnd() &&
+                    Peek().type == Token::Type::NEWLINE)
+                {
+                    Consume();
+                }
+
+                // The statement is fully encoded at this point, only keep it if asked to
+                if (retain_statements_)
+                {
+                    statements_.push_back(stmt);
+                }
+                else
+                {
+                    stmt_arena_.Reset();
+                }
             }
 
-            // consume a trailing newline if present
-            if (index_ < tokens_.size() &&
-                Peek().type == Token::Type::NEWLINE)
+            if (!repeat_stack_.empty())
             {
-                Consume();
+                throw Error(".rept", repeat_stack_.back().line, "Missing .endr");
             }
-            stmts.push_back(std::move(stmt));
+        }
+        catch (...)
+        {
+            // Instructions before the failing statement are laid out but not encoded yet,
+            // an error among them comes first in the source and is the one to report
+            EncodePendingInstructions();
+            throw;
+        }
+
+        // Every offset is known now, encode the instruction table
+        EncodePendingInstructions();
+
+        if (verbose_)
+        {
+            PrintSummary();
         }
 
+        // Create ir object
+        IR ir = context_.ReleaseIR(); // Move sections, symbols and relocations to IR
+        ir.version = "1.1";          // Set the IR version
+        return ir;
+    }
+
+    void Parser::PrintSummary() const
+    {
         // Print all parsed statements for debugging
-        for (const auto &stmt : stmts)
+        for (const Stmt *stmt : statements_)
         {
             switch (stmt->kind)
             {
             case Stmt::Kind::LABEL:
-                std::cout << "Parsed Label: " << static_cast<LabelStmt *>(stmt.get())->name << "\n";
+                std::cout << "Parsed Label: " << context_.symbols.Get(static_cast<const LabelStmt *>(stmt)->name) << "\n";
                 break;
             case Stmt::Kind::DIRECTIVE:
-                std::cout << "Parsed Directive: " << static_cast<DirectiveStmt *>(stmt.get())->name << "\n";
-                for (const auto &arg : static_cast<DirectiveStmt *>(stmt.get())->args)
+                std::cout << "Parsed Directive: " << static_cast<const DirectiveStmt *>(stmt)->name << "\n";
+                for (const auto &arg : static_cast<const DirectiveStmt *>(stmt)->args)
                 {
                     std::cout << "  Arg: " << arg << "\n";
                 }
                 break;
             case Stmt::Kind::INSTRUCTION:
-                std::cout << "Parsed Instruction: " << static_cast<InstrStmt *>(stmt.get())->mnemonic << "\n";
-                for (const auto &arg : static_cast<InstrStmt *>(stmt.get())->operands)
+                std::cout << "Parsed Instruction: " << static_cast<const InstrStmt *>(stmt)->mnemonic << "\n";
+                for (const auto &arg : static_cast<const InstrStmt *>(stmt)->operands)
                 {
                     std::cout << "  Operand: " << arg << "\n";
                 }
@@ -602,47 +1397,45 @@ namespace cforge
 
         // Print section sizes
         std::cout << "Section sizes:\n";
-        for (const auto &section : section_size_map_)
+        for (SectionId id = 0; id < context_.sections.size(); ++id)
         {
-            std::cout << "  " << section.first << ": " << section.second << " bytes\n";
+            std::cout << "  " << context_.section_names.Get(id) << ": " << context_.sections[id].size << " bytes\n";
         }
 
-        // Print symbol map
+        // Print symbol table
         std::cout << "Symbol map:\n";
-        for (const auto &symbol : symbol_map_)
+        for (SymbolId id = 0; id < context_.symbol_table.size(); ++id)
         {
-            std::cout << "  " << symbol.first << ": "
-                      << symbol.second.section << " at offset "
-                      << symbol.second.offset << "\n";
+            const SymbolEntry &entry = context_.symbol_table[id];
+            if (entry.defined)
+            {
+                std::cout << "  " << context_.symbols.Get(id) << ": "
+                          << context_.section_names.Get(entry.location.section) << " at offset "
+                          << entry.location.offset << "\n";
+            }
         }
 
         // Print global symbols
         std::cout << "Global symbols:\n";
-        for (const auto &symbol : global_symbols_)
+        for (SymbolId id = 0; id < context_.symbol_table.size(); ++id)
         {
-            std::cout << "  " << symbol << "\n";
+            if (context_.symbol_table[id].global)
+            {
+                std::cout << "  " << context_.symbols.Get(id) << "\n";
+            }
         }
 
         // Print raw data in sections
         std::cout << "Section data:\n";
-        for (const auto &section : section_data_map_)
+        for (SectionId id = 0; id < context_.sections.size(); ++id)
         {
-            std::cout << "  " << section.first << ": ";
-            for (const auto &byte : section.second)
+            std::cout << "  " << context_.section_names.Get(id) << ": ";
+            for (const auto &byte : context_.sections[id].data)
             {
                 std::cout << std::hex << static_cast<int>(byte) << " ";
             }
             std::cout << "\n";
         }
-
-        // Create ir object
-        IR ir;
-        ir.version = "1.1";                                 // Set the IR version
-        ir.section_size_map = std::move(section_size_map_); // Move section sizes to IR
-        ir.section_data = std::move(section_data_map_);     // Move section data to IR
-        ir.symbol_map = std::move(symbol_map_);             // Move symbol map to IR
-        ir.relocations = std::move(relocations_);           // Move relocations to IR
-        return ir;
     }
 
 } // namespace cforge
\ No newline at end of file
@@ -3,7 +3,14 @@
 #include "types.hpp"
 #include "error.hpp"
 #include "instruction_set.hpp"
+#include "assembly_context.hpp"
 #include "ir_parser.hpp"
+#include "include_cache.hpp"
+#include "token.hpp"
+#include "token_stream.hpp"
+#include "thread_pool.hpp"
+#include "arena.hpp"
+#include "span.hpp"
 
 // std
 #include <string>
@@ -11,27 +18,14 @@
 #include <string_view>
 #include <functional>
 #include <memory>
+#include <unordered_set>
 
 namespace cforge
 {
-    // Tokenization
-    struct Token
-    {
-        enum class Type
-        {
-            IDENTIFIER,
-            DIRECTIVE,
-            LABEL,
-            NUMBER,
-            NEWLINE,
-            COMMA,
-        } type;
-
-        std::string_view value;
-        size_t line_number;
-    };
-
     // IR
+    // Statements are allocated from the parser's arena and never destroyed,
+    // so they must stay trivially destructible: names and operands are views
+    // into the source (or interned IDs), operand arrays live in the arena too.
     struct Stmt
     {
         enum class Kind
@@ -41,14 +35,13 @@ namespace cforge
             INSTRUCTION,
         } kind;
         uint32_t line = EOF; // Primarily for logging compiler errors
-        virtual ~Stmt() = default;
     };
 
     struct LabelStmt : public Stmt
     {
-        std::string name;
+        SymbolId name;
 
-        LabelStmt(std::string name) : name(name)
+        LabelStmt(SymbolId name) : name(name)
         {
             kind = Kind::LABEL;
         }
@@ -56,11 +49,12 @@ namespace cforge
 
     struct DirectiveStmt : public Stmt
     {
-        std::string name;
-        std::vector<std::string> args;
+        std::string_view name;
+        OperandList args;
+        Span<Token::Type> arg_types; // Token type of each argument, tells strings from symbols
 
-        DirectiveStmt(std::string name, std::vector<std::string> args)
-            : name(name), args(std::move(args))
+        DirectiveStmt(std::string_view name, OperandList args)
+            : name(name), args(args)
         {
             kind = Kind::DIRECTIVE;
         }
@@ -68,11 +62,11 @@ namespace cforge
 
     struct InstrStmt : public Stmt
     {
-        std::string mnemonic;
-        std::vector<std::string> operands;
+        std::string_view mnemonic;
+        OperandList operands;
 
-        InstrStmt(std::string mnemonic, std::vector<std::string> operands)
-            : mnemonic(mnemonic), operands(std::move(operands))
+        InstrStmt(std::string_view mnemonic, OperandList operands)
+            : mnemonic(mnemonic), operands(operands)
         {
             kind = Kind::INSTRUCTION;
         }
@@ -81,26 +75,81 @@ namespace cforge
     class Lexer
     {
     public:
+        /**
+         * Strategy used by `Analyze` to scan the source.
+         * Both modes emit exactly the same token stream.
+         */
+        enum class ScanMode
+        {
+            SCALAR,     // Character-by-character reference implementation
+            VECTORIZED, // SSE2/AVX2 classification of 16-32 bytes at a time
+        };
+
         Lexer() = default;
         ~Lexer() = default;
 
-        void set_source(const std::string &file) { source_ = file; }
-        const std::string &get_source() const { return source_; }
+        /**
+         * Sets the text to tokenize. The source is not copied: it must outlive the
+         * lexer's tokens, since every `Token::value` is a view into it.
+         */
+        void set_source(std::string_view source) { source_ = source; }
+        std::string_view get_source() const { return source_; }
+
+        void set_scan_mode(ScanMode mode) { scan_mode_ = mode; }
+        ScanMode get_scan_mode() const { return scan_mode_; }
+
+        // Enables the token dump printed after each analysis
+        void set_verbose(bool verbose) { verbose_ = verbose; }
 
         // Runs the tokenization process
         void Analyze();
 
+        /**
+         * Tokenizes the source on `pool`, split into `chunks` pieces at line
+         * boundaries (0 picks one chunk per worker, at least `kMinChunkSize`
+         * bytes each). Produces exactly the tokens `Analyze` would.
+         */
+        void AnalyzeParallel(ThreadPool &pool, size_t chunks = 0);
+
+        /**
+         * Runs the tokenization process, publishing tokens to `stream` in fixed-size
+         * batches instead of collecting them. Meant to run on its own thread while
+         * the parser consumes the stream. The stream is closed when done, carrying
+         * any error the lexer raised.
+         */
+        void Analyze(TokenStream &stream);
+
         // Token Getter
-        const std::vector<Token> &get_tokens() const { return tokens_; }
+        const TokenBuffer &get_tokens() const { return tokens_; }
+
+        // Moves the tokens out, leaving the lexer empty
+        TokenBuffer release_tokens() { return std::move(tokens_); }
+
+        // Smaller sources are not worth splitting
+        static constexpr size_t kMinChunkSize = 256 * 1024;
 
     private:
-        std::string source_;
+        std::string_view source_;
 
         size_t pos_ = 0;
-        size_t line_ = 1;  // 1-based line number
+        size_t end_ = 0;   // Scanning stops here, the end of the current chunk
         char curr_ = '\0'; // Current character
 
-        std::vector<Token> tokens_;
+        TokenBuffer tokens_;
+
+        ScanMode scan_mode_ = ScanMode::VECTORIZED;
+        bool verbose_ = true;
+
+        // Streaming output, null when collecting into `tokens_`
+        TokenStream *stream_ = nullptr;
+        TokenStream::Batch *batch_ = nullptr;
+
+        void Emit(Token::Type type, std::string_view value);
+        void FlushBatch();
+
+        // Tokenizes [begin, end) of the source, appending to `tokens_`
+        void AnalyzeRange(size_t begin, size_t end);
+        void PrintTokens() const;
 
         // Advance / Peek functions
         char Peek() const;
@@ -109,6 +158,7 @@ namespace cforge
 
         // High-level phases
         void Tokenize();
+        void TokenizeVectorized();
         void SkipWhitespaceAndComments();
 
         // Per-Token lexers
@@ -116,54 +166,199 @@ namespace cforge
         void LexLabelOrIdentifier();
         void LexSpecialCharacter();
         void LexNumber();
+        void LexString();
 
         // Predicate-based chunk consumer
         template <typename Predicate>
         std::string_view ConsumeWhile(Predicate &&p, size_t &start);
     };
 
-    class Parser : InstructionSet
+    class Parser
     {
     public:
+        /**
+         * Parses a complete token buffer.
+         * @note The tokens are not copied, `tokens` must outlive the call.
+         */
         IR Parse(
-            const std::vector<Token> &tokens);
+            const TokenBuffer &tokens);
+
+        /**
+         * Parses tokens as they arrive from `stream`, see `Lexer::Analyze(TokenStream &)`.
+         */
+        IR Parse(TokenStream &stream);
+
+        /**
+         * Lexes and parses `lexer`'s source concurrently: the lexer runs on its own
+         * thread and hands token batches to the parser through a `TokenStream`,
+         * so token memory stays constant regardless of the input size.
+         */
+        IR ParsePipelined(Lexer &lexer);
+
+        /**
+         * When disabled, each statement is dropped as soon as it has been encoded
+         * and its arena memory is reused by the next one, so parser memory no
+         * longer grows with the program length. Enabled by default.
+         */
+        void set_retain_statements(bool retain) { retain_statements_ = retain; }
+
+        // Print parsed statements, sections and symbols after each parse (default: true)
+        void set_verbose(bool verbose) { verbose_ = verbose; }
+
+        /**
+         * Encodes the instruction table on `pool` instead of the calling thread.
+         * Only used while statements are retained, streaming parses encode
+         * every instruction as soon as it is parsed. May be null (default).
+         */
+        void set_thread_pool(ThreadPool *pool) { pool_ = pool; }
+
+        /**
+         * Enables `.include "file"`, the files are lexed once by `cache` and
+         * shared with every other parser using it. Every file is included at
+         * most once per parse, repeated includes are skipped. `.incbin` files
+         * are resolved through it too. May be null (default), both directives
+         * are then an error.
+         */
+        void set_include_cache(IncludeCache *cache) { include_cache_ = cache; }
+
+        // Path of the parsed source, relative includes are resolved against its directory
+        void set_source_path(std::string path) { source_path_ = std::move(path); }
+
+        // Files included by the last parse, in first-seen order
+        const std::vector<IncludeCache::FilePtr> &get_included_files() const { return included_files_; }
+
+        // Statements of the last parse, empty unless statements are retained.
+        // Valid until the next call to `Parse`.
+        const std::vector<Stmt *> &get_statements() const { return statements_; }
+
+        // Instructions per encoding task, smaller tables are encoded in one go
+        static constexpr size_t kMinEncodeBlock = 4096;
 
     private:
-        Token &Peek();
-        Token &Consume();
+        /**
+         * @brief Instruction laid out during parsing, encoded once all offsets are known.
+         * Instructions only live in ".text", so the offset is relative to it.
+         */
+        struct PendingInstruction
+        {
+            Mnemonic mnemonic;
+            OperandList operands; // Views into the source and the statement arena
+            size_t offset;
+            uint32_t size;
+            uint32_t line;
+        };
+
+        /**
+         * @brief Token window and cursor of a file suspended by `.include`.
+         * The included file's tokens replace the window until they run out.
+         */
+        struct IncludeFrame
+        {
+            std::string_view source;
+            const uint32_t *offsets;
+            const uint16_t *lengths;
+            const Token::Type *types;
+            size_t token_count;
+            size_t index;
+            uint32_t line;
+            std::string_view path;
+        };
+
+        /**
+         * @brief Open `.rept` block.
+         * The block is parsed and encoded once, `.endr` then copies its bytes
+         * and relocations `count - 1` more times.
+         */
+        struct RepeatFrame
+        {
+            size_t count;
+            SectionId section;
+            size_t data_start;       // Start of the block in the section data
+            size_t relocation_start; // First relocation of the block
+            uint32_t line;
+        };
+
+        IR ParseStatements();
+        void PrintSummary() const;
+
+        // Encodes `pending_instructions_` into their reserved slots, in parallel if possible
+        void EncodePendingInstructions();
+
+        Token Peek();
+        Token Consume();
+
+        // True once all tokens of the current file are consumed, refills from the stream if there is one
+        bool AtEnd();
+
+        // Switches to the tokens of `.include`d `path` (already resolved)
+        void EnterInclude(const std::string &path);
+
+        // Resumes the including file, false if the top-level source is being parsed
+        bool LeaveInclude();
 
         // Consume tokens while `pred(peeked token)` returns true,
         // skipping over commas.
+        // The list is copied into the statement arena, as are the token types if `types` is not null.
         template <typename Pred>
-        std::vector<std::string> ConsumeWhileTokens(Pred &&pred);
+        OperandList ConsumeWhileTokens(Pred &&pred, Span<Token::Type> *types = nullptr);
 
-        // Single-token statement, e.g. LabelStmt("foo")
+        // Single-token statement naming a symbol, e.g. LabelStmt(<id of "foo">)
         template <typename StmtT>
-        std::unique_ptr<Stmt> MakeSingleTokenStmt();
+        StmtT *MakeSingleTokenStmt();
 
         // Head-token + list of comma-separated tokens, e.g.
         // DirectiveStmt(".data", {"4", "8", "16"})
         template <typename StmtT>
-        std::unique_ptr<Stmt> MakeListTokenStmt();
+        StmtT *MakeListTokenStmt();
 
         // Dispatch helpers
-        std::unique_ptr<Stmt> ParseLabelStmt();
-        std::unique_ptr<Stmt> ParseDirectiveStmt();
-        std::unique_ptr<Stmt> ParseInstructionStmt();
-
-        // storage & cursor
-        std::vector<Token> tokens_;
+        Stmt *ParseLabelStmt();
+        Stmt *ParseDirectiveStmt();
+
+        // `.rept`, `.endr`, `.fill` and `.zero`
+        void ParseRepeatDirective(Directive directive, const DirectiveStmt *d);
+        Stmt *ParseInstructionStmt();
+
+        // Statement storage
+        Arena stmt_arena_;
+        std::vector<Stmt *> statements_;
+        std::vector<std::string_view> operand_scratch_;
+        std::vector<Token::Type> operand_type_scratch_;
+        bool retain_statements_ = true;
+        bool verbose_ = true;
+
+        // Packed token window & cursor, the window is either the caller's
+        // buffer or the current batch of `stream_`
+        std::string_view source_;
+        const uint32_t *offsets_ = nullptr;
+        const uint16_t *lengths_ = nullptr;
+        const Token::Type *types_ = nullptr;
+        size_t token_count_ = 0;
         size_t index_ = 0;
 
-        // Section management
-        std::unordered_map<std::string, size_t> section_size_map_;
-        std::unordered_map<std::string, std::vector<uint8_t>> section_data_map_; // For "compiled" data
-        std::string current_section_ = "";
+        // Current line, derived from the NEWLINE tokens consumed so far
+        uint32_t line_ = 1;
+
+        TokenStream *stream_ = nullptr;
+        bool holding_batch_ = false;
+
+        // Include state, the included files are kept alive for the statements' views
+        IncludeCache *include_cache_ = nullptr;
+        std::string source_path_;
+        std::string_view current_path_;
+        std::vector<IncludeFrame> include_stack_;
+
+        // Open `.rept` blocks, innermost last
+        std::vector<RepeatFrame> repeat_stack_;
+        std::vector<IncludeCache::FilePtr> included_files_;
+        std::unordered_set<std::string_view> included_paths_; // Views into `included_files_`
+
+        // Sections, symbols and relocations of the current parse
+        AssemblyContext context_;
 
-        // Relocation & linking
-        std::unordered_map<std::string, UnLocalizedOffset> symbol_map_;
-        std::unordered_set<std::string> global_symbols_;
-        std::vector<RelocationEntry> relocations_;
+        // Instruction table of the current parse, see `EncodePendingInstructions`
+        std::vector<PendingInstruction> pending_instructions_;
+        ThreadPool *pool_ = nullptr;
     };
 
 }; // namespace cforge
\ No newline at end of file
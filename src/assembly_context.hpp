@@ -0,0 +1,98 @@
+#pragma once
+
+#include "types.hpp"
+#include "string_interner.hpp"
+
+// std
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace cforge
+{
+    /**
+     * @brief Every piece of state belonging to a single assembly run.
+     * Nothing in the assembler is shared between runs, so independent contexts
+     * can be used from different threads at the same time.
+     */
+    struct AssemblyContext
+    {
+        // Section management, sections are interned like symbols and indexed by ID
+        StringInterner section_names;
+        std::vector<Section> sections;
+        SectionId current_section = kInvalidSection;
+
+        // Relocation & linking, symbols are interned once and indexed by ID
+        StringInterner symbols;
+        std::vector<SymbolEntry> symbol_table;
+        RelocationTable relocations;
+
+        // ID of section `name`, adding an empty section if it is new
+        SectionId SectionNamed(std::string_view name)
+        {
+            SectionId id = section_names.Intern(name);
+            if (id >= sections.size())
+            {
+                sections.resize(section_names.size());
+            }
+            return id;
+        }
+
+        bool InSection() const { return current_section != kInvalidSection; }
+
+        // Only valid while `InSection()`
+        Section &CurrentSection() { return sections[current_section]; }
+        std::string_view CurrentSectionName() const { return section_names.Get(current_section); }
+
+        // Symbol table entry for `id`, growing the table as new IDs appear
+        SymbolEntry &SymbolAt(SymbolId id)
+        {
+            if (id >= symbol_table.size())
+            {
+                symbol_table.resize(symbols.size());
+            }
+            return symbol_table[id];
+        }
+
+        // Interns `name` and makes sure it has a (possibly undefined) symbol entry
+        SymbolId Reference(std::string_view name)
+        {
+            SymbolId id = symbols.Intern(name);
+            SymbolAt(id);
+            return id;
+        }
+
+        // Records a relocation for the instruction word `instruction_id` of the current section
+        void AddRelocation(RelocationEntry::Type type, size_t instruction_id, std::string_view symbol)
+        {
+            relocations.push_back({type, current_section, instruction_id, Reference(symbol)});
+        }
+
+        void Reset()
+        {
+            section_names.clear();
+            sections.clear();
+            current_section = kInvalidSection;
+            symbols.clear();
+            symbol_table.clear();
+            relocations.clear();
+        }
+
+        // Moves the assembled sections and symbols into an `IR`, leaving the context empty
+        IR ReleaseIR()
+        {
+            IR ir;
+            ir.section_names = std::move(section_names);
+            ir.sections = std::move(sections);
+            symbol_table.resize(symbols.size()); // Every interned name gets an entry
+            ir.symbol_names = std::move(symbols);
+            ir.symbol_table = std::move(symbol_table);
+            ir.relocations = std::move(relocations);
+            ir.relocations.Sort();
+            Reset();
+            return ir;
+        }
+    };
+
+} // namespace cforge
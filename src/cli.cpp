@@ -0,0 +1,450 @@
+#include "cli.hpp"
+#include "file_watcher.hpp"
+#include "hash.hpp"
+#include "ir_archive.hpp"
+#include "literal.hpp"
+#include "mapped_file.hpp"
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <ios>
+
+namespace cforge
+{
+    CommandLine ParseCommandLine(const std::vector<std::string> &args)
+    {
+        CommandLine command;
+        for (size_t i = 0; i < args.size(); ++i)
+        {
+            const std::string &arg = args[i];
+            if (arg == "--stream")
+            {
+                command.options.streaming = true;
+            }
+            else if (arg == "--verbose")
+            {
+                command.options.verbose = true;
+            }
+            else if (arg == "-j" || arg == "--jobs")
+            {
+                if (i + 1 >= args.size())
+                {
+                    throw Error("Missing value for " + arg);
+                }
+                command.options.jobs = std::strtoul(args[++i].c_str(), nullptr, 10);
+            }
+            else if (arg == "--cache-dir")
+            {
+                if (i + 1 >= args.size())
+                {
+                    throw Error("Missing value for " + arg);
+                }
+                command.options.cache_directory = args[++i];
+            }
+            else if (arg == "-I")
+            {
+                if (i + 1 >= args.size())
+                {
+                    throw Error("Missing value for " + arg);
+                }
+                command.options.include_directories.push_back(args[++i]);
+            }
+            else if (arg.compare(0, 2, "-I") == 0)
+            {
+                command.options.include_directories.push_back(arg.substr(2));
+            }
+            else if (arg == "--archive")
+            {
+                if (i + 1 >= args.size())
+                {
+                    throw Error("Missing value for " + arg);
+                }
+                command.archive_output = args[++i];
+            }
+            else if (arg == "-o")
+            {
+                if (i + 1 >= args.size())
+                {
+                    throw Error("Missing value for " + arg);
+                }
+                command.output = args[++i];
+            }
+            else if (arg == "--section-order")
+            {
+                if (i + 1 >= args.size())
+                {
+                    throw Error("Missing value for " + arg);
+                }
+                std::string_view order = args[++i];
+                command.options.section_order.clear();
+                while (!order.empty())
+                {
+                    size_t comma = std::min(order.find(','), order.size());
+                    if (comma != 0)
+                    {
+                        command.options.section_order.emplace_back(order.substr(0, comma));
+                    }
+                    order.remove_prefix(std::min(comma + 1, order.size()));
+                }
+            }
+            else if (arg == "--section-align")
+            {
+                if (i + 1 >= args.size())
+                {
+                    throw Error("Missing value for " + arg);
+                }
+                const std::string &value = args[++i];
+                size_t equals = value.find('=');
+                uint64_t alignment = 0;
+                if (equals == std::string::npos || equals == 0 ||
+                    !DecodeUnsigned(std::string_view(value).substr(equals + 1), alignment) ||
+                    alignment == 0 || (alignment & (alignment - 1)) != 0)
+                {
+                    throw Error("Expected <section>=<power of two> for " + arg + ": " + value);
+                }
+                command.options.section_alignments.emplace_back(value.substr(0, equals), static_cast<size_t>(alignment));
+            }
+            else if (arg == "--watch")
+            {
+                command.watch = true;
+            }
+            else if (arg == "--server")
+            {
+                command.server = true;
+            }
+            else if (arg == "--socket")
+            {
+                if (i + 1 >= args.size())
+                {
+                    throw Error("Missing value for " + arg);
+                }
+                command.socket_path = args[++i];
+            }
+            else if (arg == "-h" || arg == "--help")
+            {
+                command.help = true;
+            }
+            else if (arg.size() > 1 && arg[0] == '-')
+            {
+                throw Error("Unknown option: " + arg);
+            }
+            else
+            {
+                command.inputs.push_back(arg);
+            }
+        }
+        return command;
+    }
+
+    void PrintUsage(std::ostream &out)
+    {
+        out << "Usage: CForge [options] <file.s | file.cfa | @response-file>...\n"
+               "       CForge --server [--socket <path>] [-j <N>]\n"
+               "Options:\n"
+               "  -j, --jobs <N>   Assemble with N threads (default: one per core)\n"
+               "  -I <dir>         Search <dir> for .include files not found next to the includer\n"
+               "  --stream         Lex on a separate thread and drop statements once encoded\n"
+               "  --verbose        Dump tokens, statements and the link map (one file at a time)\n"
+               "  --watch          Keep running and relink whenever an input file is saved\n"
+               "  --archive <out>  Bundle the assembled inputs into the archive <out> instead of linking\n"
+               "  -o <file>        Write the linked image to <file> instead of printing it\n"
+               "  --section-order <a,b,...>  Place these sections first, in order (default: .text,.rodata,.data,.bss)\n"
+               "  --section-align <s>=<n>    Start section <s> at a multiple of <n> bytes\n"
+               "  --cache-dir <d>  Reuse assembled modules stored in <d> by earlier runs\n"
+               "  --server         Stay resident and serve CForgeClient requests\n"
+               "  --socket <path>  Socket of the server (default: $CFORGE_SOCKET, else $XDG_RUNTIME_DIR/cforge.sock,\n"
+               "                   else /tmp/cforge-<uid>/cforge.sock)\n"
+               "  -h, --help       Show this message\n";
+    }
+
+    namespace
+    {
+        void PrintImage(const std::vector<uint8_t> &linked_output, std::ostream &out)
+        {
+            out << "Linked output size: " << linked_output.size() << " bytes" << std::endl;
+
+            // Write linked output, formatted by hand into blocks rather than byte by byte through the stream
+            static const char kDigits[] = "0123456789abcdef";
+            constexpr size_t kBlockSize = 64 * 1024;
+            std::string block;
+            block.reserve(kBlockSize + 3);
+            for (uint8_t byte : linked_output)
+            {
+                if (byte >= 0x10)
+                {
+                    block.push_back(kDigits[byte >> 4]);
+                }
+                block.push_back(kDigits[byte & 0xF]);
+                block.push_back(' ');
+                if (block.size() >= kBlockSize)
+                {
+                    out.write(block.data(), static_cast<std::streamsize>(block.size()));
+                    block.clear();
+                }
+            }
+            out.write(block.data(), static_cast<std::streamsize>(block.size()));
+        }
+
+        // Writes `image` to the file `path` through a mapping
+        void WriteImage(const std::vector<uint8_t> &image, const std::string &path, std::ostream &out)
+        {
+            MappedOutputFile file(path, image.size());
+            std::copy(image.begin(), image.end(), file.data());
+            file.Commit();
+            out << "Wrote " << image.size() << " bytes to " << path << std::endl;
+        }
+
+        /**
+         * Reassembles the `dirty` inputs whose contents or included files changed
+         * since their module was built, failed files are reset so the next save
+         * retries them. The files each dirty input includes are watched from now on.
+         * @return Number of files assembled, or -1 if any of them failed.
+         */
+        long Reassemble(Driver &driver,
+                        FileWatcher &watcher,
+                        const std::vector<std::string> &inputs,
+                        const std::vector<size_t> &dirty,
+                        std::vector<Driver::Module> &modules,
+                        std::vector<uint64_t> &hashes,
+                        std::ostream &err)
+        {
+            // Included files are read as they are now, not as the last build saw them
+            IncludeCache &includes = driver.includes();
+            includes.clear();
+
+            std::vector<size_t> indices;
+            std::vector<std::string> paths;
+            std::vector<uint64_t> new_hashes;
+            for (size_t i : dirty)
+            {
+                uint64_t hash = 0;
+                std::vector<std::string> included;
+                try
+                {
+                    MappedFile file(inputs[i]);
+                    hash = HashBytes(file.view());
+                    included = includes.Dependencies(inputs[i], file.view());
+                    for (const std::string &include : included)
+                    {
+                        hash = HashBytes(include, hash ^ includes.HashOf(include));
+                    }
+                }
+                catch (const std::exception &)
+                {
+                    // Let the assembler report the unreadable file
+                }
+                watcher.SetDependencies(i, included);
+
+                // Saving without edits must not cost a rebuild
+                if (modules[i] && hash == hashes[i])
+                {
+                    continue;
+                }
+                indices.push_back(i);
+                paths.push_back(inputs[i]);
+                new_hashes.push_back(hash);
+            }
+
+            std::vector<std::string> errors;
+            std::vector<Driver::Module> rebuilt = driver.AssembleFiles(paths, errors);
+            for (size_t k = 0; k < indices.size(); ++k)
+            {
+                modules[indices[k]] = rebuilt[k];
+                hashes[indices[k]] = rebuilt[k] ? new_hashes[k] : 0;
+            }
+            for (const std::string &error : errors)
+            {
+                err << error << std::endl;
+            }
+            return errors.empty() ? static_cast<long>(indices.size()) : -1;
+        }
+    }
+
+    bool IsArchiveInput(const std::string &input)
+    {
+        return std::filesystem::path(input).extension() == ".cfa";
+    }
+
+    int RunWatch(Driver &driver, const std::vector<std::string> &inputs,
+                 const std::string &output, std::ostream &out, std::ostream &err)
+    {
+        try
+        {
+            if (std::any_of(inputs.begin(), inputs.end(), IsArchiveInput))
+            {
+                throw Error("--watch does not take archives, link them without it");
+            }
+
+            FileWatcher watcher(inputs);
+
+            Linker linker;
+            driver.ConfigureLinker(linker);
+            linker.set_incremental(true);
+
+            std::vector<Driver::Module> modules(inputs.size());
+            std::vector<uint64_t> hashes(inputs.size(), 0); // Contents each module was built from
+            std::vector<Driver::Module> linked;             // Modules of `image`, empty until a link succeeds
+            std::vector<uint8_t> image;
+
+            std::vector<size_t> dirty(inputs.size());
+            for (size_t i = 0; i < dirty.size(); ++i)
+            {
+                dirty[i] = i;
+            }
+
+            while (true)
+            {
+                auto begin = std::chrono::steady_clock::now();
+                long rebuilt = Reassemble(driver, watcher, inputs, dirty, modules, hashes, err);
+                bool complete = std::all_of(modules.begin(), modules.end(),
+                                            [](const Driver::Module &module)
+                                            { return module != nullptr; });
+                if (complete && (rebuilt > 0 || linked.empty()))
+                {
+                    std::vector<const IR *> current;
+                    std::vector<const IR *> previous;
+                    for (size_t i = 0; i < modules.size(); ++i)
+                    {
+                        current.push_back(modules[i].get());
+                        previous.push_back(linked.empty() ? nullptr : linked[i].get());
+                    }
+
+                    try
+                    {
+                        bool incremental = !linked.empty() && linker.Relink(current, previous, image);
+                        if (linked.empty())
+                        {
+                            image = linker.Link(current);
+                        }
+                        linked = modules;
+
+                        auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin);
+                        if (output.empty())
+                        {
+                            PrintImage(image, out);
+                            out << "\n";
+                        }
+                        else
+                        {
+                            WriteImage(image, output, out);
+                        }
+                        out << "Rebuilt " << rebuilt << " of " << inputs.size() << " file(s) and "
+                            << (incremental ? "patched the image" : "linked") << " in "
+                            << elapsed.count() << " ms" << std::endl;
+                    }
+                    catch (const std::exception &e)
+                    {
+                        linked.clear();
+                        err << e.what() << std::endl;
+                    }
+                }
+
+                dirty = watcher.Wait();
+            }
+        }
+        catch (const std::exception &e)
+        {
+            err << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    int RunCommand(Driver &driver, const std::vector<std::string> &inputs,
+                   const std::string &output, std::ostream &out, std::ostream &err)
+    {
+        try
+        {
+            // Archives are only mapped here, the linker decodes the members it needs
+            std::vector<std::string> sources;
+            std::vector<IrArchive> archives;
+            for (const std::string &input : inputs)
+            {
+                if (IsArchiveInput(input))
+                {
+                    archives.emplace_back(input);
+                }
+                else
+                {
+                    sources.push_back(input);
+                }
+            }
+
+            std::vector<std::string> errors;
+            std::vector<Driver::Module> modules = driver.AssembleFiles(sources, errors);
+            if (!errors.empty())
+            {
+                for (const std::string &error : errors)
+                {
+                    err << error << std::endl;
+                }
+                return 1;
+            }
+
+            // link
+            std::vector<IrArchive *> archive_pointers;
+            for (IrArchive &archive : archives)
+            {
+                archive_pointers.push_back(&archive);
+            }
+            if (output.empty())
+            {
+                PrintImage(driver.Link(modules, archive_pointers), out);
+            }
+            else
+            {
+                driver.LinkToFile(modules, archive_pointers, output);
+            }
+
+            return 0;
+        }
+        catch (const std::exception &e)
+        {
+            err << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    int RunArchive(Driver &driver, const std::vector<std::string> &inputs,
+                   const std::string &output, std::ostream &out, std::ostream &err)
+    {
+        try
+        {
+            if (std::any_of(inputs.begin(), inputs.end(), IsArchiveInput))
+            {
+                throw Error("Archives cannot be nested, pass their sources instead");
+            }
+
+            std::vector<std::string> errors;
+            std::vector<Driver::Module> modules = driver.AssembleFiles(inputs, errors);
+            if (!errors.empty())
+            {
+                for (const std::string &error : errors)
+                {
+                    err << error << std::endl;
+                }
+                return 1;
+            }
+
+            std::vector<const IR *> members;
+            std::vector<std::string> names;
+            for (size_t i = 0; i < modules.size(); ++i)
+            {
+                members.push_back(modules[i].get());
+                names.push_back(std::filesystem::path(inputs[i]).filename().string());
+            }
+            IrArchive::WriteFile(members, names, output);
+            out << "Archived " << members.size() << " module(s) into " << output << std::endl;
+
+            return 0;
+        }
+        catch (const std::exception &e)
+        {
+            err << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+} // namespace cforge
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "driver.hpp"
+
+// std
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace cforge
+{
+    /**
+     * @brief Parsed `CForge` command line.
+     * Shared by the executable and the server, which runs the same commands
+     * on behalf of its clients.
+     */
+    struct CommandLine
+    {
+        Driver::Options options;
+        std::vector<std::string> inputs;
+        bool help = false;
+        bool watch = false;
+        std::string archive_output; // Bundle the inputs into this archive instead of linking
+        std::string output;         // Write the image to this file instead of printing it
+
+        // Server mode, see `Server`
+        bool server = false;
+        std::string socket_path; // Empty for `Server::DefaultSocketPath()`
+    };
+
+    /**
+     * Parses `args` (without the program name), response files must already be expanded.
+     * @throws Error on unknown options or missing option values.
+     */
+    CommandLine ParseCommandLine(const std::vector<std::string> &args);
+
+    void PrintUsage(std::ostream &out);
+
+    /**
+     * Assembles and links `inputs`, writing the image to the file `output`
+     * (or printing it to `out` if empty) and diagnostics to `err`. Archive
+     * inputs only contribute the members the sources need.
+     * @return The process exit code.
+     */
+    int RunCommand(Driver &driver, const std::vector<std::string> &inputs,
+                   const std::string &output, std::ostream &out, std::ostream &err);
+
+    /**
+     * Assembles `inputs` and bundles them into the archive `output`, see
+     * `IrArchive`. Members are named after the input files.
+     * @return The process exit code.
+     */
+    int RunArchive(Driver &driver, const std::vector<std::string> &inputs,
+                   const std::string &output, std::ostream &out, std::ostream &err);
+
+    // True for inputs that are archives to link against rather than sources
+    bool IsArchiveInput(const std::string &input);
+
+    /**
+     * Like `RunCommand`, then keeps watching `inputs` and rebuilds on every
+     * save: only files whose contents changed are reassembled, and the image
+     * is patched in place unless the section layout moved. Returns only if
+     * the files cannot be watched.
+     */
+    int RunWatch(Driver &driver, const std::vector<std::string> &inputs,
+                 const std::string &output, std::ostream &out, std::ostream &err);
+
+} // namespace cforge
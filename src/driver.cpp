@@ -0,0 +1,291 @@
+#include "driver.hpp"
+#include "ir_serializer.hpp"
+#include "mapped_file.hpp"
+#include "version.hpp"
+
+// std
+#include <cctype>
+#include <fstream>
+#include <iterator>
+
+namespace cforge
+{
+    namespace
+    {
+        /**
+         * Everything besides the source bytes a cached module depends on.
+         * No option changes the IR yet, options that do must be added here.
+         */
+        std::string CacheSalt()
+        {
+            return "cforge " + std::string(kAssemblerVersion) +
+                   " ir" + std::to_string(IrSerializer::kFormatVersion);
+        }
+
+        // Options that change the IR of a file, modules cached under other options are not reused
+        std::string ModuleOptions(const Driver::Options &options)
+        {
+            std::string salt;
+            for (const std::string &directory : options.include_directories)
+            {
+                salt += "-I" + directory + '\n';
+            }
+            return salt;
+        }
+
+        // Names and contents of the included files, they change the IR as much as the source does
+        std::string DependencySalt(IncludeCache &includes, const std::vector<std::string> &dependencies)
+        {
+            std::string salt;
+            for (const std::string &dependency : dependencies)
+            {
+                salt += '\n' + dependency + ' ' + std::to_string(includes.HashOf(dependency));
+            }
+            return salt;
+        }
+
+        void ExpandResponseFile(const std::string &path, std::vector<std::string> &out, size_t depth)
+        {
+            if (depth > 16)
+            {
+                throw Error("Response files nested too deeply: " + path);
+            }
+
+            std::ifstream file(path, std::ios::binary);
+            if (!file)
+            {
+                throw Error("Could not open response file: " + path);
+            }
+            std::string contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+            size_t pos = 0;
+            while (pos < contents.size())
+            {
+                while (pos < contents.size() && std::isspace(static_cast<unsigned char>(contents[pos])))
+                {
+                    ++pos;
+                }
+                if (pos >= contents.size())
+                {
+                    break;
+                }
+
+                std::string arg;
+                if (contents[pos] == '"')
+                {
+                    size_t end = contents.find('"', pos + 1);
+                    if (end == std::string::npos)
+                    {
+                        throw Error("Unterminated quote in response file: " + path);
+                    }
+                    arg = contents.substr(pos + 1, end - pos - 1);
+                    pos = end + 1;
+                }
+                else
+                {
+                    size_t start = pos;
+                    while (pos < contents.size() && !std::isspace(static_cast<unsigned char>(contents[pos])))
+                    {
+                        ++pos;
+                    }
+                    arg = contents.substr(start, pos - start);
+                }
+
+                if (arg.size() > 1 && arg[0] == '@')
+                {
+                    ExpandResponseFile(arg.substr(1), out, depth + 1);
+                }
+                else
+                {
+                    out.push_back(std::move(arg));
+                }
+            }
+        }
+
+        std::vector<const IR *> ModulePointers(const std::vector<Driver::Module> &modules)
+        {
+            std::vector<const IR *> irs;
+            irs.reserve(modules.size());
+            for (const Driver::Module &module : modules)
+            {
+                irs.push_back(module.get());
+            }
+            return irs;
+        }
+    }
+
+    Driver::Driver(const Options &options, ThreadPool &pool, ModuleCache *cache)
+        : options_(options), pool_(pool), cache_(cache), module_options_(ModuleOptions(options)),
+          includes_(options.include_directories)
+    {
+        if (!options_.cache_directory.empty())
+        {
+            disk_cache_ = std::make_unique<IrCache>(options_.cache_directory);
+        }
+    }
+
+    size_t Driver::ThreadCount(const Options &options)
+    {
+        // Dumps from several files at once would interleave
+        return options.verbose ? 1 : options.jobs;
+    }
+
+    std::vector<std::string> Driver::ExpandResponseFiles(const std::vector<std::string> &args)
+    {
+        std::vector<std::string> expanded;
+        expanded.reserve(args.size());
+        for (const std::string &arg : args)
+        {
+            if (arg.size() > 1 && arg[0] == '@')
+            {
+                ExpandResponseFile(arg.substr(1), expanded, 0);
+            }
+            else
+            {
+                expanded.push_back(arg);
+            }
+        }
+        return expanded;
+    }
+
+    Driver::Module Driver::AssembleFile(const std::string &path)
+    {
+        if (cache_ == nullptr)
+        {
+            return std::make_shared<const IR>(Assemble(path, nullptr));
+        }
+
+        ModuleCache::Stamp stamp = ModuleCache::StampOf(path);
+        if (Module module = cache_->Find(path, module_options_, stamp))
+        {
+            return module;
+        }
+        ModuleCache::Dependencies dependencies;
+        Module module = std::make_shared<const IR>(Assemble(path, &dependencies));
+        cache_->Store(path, module_options_, stamp, module, std::move(dependencies));
+        return module;
+    }
+
+    IR Driver::Assemble(const std::string &path, ModuleCache::Dependencies *dependencies)
+    {
+        // Map the source file, tokens point straight into the mapping
+        MappedFile file(path);
+
+        // Verbose runs always assemble, so the dumps are complete
+        bool cached = disk_cache_ != nullptr && !options_.verbose;
+
+        // Only caches care about includes before the parse, so only they pay for the scan
+        std::vector<std::string> included;
+        if (cached || dependencies != nullptr)
+        {
+            included = includes_.Dependencies(path, file.view());
+        }
+        if (dependencies != nullptr)
+        {
+            for (const std::string &include : included)
+            {
+                dependencies->emplace_back(include, ModuleCache::StampOf(include));
+            }
+        }
+
+        IrCache::Key key;
+        if (cached)
+        {
+            key = IrCache::KeyOf(file.view(), CacheSalt() + DependencySalt(includes_, included));
+            if (std::optional<IR> ir = disk_cache_->Load(key))
+            {
+                return std::move(*ir);
+            }
+        }
+
+        Lexer lexer;
+        lexer.set_verbose(options_.verbose);
+        lexer.set_source(file.view());
+
+        Parser parser;
+        parser.set_verbose(options_.verbose);
+        parser.set_thread_pool(&pool_);
+        parser.set_include_cache(&includes_);
+        parser.set_source_path(path);
+        IR ir;
+        if (options_.streaming)
+        {
+            // Constant memory: statements are dropped once encoded
+            parser.set_retain_statements(false);
+            ir = parser.ParsePipelined(lexer);
+        }
+        else
+        {
+            lexer.AnalyzeParallel(pool_);
+            ir = parser.Parse(lexer.get_tokens());
+        }
+
+        if (cached)
+        {
+            disk_cache_->Store(key, ir);
+        }
+        return ir;
+    }
+
+    std::vector<Driver::Module> Driver::AssembleFiles(const std::vector<std::string> &paths,
+                                                      std::vector<std::string> &errors)
+    {
+        // Every build sees the included files as they are when it starts
+        includes_.clear();
+
+        std::vector<Module> modules(paths.size());
+        std::vector<std::string> file_errors(paths.size());
+
+        pool_.ParallelFor(paths.size(), [&](size_t i)
+                          {
+                              try
+                              {
+                                  modules[i] = AssembleFile(paths[i]);
+                              }
+                              catch (const std::exception &e)
+                              {
+                                  file_errors[i] = paths[i] + ": " + e.what();
+                              } });
+
+        // Report in input order, independent of scheduling
+        for (std::string &error : file_errors)
+        {
+            if (!error.empty())
+            {
+                errors.push_back(std::move(error));
+            }
+        }
+        return modules;
+    }
+
+    std::vector<uint8_t> Driver::Link(const std::vector<Module> &modules,
+                                      const std::vector<IrArchive *> &archives) const
+    {
+        Linker linker;
+        ConfigureLinker(linker);
+        return linker.Link(ModulePointers(modules), archives);
+    }
+
+    void Driver::LinkToFile(const std::vector<Module> &modules,
+                            const std::vector<IrArchive *> &archives,
+                            const std::string &path) const
+    {
+        Linker linker;
+        ConfigureLinker(linker);
+        linker.LinkToFile(ModulePointers(modules), archives, path);
+    }
+
+    void Driver::ConfigureLinker(Linker &linker) const
+    {
+        linker.set_verbose(options_.verbose);
+        if (!options_.section_order.empty())
+        {
+            linker.set_section_order(options_.section_order);
+        }
+        for (const auto &alignment : options_.section_alignments)
+        {
+            linker.set_section_alignment(alignment.first, alignment.second);
+        }
+    }
+
+} // namespace cforge
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "assembler.hpp"
+#include "include_cache.hpp"
+#include "ir_cache.hpp"
+#include "linker.hpp"
+#include "module_cache.hpp"
+#include "thread_pool.hpp"
+
+// std
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace cforge
+{
+    /**
+     * @brief Assembles a set of source files and links them into one image.
+     * Every file is lexed and parsed as an independent task on a work-stealing
+     * pool, the resulting modules are linked in input order. Large files are
+     * additionally lexed in chunks and their instructions encoded in blocks on
+     * the same pool.
+     * Drivers are cheap: the pool and the optional module cache are owned by
+     * the caller, so a resident server can share them between requests.
+     * Files pulled in with `.include` are lexed once per `AssembleFiles` call
+     * and shared by every file including them.
+     */
+    class Driver
+    {
+    public:
+        using Module = ModuleCache::Module;
+
+        struct Options
+        {
+            size_t jobs = 0;        // Worker threads, 0 for one per core
+            bool streaming = false; // Lex on a separate thread and drop statements once encoded
+            bool verbose = false;   // Dump tokens, statements and the link map
+            std::string cache_directory; // On-disk IR cache shared between runs, empty to disable
+            std::vector<std::string> include_directories; // Searched by `.include` after the including file's directory
+            std::vector<std::string> section_order;       // Linker section order, empty for the default
+            std::vector<std::pair<std::string, size_t>> section_alignments; // Linker alignment by section name
+        };
+
+        /**
+         * @param pool Runs the per-file tasks, see `ThreadCount` for its size.
+         * @param cache Reuses modules of unchanged files if not null.
+         * @throws Error if `options.cache_directory` cannot be created.
+         */
+        Driver(const Options &options, ThreadPool &pool, ModuleCache *cache = nullptr);
+
+        // Worker threads to create for `options`
+        static size_t ThreadCount(const Options &options);
+
+        /**
+         * @brief Replaces every `@file` argument by the arguments listed in `file`.
+         * Arguments in a response file are separated by whitespace and may be
+         * double-quoted, response files may reference further response files.
+         */
+        static std::vector<std::string> ExpandResponseFiles(const std::vector<std::string> &args);
+
+        // Lexes and parses a single file, large files are lexed in parallel chunks
+        Module AssembleFile(const std::string &path);
+
+        /**
+         * @brief Assembles every file in parallel.
+         * @param errors Receives one "<path>: <message>" entry per failed file.
+         * @return The modules in input order, only meaningful if `errors` is empty.
+         */
+        std::vector<Module> AssembleFiles(const std::vector<std::string> &paths,
+                                          std::vector<std::string> &errors);
+
+        // Links `modules`, pulling in only the members of `archives` they need
+        std::vector<uint8_t> Link(const std::vector<Module> &modules,
+                                  const std::vector<IrArchive *> &archives = {}) const;
+
+        // Same as `Link`, written straight into the file at `path`
+        void LinkToFile(const std::vector<Module> &modules,
+                        const std::vector<IrArchive *> &archives,
+                        const std::string &path) const;
+
+        // Applies the layout and verbosity options to `linker`
+        void ConfigureLinker(Linker &linker) const;
+
+        ThreadPool &pool() { return pool_; }
+        IncludeCache &includes() { return includes_; }
+        const Options &options() const { return options_; }
+
+    private:
+        // Records the files `path` includes in `dependencies` if not null
+        IR Assemble(const std::string &path, ModuleCache::Dependencies *dependencies);
+
+        Options options_;
+        ThreadPool &pool_;
+        ModuleCache *cache_;
+        std::string module_options_; // The options that shape the IR, part of every module cache key
+        std::unique_ptr<IrCache> disk_cache_;
+        IncludeCache includes_;
+    };
+
+} // namespace cforge
@@ -0,0 +1,267 @@
+#pragma once
+
+// std
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace cforge
+{
+    // Base instruction formats of RV32I
+    enum class Format : uint8_t
+    {
+        R,
+        I,
+        S,
+        B,
+        U,
+        J,
+
+        COUNT,
+    };
+
+    /**
+     * @brief A contiguous run of immediate bits.
+     * Bits `imm[imm_lo + width - 1 : imm_lo]` are stored at
+     * `inst[inst_lo + width - 1 : inst_lo]`.
+     */
+    struct ImmediateSlice
+    {
+        uint8_t imm_lo;
+        uint8_t inst_lo;
+        uint8_t width;
+    };
+
+    /**
+     * @brief Bit layout of one instruction format.
+     * Register and function fields sit at the same position in every format,
+     * only their presence varies. The immediate is scattered through `slices`.
+     */
+    struct FormatSpec
+    {
+        bool has_rd;
+        bool has_func3;
+        bool has_rs1;
+        bool has_rs2;
+        bool has_func7;
+
+        uint8_t imm_low_bit;  // Lowest immediate bit that is encoded, lower bits must be zero
+        uint8_t imm_bits;     // Width of the (sign-extended) immediate, 0 if there is none
+        uint8_t slice_count;
+        ImmediateSlice slices[4];
+    };
+
+    // Fixed field positions, see the RISC-V unprivileged spec, chapter 2.2
+    constexpr uint32_t kOpcodeMask = 0x7Fu;
+    constexpr unsigned kRdShift = 7;
+    constexpr unsigned kFunc3Shift = 12;
+    constexpr unsigned kRs1Shift = 15;
+    constexpr unsigned kRs2Shift = 20;
+    constexpr unsigned kFunc7Shift = 25;
+
+    inline constexpr std::array<FormatSpec, static_cast<size_t>(Format::COUNT)> kFormatSpecs = {{
+        // R: func7 | rs2 | rs1 | func3 | rd | opcode
+        {true, true, true, true, true, 0, 0, 0, {}},
+        // I: imm[11:0] | rs1 | func3 | rd | opcode
+        {true, true, true, false, false, 0, 12, 1, {{0, 20, 12}}},
+        // S: imm[11:5] | rs2 | rs1 | func3 | imm[4:0] | opcode
+        {false, true, true, true, false, 0, 12, 2, {{0, 7, 5}, {5, 25, 7}}},
+        // B: imm[12|10:5] | rs2 | rs1 | func3 | imm[4:1|11] | opcode
+        {false, true, true, true, false, 1, 13, 4, {{11, 7, 1}, {1, 8, 4}, {5, 25, 6}, {12, 31, 1}}},
+        // U: imm[31:12] | rd | opcode
+        {true, false, false, false, false, 12, 32, 1, {{12, 12, 20}}},
+        // J: imm[20|10:1|11|19:12] | rd | opcode
+        {true, false, false, false, false, 1, 21, 4, {{12, 12, 8}, {11, 20, 1}, {1, 21, 10}, {20, 31, 1}}},
+    }};
+
+    constexpr const FormatSpec &GetFormatSpec(Format format)
+    {
+        return kFormatSpecs[static_cast<size_t>(format)];
+    }
+
+    constexpr uint32_t LowBits(unsigned width)
+    {
+        return width >= 32 ? 0xFFFFFFFFu : (1u << width) - 1;
+    }
+
+    // Instruction bits occupied by the immediate of `format`
+    constexpr uint32_t ImmediateMask(Format format)
+    {
+        const FormatSpec &spec = GetFormatSpec(format);
+        uint32_t mask = 0;
+        for (size_t i = 0; i < spec.slice_count; ++i)
+        {
+            mask |= LowBits(spec.slices[i].width) << spec.slices[i].inst_lo;
+        }
+        return mask;
+    }
+
+    // Instruction bits occupied by opcode, registers and function codes of `format`
+    constexpr uint32_t FieldMask(Format format)
+    {
+        const FormatSpec &spec = GetFormatSpec(format);
+        return kOpcodeMask |
+               (spec.has_rd ? LowBits(5) << kRdShift : 0) |
+               (spec.has_func3 ? LowBits(3) << kFunc3Shift : 0) |
+               (spec.has_rs1 ? LowBits(5) << kRs1Shift : 0) |
+               (spec.has_rs2 ? LowBits(5) << kRs2Shift : 0) |
+               (spec.has_func7 ? LowBits(7) << kFunc7Shift : 0);
+    }
+
+    namespace detail
+    {
+        // True if the fields and the immediate tile the 32-bit word exactly once
+        constexpr bool TilesWord(Format format)
+        {
+            const FormatSpec &spec = GetFormatSpec(format);
+            uint32_t used = FieldMask(format);
+            for (size_t i = 0; i < spec.slice_count; ++i)
+            {
+                uint32_t bits = LowBits(spec.slices[i].width) << spec.slices[i].inst_lo;
+                if ((used & bits) != 0)
+                {
+                    return false;
+                }
+                used |= bits;
+            }
+            return used == 0xFFFFFFFFu;
+        }
+
+        // True if the slices cover `imm[imm_bits - 1 : imm_low_bit]` exactly once
+        constexpr bool CoversImmediate(Format format)
+        {
+            const FormatSpec &spec = GetFormatSpec(format);
+            uint64_t covered = 0;
+            for (size_t i = 0; i < spec.slice_count; ++i)
+            {
+                uint64_t bits = static_cast<uint64_t>(LowBits(spec.slices[i].width)) << spec.slices[i].imm_lo;
+                if ((covered & bits) != 0)
+                {
+                    return false;
+                }
+                covered |= bits;
+            }
+            uint64_t expected = spec.imm_bits == 0
+                                    ? 0
+                                    : ((uint64_t(1) << spec.imm_bits) - 1) & ~((uint64_t(1) << spec.imm_low_bit) - 1);
+            return covered == expected;
+        }
+    }
+
+    static_assert(detail::TilesWord(Format::R) && detail::CoversImmediate(Format::R), "Invalid R-type layout");
+    static_assert(detail::TilesWord(Format::I) && detail::CoversImmediate(Format::I), "Invalid I-type layout");
+    static_assert(detail::TilesWord(Format::S) && detail::CoversImmediate(Format::S), "Invalid S-type layout");
+    static_assert(detail::TilesWord(Format::B) && detail::CoversImmediate(Format::B), "Invalid B-type layout");
+    static_assert(detail::TilesWord(Format::U) && detail::CoversImmediate(Format::U), "Invalid U-type layout");
+    static_assert(detail::TilesWord(Format::J) && detail::CoversImmediate(Format::J), "Invalid J-type layout");
+
+    namespace detail
+    {
+        template <Format F, size_t... I>
+        constexpr uint32_t ScatterImmediate(uint32_t imm, std::index_sequence<I...>)
+        {
+            constexpr const FormatSpec &spec = GetFormatSpec(F);
+            return (0u | ... | (((imm >> spec.slices[I].imm_lo) & LowBits(spec.slices[I].width)) << spec.slices[I].inst_lo));
+        }
+
+        template <Format F, size_t... I>
+        constexpr uint32_t GatherImmediate(uint32_t word, std::index_sequence<I...>)
+        {
+            constexpr const FormatSpec &spec = GetFormatSpec(F);
+            return (0u | ... | (((word >> spec.slices[I].inst_lo) & LowBits(spec.slices[I].width)) << spec.slices[I].imm_lo));
+        }
+    }
+
+    /**
+     * @brief Places the bits of `imm` where format `F` stores them.
+     * Fully unrolled at compile time, the result contains no branches.
+     */
+    template <Format F>
+    constexpr uint32_t ScatterImmediate(int32_t imm)
+    {
+        return detail::ScatterImmediate<F>(static_cast<uint32_t>(imm),
+                                           std::make_index_sequence<GetFormatSpec(F).slice_count>{});
+    }
+
+    // Inverse of `ScatterImmediate`, without sign extension
+    template <Format F>
+    constexpr uint32_t GatherImmediate(uint32_t word)
+    {
+        return detail::GatherImmediate<F>(word, std::make_index_sequence<GetFormatSpec(F).slice_count>{});
+    }
+
+    /**
+     * @brief Encodes one instruction of format `F`.
+     * Operands the format does not have are ignored.
+     */
+    template <Format F>
+    constexpr uint32_t EncodeFormat(uint8_t opcode, uint8_t func3, uint8_t func7,
+                                    uint8_t rd, uint8_t rs1, uint8_t rs2, int32_t imm)
+    {
+        constexpr const FormatSpec &spec = GetFormatSpec(F);
+        uint32_t word = opcode & kOpcodeMask;
+        if constexpr (spec.has_rd)
+            word |= static_cast<uint32_t>(rd & 0x1F) << kRdShift;
+        if constexpr (spec.has_func3)
+            word |= static_cast<uint32_t>(func3 & 0x07) << kFunc3Shift;
+        if constexpr (spec.has_rs1)
+            word |= static_cast<uint32_t>(rs1 & 0x1F) << kRs1Shift;
+        if constexpr (spec.has_rs2)
+            word |= static_cast<uint32_t>(rs2 & 0x1F) << kRs2Shift;
+        if constexpr (spec.has_func7)
+            word |= static_cast<uint32_t>(func7 & 0x7F) << kFunc7Shift;
+        return word | ScatterImmediate<F>(imm);
+    }
+
+    // Replaces the immediate of an already encoded instruction of format `F`
+    template <Format F>
+    constexpr uint32_t PatchImmediate(uint32_t word, int32_t imm)
+    {
+        return (word & ~ImmediateMask(F)) | ScatterImmediate<F>(imm);
+    }
+
+    // True if `imm` can be encoded by format `format`
+    constexpr bool ImmediateFits(Format format, int64_t imm)
+    {
+        const FormatSpec &spec = GetFormatSpec(format);
+        if (spec.imm_bits == 0)
+        {
+            return imm == 0;
+        }
+        if ((imm & ((int64_t(1) << spec.imm_low_bit) - 1)) != 0)
+        {
+            return false;
+        }
+        int64_t min = -(int64_t(1) << (spec.imm_bits - 1));
+        int64_t max = (int64_t(1) << (spec.imm_bits - 1)) - 1;
+        return imm >= min && imm <= max;
+    }
+
+    // Round trips of the reference encodings in the RISC-V spec
+    static_assert(EncodeFormat<Format::R>(0x33, 0b000, 0b0100000, 10, 11, 12, 0) == 0x40C58533, "sub a0, a1, a2");
+    static_assert(EncodeFormat<Format::I>(0x13, 0b000, 0, 1, 0, 0, -1) == 0xFFF00093, "addi x1, zero, -1");
+    static_assert(EncodeFormat<Format::S>(0x23, 0b010, 0, 0, 2, 10, 8) == 0x00A12423, "sw a0, 8(sp)");
+    static_assert(EncodeFormat<Format::B>(0x63, 0b001, 0, 0, 10, 0, -8) == 0xFE051CE3, "bne a0, zero, -8");
+    static_assert(EncodeFormat<Format::U>(0x37, 0, 0, 5, 0, 0, 0x12345000) == 0x123452B7, "lui t0, 0x12345");
+    static_assert(EncodeFormat<Format::J>(0x6F, 0, 0, 0, 0, 0, 8) == 0x0080006F, "jal zero, 8");
+    static_assert(GatherImmediate<Format::B>(0xFE051CE3) == (static_cast<uint32_t>(-8) & 0x1FFE), "B-type round trip");
+
+    // Little-endian word access, instructions are stored byte by byte in sections
+    inline void StoreWord(uint8_t *out, uint32_t word)
+    {
+        out[0] = static_cast<uint8_t>(word);
+        out[1] = static_cast<uint8_t>(word >> 8);
+        out[2] = static_cast<uint8_t>(word >> 16);
+        out[3] = static_cast<uint8_t>(word >> 24);
+    }
+
+    inline uint32_t LoadWord(const uint8_t *in)
+    {
+        return static_cast<uint32_t>(in[0]) |
+               (static_cast<uint32_t>(in[1]) << 8) |
+               (static_cast<uint32_t>(in[2]) << 16) |
+               (static_cast<uint32_t>(in[3]) << 24);
+    }
+
+} // cforge
@@ -0,0 +1,177 @@
+#include "file_watcher.hpp"
+
+// std
+#include <algorithm>
+#include <cerrno>
+#include <filesystem>
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace cforge
+{
+#if defined(__linux__)
+    FileWatcher::FileWatcher(const std::vector<std::string> &paths)
+    {
+        fd_ = inotify_init1(IN_CLOEXEC);
+        if (fd_ < 0)
+        {
+            throw Error("Failed to initialize inotify");
+        }
+
+        try
+        {
+            for (size_t i = 0; i < paths.size(); ++i)
+            {
+                Watch(std::filesystem::absolute(paths[i]).lexically_normal().string(), i);
+            }
+        }
+        catch (...)
+        {
+            close(fd_);
+            throw;
+        }
+    }
+
+    void FileWatcher::Watch(const std::string &path, size_t index)
+    {
+        files_[path].push_back(index);
+
+        std::string directory = std::filesystem::path(path).parent_path().string();
+        if (watched_.count(directory) != 0)
+        {
+            return;
+        }
+        int wd = inotify_add_watch(fd_, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (wd < 0)
+        {
+            throw Error("Failed to watch directory: " + directory);
+        }
+        watched_[directory] = wd;
+        directories_[wd] = directory;
+    }
+
+    void FileWatcher::SetDependencies(size_t index, const std::vector<std::string> &dependencies)
+    {
+        // Drop the previous set, directories stay watched since other files may live there
+        std::vector<std::string> &current = dependencies_[index];
+        for (const std::string &path : current)
+        {
+            auto file = files_.find(path);
+            if (file == files_.end())
+            {
+                continue;
+            }
+            std::vector<size_t> &indices = file->second;
+            auto it = std::find(indices.begin(), indices.end(), index);
+            if (it != indices.end())
+            {
+                indices.erase(it);
+            }
+            if (indices.empty())
+            {
+                files_.erase(file);
+            }
+        }
+        current.clear();
+
+        for (const std::string &dependency : dependencies)
+        {
+            std::string path = std::filesystem::absolute(dependency).lexically_normal().string();
+            current.push_back(path);
+            Watch(path, index);
+        }
+    }
+
+    FileWatcher::~FileWatcher()
+    {
+        close(fd_);
+    }
+
+    std::vector<size_t> FileWatcher::Wait(int settle_ms)
+    {
+        alignas(inotify_event) char buffer[16 * 1024];
+        std::vector<size_t> changed;
+        while (true)
+        {
+            // Block for the first event, then only wait for the rest of the save
+            pollfd fds{fd_, POLLIN, 0};
+            int ready = poll(&fds, 1, changed.empty() ? -1 : settle_ms);
+            if (ready < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (ready < 0)
+            {
+                throw Error("Failed to wait for file changes");
+            }
+            if (ready == 0)
+            {
+                break;
+            }
+
+            ssize_t size = read(fd_, buffer, sizeof(buffer));
+            if (size < 0 && errno != EINTR && errno != EAGAIN)
+            {
+                throw Error("Failed to read file change events");
+            }
+            if (size > 0)
+            {
+                Collect(buffer, static_cast<size_t>(size), changed);
+            }
+        }
+
+        std::sort(changed.begin(), changed.end());
+        changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+        return changed;
+    }
+
+    void FileWatcher::Collect(const char *buffer, size_t size, std::vector<size_t> &changed) const
+    {
+        for (size_t offset = 0; offset < size;)
+        {
+            const auto *event = reinterpret_cast<const inotify_event *>(buffer + offset);
+            offset += sizeof(inotify_event) + event->len;
+
+            auto directory = directories_.find(event->wd);
+            if (event->len == 0 || directory == directories_.end())
+            {
+                continue;
+            }
+            auto file = files_.find((std::filesystem::path(directory->second) / event->name).string());
+            if (file != files_.end())
+            {
+                changed.insert(changed.end(), file->second.begin(), file->second.end());
+            }
+        }
+    }
+#else
+    FileWatcher::FileWatcher(const std::vector<std::string> &)
+    {
+        throw Error("Watch mode requires inotify, which this platform lacks");
+    }
+
+    FileWatcher::~FileWatcher() = default;
+
+    std::vector<size_t> FileWatcher::Wait(int)
+    {
+        return {};
+    }
+
+    void FileWatcher::SetDependencies(size_t, const std::vector<std::string> &)
+    {
+    }
+
+    void FileWatcher::Watch(const std::string &, size_t)
+    {
+    }
+
+    void FileWatcher::Collect(const char *, size_t, std::vector<size_t> &) const
+    {
+    }
+#endif
+
+} // namespace cforge
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "error.hpp"
+
+// std
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace cforge
+{
+    /**
+     * @brief Reports writes to a fixed set of files, backed by inotify.
+     * The directories containing the files are watched rather than the files
+     * themselves, so editors that save by renaming a temporary file over the
+     * original are noticed too.
+     */
+    class FileWatcher
+    {
+    public:
+        /**
+         * @throws Error if the platform has no inotify or a directory cannot be watched.
+         */
+        explicit FileWatcher(const std::vector<std::string> &paths);
+        ~FileWatcher();
+
+        FileWatcher(const FileWatcher &) = delete;
+        FileWatcher &operator=(const FileWatcher &) = delete;
+
+        /**
+         * Blocks until at least one of the files was written, then collects
+         * the writes that follow within `settle_ms`, since a save is often
+         * several events.
+         * @return Indices into the constructor's `paths`, sorted and unique.
+         */
+        std::vector<size_t> Wait(int settle_ms = 5);
+
+        /**
+         * Replaces the files whose writes are reported as writes to `paths[index]`,
+         * e.g. the files it includes, by `dependencies`.
+         * @throws Error if a new directory cannot be watched.
+         */
+        void SetDependencies(size_t index, const std::vector<std::string> &dependencies);
+
+    private:
+        // Reports writes to `path` as writes to `paths[index]`
+        void Watch(const std::string &path, size_t index);
+
+        // Adds the files an event batch in `buffer` refers to
+        void Collect(const char *buffer, size_t size, std::vector<size_t> &changed) const;
+
+        int fd_ = -1;
+        std::unordered_map<int, std::string> directories_;                  // Watch descriptor to directory
+        std::unordered_map<std::string, int> watched_;                      // Directory to watch descriptor
+        std::unordered_map<std::string, std::vector<size_t>> files_;        // Normalized path to indices into `paths`
+        std::unordered_map<size_t, std::vector<std::string>> dependencies_; // Index to its normalized dependencies
+    };
+
+} // namespace cforge
@@ -0,0 +1,54 @@
+#pragma once
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+namespace cforge
+{
+
+	// Final avalanche step of MurmurHash3
+	inline uint64_t MixHash(uint64_t h)
+	{
+		h ^= h >> 33;
+		h *= 0xFF51AFD7ED558CCDull;
+		h ^= h >> 33;
+		h *= 0xC4CEB9FE1A85EC53ull;
+		h ^= h >> 33;
+		return h;
+	}
+
+	/**
+	 * @brief Fast non-cryptographic 64-bit hash, consuming 8 bytes per step.
+	 * @note Stable across runs and platforms of the same endianness.
+	 */
+	inline uint64_t HashBytes(const void *data, size_t size, uint64_t seed = 0)
+	{
+		constexpr uint64_t kMul = 0x9E3779B97F4A7C15ull;
+		const auto *p = static_cast<const unsigned char *>(data);
+		uint64_t h = seed ^ (static_cast<uint64_t>(size) * kMul);
+
+		while (size >= 8)
+		{
+			uint64_t word;
+			std::memcpy(&word, p, 8);
+			h = (h ^ MixHash(word)) * kMul;
+			p += 8;
+			size -= 8;
+		}
+
+		uint64_t tail = 0;
+		if (size != 0)
+			std::memcpy(&tail, p, size);
+		h = (h ^ MixHash(tail)) * kMul;
+		return MixHash(h);
+	}
+
+	inline uint64_t HashBytes(std::string_view str, uint64_t seed = 0)
+	{
+		return HashBytes(str.data(), str.size(), seed);
+	}
+
+} // cforge
@@ -0,0 +1,225 @@
+#include "include_cache.hpp"
+#include "assembler.hpp"
+#include "hash.hpp"
+
+// std
+#include <filesystem>
+#include <unordered_set>
+
+namespace cforge
+{
+    IncludeCache::IncludeCache(std::vector<std::string> directories)
+        : directories_(std::move(directories))
+    {
+    }
+
+    std::string IncludeCache::Resolve(const std::string &including_path, std::string_view name) const
+    {
+        std::filesystem::path relative(name);
+        if (relative.is_absolute())
+        {
+            return relative.lexically_normal().string();
+        }
+
+        std::error_code error;
+        std::filesystem::path candidate = (std::filesystem::path(including_path).parent_path() / relative).lexically_normal();
+        if (std::filesystem::is_regular_file(candidate, error))
+        {
+            return candidate.string();
+        }
+        for (const std::string &directory : directories_)
+        {
+            candidate = (std::filesystem::path(directory) / relative).lexically_normal();
+            if (std::filesystem::is_regular_file(candidate, error))
+            {
+                return candidate.string();
+            }
+        }
+        throw Error("Included file not found: " + std::string(name));
+    }
+
+    IncludeCache::FilePtr IncludeCache::Get(const std::string &path)
+    {
+        std::promise<FilePtr> promise;
+        std::shared_future<FilePtr> future;
+        bool owner = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = files_.find(path);
+            if (it != files_.end())
+            {
+                future = it->second;
+            }
+            else
+            {
+                future = promise.get_future().share();
+                files_.emplace(path, future);
+                owner = true;
+            }
+        }
+
+        // The first caller lexes, everybody else waits for its result
+        if (owner)
+        {
+            try
+            {
+                auto file = std::make_shared<File>();
+                file->path = path;
+                file->mapping = MappedFile(path);
+
+                Lexer lexer;
+                lexer.set_verbose(false);
+                lexer.set_source(file->mapping.view());
+                lexer.Analyze();
+                file->tokens = lexer.release_tokens();
+
+                promise.set_value(std::move(file));
+            }
+            catch (...)
+            {
+                promise.set_exception(std::current_exception());
+            }
+        }
+        return future.get();
+    }
+
+    IncludeCache::Scan IncludeCache::ScanSource(const std::string &path, std::string_view source) const
+    {
+        constexpr std::string_view kPrefix = ".inc";
+
+        Scan scan;
+        for (size_t pos = source.find(kPrefix); pos != std::string_view::npos;
+             pos = source.find(kPrefix, pos + kPrefix.size()))
+        {
+            std::string_view rest = source.substr(pos + kPrefix.size());
+            std::vector<std::string> *list = nullptr;
+            size_t open = 0;
+            if (rest.compare(0, 4, "lude") == 0)
+            {
+                list = &scan.includes;
+                open = 4;
+            }
+            else if (rest.compare(0, 3, "bin") == 0)
+            {
+                list = &scan.binaries;
+                open = 3;
+            }
+            else
+            {
+                continue;
+            }
+
+            while (open < rest.size() && (rest[open] == ' ' || rest[open] == '\t'))
+            {
+                ++open;
+            }
+            if (open >= rest.size() || rest[open] != '"')
+            {
+                continue;
+            }
+            size_t close = rest.find_first_of("\"\n", open + 1);
+            if (close == std::string_view::npos || rest[close] != '"')
+            {
+                continue;
+            }
+
+            try
+            {
+                list->push_back(Resolve(path, rest.substr(open + 1, close - open - 1)));
+            }
+            catch (const std::exception &)
+            {
+                // Commented out or misspelled, either way not a dependency yet
+            }
+        }
+        return scan;
+    }
+
+    std::shared_ptr<const IncludeCache::Scan> IncludeCache::ScanOf(const std::string &path)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = scans_.find(path);
+            if (it != scans_.end())
+            {
+                return it->second;
+            }
+        }
+
+        MappedFile file(path);
+        auto scan = std::make_shared<const Scan>(ScanSource(path, file.view()));
+
+        // Another thread may have scanned it meanwhile, both results are equal
+        std::lock_guard<std::mutex> lock(mutex_);
+        return scans_.emplace(path, std::move(scan)).first->second;
+    }
+
+    std::vector<std::string> IncludeCache::Dependencies(const std::string &path, std::string_view source)
+    {
+        std::vector<std::string> dependencies;
+        std::vector<std::string> sources; // Work list of included sources still to scan
+        std::unordered_set<std::string> seen{path};
+        auto add = [&](const Scan &scan)
+        {
+            for (const std::string &include : scan.includes)
+            {
+                if (seen.insert(include).second)
+                {
+                    dependencies.push_back(include);
+                    sources.push_back(include);
+                }
+            }
+            for (const std::string &binary : scan.binaries)
+            {
+                if (seen.insert(binary).second)
+                {
+                    dependencies.push_back(binary);
+                }
+            }
+        };
+        add(ScanSource(path, source));
+
+        while (!sources.empty())
+        {
+            std::string include = std::move(sources.back());
+            sources.pop_back();
+            try
+            {
+                add(*ScanOf(include));
+            }
+            catch (const std::exception &)
+            {
+                // Unreadable, the parser reports it
+            }
+        }
+        return dependencies;
+    }
+
+    uint64_t IncludeCache::HashOf(const std::string &path)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = hashes_.find(path);
+            if (it != hashes_.end())
+            {
+                return it->second;
+            }
+        }
+
+        MappedFile file(path);
+        uint64_t hash = HashBytes(file.view());
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        hashes_.emplace(path, hash);
+        return hash;
+    }
+
+    void IncludeCache::clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        files_.clear();
+        scans_.clear();
+        hashes_.clear();
+    }
+
+} // namespace cforge
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "mapped_file.hpp"
+#include "token.hpp"
+
+// std
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace cforge
+{
+    /**
+     * @brief Files pulled in with `.include`, lexed once per build.
+     * Every file is mapped and tokenized by the first parser that includes
+     * it, all other parsers (on any thread) share the immutable result.
+     */
+    class IncludeCache
+    {
+    public:
+        struct File
+        {
+            std::string path;
+            MappedFile mapping;
+            TokenBuffer tokens; // Views into `mapping`
+        };
+        using FilePtr = std::shared_ptr<const File>;
+
+        // `directories` are searched after the directory of the including file
+        explicit IncludeCache(std::vector<std::string> directories = {});
+
+        /**
+         * Finds the file `.include "name"` in `including_path` refers to.
+         * @return Normalized path, used as the cache key.
+         * @throws Error if no candidate exists.
+         */
+        std::string Resolve(const std::string &including_path, std::string_view name) const;
+
+        /**
+         * Mapped and tokenized file at the resolved `path`, lexed on first use.
+         * Concurrent callers for the same file wait for a single lexer.
+         * @throws Error if the file cannot be read or lexed.
+         */
+        FilePtr Get(const std::string &path);
+
+        /**
+         * Every file `source` (read from `path`) includes or embeds with
+         * `.incbin`, directly or through other includes, in first-seen order.
+         * Found by a plain text search instead of lexing, so a directive inside
+         * a comment is listed too and names that do not resolve are skipped;
+         * the parser reports those. Used to key caches, which only need a
+         * superset of the real dependencies.
+         */
+        std::vector<std::string> Dependencies(const std::string &path, std::string_view source);
+
+        // Hash of the contents of `path`, memoized until `clear`
+        uint64_t HashOf(const std::string &path);
+
+        // Forgets every file, so the next build sees edits. Files still in use stay valid.
+        void clear();
+
+    private:
+        // Resolved `.include` and `.incbin` names of a source, see `Dependencies`
+        struct Scan
+        {
+            std::vector<std::string> includes;
+            std::vector<std::string> binaries; // Not sources, never scanned themselves
+        };
+
+        Scan ScanSource(const std::string &path, std::string_view source) const;
+        std::shared_ptr<const Scan> ScanOf(const std::string &path);
+
+        std::vector<std::string> directories_;
+
+        std::mutex mutex_;
+        std::unordered_map<std::string, std::shared_future<FilePtr>> files_;
+        std::unordered_map<std::string, std::shared_ptr<const Scan>> scans_;
+        std::unordered_map<std::string, uint64_t> hashes_;
+    };
+
+} // namespace cforge
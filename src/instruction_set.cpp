@@ -1,493 +1,488 @@
 #include "instruction_set.hpp"
+#include "literal.hpp"
 
 // std
 #include <algorithm>
+#include <array>
+#include <cctype>
+#include <iterator>
+#include <limits>
 #include <stdexcept>
-#include <iostream>
 
 namespace cforge
 {
 
-    const std::unordered_map<std::string_view, InstructionInfo> InstructionSet::kInstructions = {
-        // R‑type arithmetic & logic (opcode = R_TYPE - 0x33)
-        {"add", {InstructionInfo::Type::R_TYPE, 0b000, 0b0000000, 3}},
-        {"sub", {InstructionInfo::Type::R_TYPE, 0b000, 0b0100000, 3}},
-        {"sll", {InstructionInfo::Type::R_TYPE, 0b001, 0b0000000, 3}},
-        {"slt", {InstructionInfo::Type::R_TYPE, 0b010, 0b0000000, 3}},
-        {"sltu", {InstructionInfo::Type::R_TYPE, 0b011, 0b0000000, 3}},
-        {"xor", {InstructionInfo::Type::R_TYPE, 0b100, 0b0000000, 3}},
-        {"srl", {InstructionInfo::Type::R_TYPE, 0b101, 0b0000000, 3}},
-        {"sra", {InstructionInfo::Type::R_TYPE, 0b101, 0b0100000, 3}},
-        {"or", {InstructionInfo::Type::R_TYPE, 0b110, 0b0000000, 3}},
-        {"and", {InstructionInfo::Type::R_TYPE, 0b111, 0b0000000, 3}},
-
-        // I‑type arithmetic / immediate (opcode = I_TYPE - 0x13)
-        {"addi", {InstructionInfo::Type::I_TYPE, 0b000, /*func7 N/A*/ 0, 3}},
-        {"slti", {InstructionInfo::Type::I_TYPE, 0b010, 0, 3}},
-        {"sltiu", {InstructionInfo::Type::I_TYPE, 0b011, 0, 3}},
-        {"xori", {InstructionInfo::Type::I_TYPE, 0b100, 0, 3}},
-        {"ori", {InstructionInfo::Type::I_TYPE, 0b110, 0, 3}},
-        {"andi", {InstructionInfo::Type::I_TYPE, 0b111, 0, 3}},
-        {"slli", {InstructionInfo::Type::I_TYPE, 0b001, 0b0000000, 3}},
-        {"srli", {InstructionInfo::Type::I_TYPE, 0b101, 0b0000000, 3}},
-        {"srai", {InstructionInfo::Type::I_TYPE, 0b101, 0b0100000, 3}},
-
-        // Loads (opcode = LOAD - 0x03)
-        {"lb", {InstructionInfo::Type::LOAD, 0b000, 0, 2}},
-        {"lh", {InstructionInfo::Type::LOAD, 0b001, 0, 2}},
-        {"lw", {InstructionInfo::Type::LOAD, 0b010, 0, 2}},
-        {"lbu", {InstructionInfo::Type::LOAD, 0b100, 0, 2}},
-        {"lhu", {InstructionInfo::Type::LOAD, 0b101, 0, 2}},
-
-        // Stores (opcode = STORE - 0x23)
-        {"sb", {InstructionInfo::Type::STORE, 0b000, 0, 2}},
-        {"sh", {InstructionInfo::Type::STORE, 0b001, 0, 2}},
-        {"sw", {InstructionInfo::Type::STORE, 0b010, 0, 2}},
-
-        // Branches (opcode = BRANCH - 0x63)
-        {"beq", {InstructionInfo::Type::BRANCH, 0b000, 0, 3}},
-        {"bne", {InstructionInfo::Type::BRANCH, 0b001, 0, 3}},
-        {"blt", {InstructionInfo::Type::BRANCH, 0b100, 0, 3}},
-        {"bge", {InstructionInfo::Type::BRANCH, 0b101, 0, 3}},
-        {"bltu", {InstructionInfo::Type::BRANCH, 0b110, 0, 3}},
-        {"bgeu", {InstructionInfo::Type::BRANCH, 0b111, 0, 3}},
-
-        // Upper immediates (U‑type)
-        {"lui", {InstructionInfo::Type::U_TYPE, 0, 0, 2}},
-        {"auipc", {InstructionInfo::Type::U_TYPE, 0, 0, 2}},
-
-        // Jumps
-        {"jal", {InstructionInfo::Type::J_TYPE, 0, 0, 2}},
-        {"jalr", {InstructionInfo::Type::J_TYPE, 0b000, 0, 2}}, // Note: This instruction is not actually a J_TYPE, but it's compiled in that group
-
-        // Pseudo-instructions
-        {"la", {InstructionInfo::Type::PSEUDO, 0, 0, 2}},
-        {"j", {InstructionInfo::Type::PSEUDO, 0, 0, 2}}};
-
-    const std::unordered_map<std::string_view, uint8_t> InstructionSet::kRegisters = {
-        // Numeric names
-        {"x0", 0x00},
-        {"x1", 0x01},
-        {"x2", 0x02},
-        {"x3", 0x03},
-        {"x4", 0x04},
-        {"x5", 0x05},
-        {"x6", 0x06},
-        {"x7", 0x07},
-        {"x8", 0x08},
-        {"x9", 0x09},
-        {"x10", 0x0A},
-        {"x11", 0x0B},
-        {"x12", 0x0C},
-        {"x13", 0x0D},
-        {"x14", 0x0E},
-        {"x15", 0x0F},
-        {"x16", 0x10},
-        {"x17", 0x11},
-        {"x18", 0x12},
-        {"x19", 0x13},
-        {"x20", 0x14},
-        {"x21", 0x15},
-        {"x22", 0x16},
-        {"x23", 0x17},
-        {"x24", 0x18},
-        {"x25", 0x19},
-        {"x26", 0x1A},
-        {"x27", 0x1B},
-        {"x28", 0x1C},
-        {"x29", 0x1D},
-        {"x30", 0x1E},
-        {"x31", 0x1F},
-
-        // ABI names
-        {"zero", 0x00}, // Hard-wired zero
-        {"ra", 0x01},   // Return address
-        {"sp", 0x02},   // Stack pointer
-        {"gp", 0x03},   // Global pointer
-        {"tp", 0x04},   // Thread pointer
-        {"t0", 0x05},
-        {"t1", 0x06},
-        {"t2", 0x07}, // Temporaries
-        {"s0", 0x08},
-        {"fp", 0x08}, // Saved register / frame pointer
-        {"s1", 0x09}, // Saved register
-        {"a0", 0x0A},
-        {"a1", 0x0B}, // Function arguments / return values
-        {"a2", 0x0C},
-        {"a3", 0x0D},
-        {"a4", 0x0E},
-        {"a5", 0x0F}, // Function arguments
-        {"a6", 0x10},
-        {"a7", 0x11}, // Function arguments
-        {"s2", 0x12},
-        {"s3", 0x13},
-        {"s4", 0x14},
-        {"s5", 0x15}, // Saved registers
-        {"s6", 0x16},
-        {"s7", 0x17},
-        {"s8", 0x18},
-        {"s9", 0x19}, // Saved registers
-        {"s10", 0x1A},
-        {"s11", 0x1B}, // Saved registers
-        {"t3", 0x1C},
-        {"t4", 0x1D},
-        {"t5", 0x1E},
-        {"t6", 0x1F}, // Temporaries
-    };
-
-    const std::unordered_set<std::string_view> InstructionSet::kDirectives = {
-        ".section", ".globl", ".data", ".text", ".byte", ".word", ".dword", ".ascii", ".align", ".space"};
-
-    const std::unordered_map<std::string_view, size_t> InstructionSet::kValidDataTypes = {
-        {".byte", 1}, {".half", 2}, {".word", 4}, {".dword", 8}, {".ascii", 1}};
-
-    const std::unordered_set<std::string_view> InstructionSet::kValidDataTypeSections = {
-        ".data", ".bss", ".rodata"};
-
-    // FIX: Implement all valid registers
-    const std::unordered_map<std::string_view, uint8_t> InstructionSet::kRegisterMap = {
-        {"r0", 0x00}, {"r1", 0x01}, {"r2", 0x02}, {"r3", 0x03}, {"r4", 0x04}, {"r5", 0x05}, {"r6", 0x06}, {"r7", 0x07}, {"sp", 0x0E}, {"pc", 0x0F}};
-
     bool InstructionSet::IsValidDirective(std::string_view directive)
     {
-        return kDirectives.find(directive) != kDirectives.end();
+        return LookupDirective(directive) != Directive::INVALID;
     }
 
     bool InstructionSet::IsValidInstruction(std::string_view mnemonic)
     {
-        return kInstructions.find(mnemonic) != kInstructions.end();
+        return LookupMnemonic(mnemonic) != Mnemonic::INVALID;
     }
 
     bool InstructionSet::IsValidDataType(std::string_view data_type)
     {
-        return kValidDataTypes.find(data_type) != kValidDataTypes.end();
+        return DataEntrySize(LookupDirective(data_type)) != 0;
     }
 
     bool InstructionSet::IsValidDataTypeSection(std::string_view section)
     {
-        return kValidDataTypeSections.find(section) != kValidDataTypeSections.end();
+        return std::find(std::begin(kValidDataTypeSections), std::end(kValidDataTypeSections), section) !=
+               std::end(kValidDataTypeSections);
     }
 
     bool InstructionSet::IsValidRegister(std::string_view reg)
     {
-        return kRegisters.find(reg) != kRegisters.end();
+        return LookupRegister(reg) != kInvalidRegister;
     }
 
     const InstructionInfo *InstructionSet::GetInstructionInfo(std::string_view mnemonic)
     {
-        auto it = kInstructions.find(mnemonic);
+        Mnemonic id = LookupMnemonic(mnemonic);
 
-        if (it == kInstructions.end())
+        if (id == Mnemonic::INVALID)
         {
             throw Error("Instruction info not found for: " + std::string(mnemonic));
         }
-        return &it->second; // Return pointer to the InstructionInfo
+        return GetInstructionInfo(id);
     }
 
     uint8_t InstructionSet::GetRegisterCode(std::string_view reg)
     {
-        auto it = kRegisters.find(reg);
-        std::cout << "Looking for register: \"" << reg << "\"\n";
-        if (it == kRegisters.end())
+        uint8_t code = LookupRegister(reg);
+        if (code == kInvalidRegister)
         {
             throw std::runtime_error("Invalid register: " + std::string(reg));
         }
-        return it->second;
+        return code;
     }
 
-    std::vector<uint8_t> InstructionSet::GetDataBytes(
-        const std::string data_type,
-        const std::vector<std::string> &data)
+    namespace
     {
-        auto it = kValidDataTypes.find(data_type);
-        if (it == kValidDataTypes.end())
-        {
-            throw Error("Invalid data type: " + std::string(data_type));
-        }
-
-        // Convert the data to bytes based on the type
-        size_t entry_size = it->second;
-        std::vector<uint8_t> bytes;
-        bytes.reserve(entry_size * data.size());
-
-        for (const auto &value : data)
+        /**
+         * Decodes every value of `data` into `Size`-byte little-endian entries at `out`.
+         * @return The value that failed to decode or does not fit, empty on success.
+         */
+        template <size_t Size>
+        std::string_view DecodeEntries(OperandList data, uint8_t *out)
         {
-            // Note that the value could be in hex, bin, or decimal format
-            if (value.empty())
-            {
-                throw Error("Empty value for data type: " + std::string(data_type));
-            }
-            try
+            constexpr uint64_t kMax = Size == 8 ? std::numeric_limits<uint64_t>::max() : (uint64_t{1} << (Size * 8)) - 1;
+            constexpr int64_t kMin = Size == 8 ? std::numeric_limits<int64_t>::min() : -(int64_t{1} << (Size * 8 - 1));
+            for (std::string_view value : data)
             {
-                // Convert the value to an integer
-                int64_t int_value = std::stoll(std::string(value), nullptr, 0);
-
-                // Ensure the value fits in the specified entry size
-                if (int_value < 0 || int_value >= (1ULL << (entry_size * 8)))
+                uint64_t entry = 0;
+                bool valid = false;
+                if (!value.empty() && value[0] == '-')
                 {
-                    throw Error("Value out of range for data type: " + std::string(data_type) + " - " + std::string(value));
+                    // Negative entries are stored in two's complement
+                    int64_t signed_entry = 0;
+                    valid = DecodeInteger(value, signed_entry) && signed_entry >= kMin;
+                    entry = static_cast<uint64_t>(signed_entry);
                 }
-
-                // Handle different data types
-                for (size_t i = 0; i < entry_size; ++i)
+                else
                 {
-                    bytes.push_back(static_cast<uint8_t>((int_value >> (i * 8)) & 0xFF));
+                    valid = DecodeUnsigned(value.substr(!value.empty() && value[0] == '+'), entry) && entry <= kMax;
                 }
+                if (!valid)
+                {
+                    return value.empty() ? std::string_view("<empty>") : value;
+                }
+                for (size_t i = 0; i < Size; ++i)
+                {
+                    out[i] = static_cast<uint8_t>(entry >> (i * 8));
+                }
+                out += Size;
             }
-            catch (const std::invalid_argument &)
-            {
-                throw Error("Invalid value for data type: " + std::string(data_type) + " - " + std::string(value));
-            }
+            return {};
         }
+    }
 
-        bytes.shrink_to_fit(); // Ensure the vector is sized correctly
+    std::vector<uint8_t> InstructionSet::GetDataBytes(
+        std::string_view data_type,
+        OperandList data)
+    {
+        std::vector<uint8_t> bytes;
+        AppendDataBytes(data_type, data, bytes);
         return bytes;
     }
 
+    size_t InstructionSet::AppendDataBytes(
+        std::string_view data_type,
+        OperandList data,
+        std::vector<uint8_t> &out)
+    {
+        size_t entry_size = DataEntrySize(LookupDirective(data_type));
+        if (entry_size == 0)
+        {
+            throw Error("Invalid data type: " + std::string(data_type));
+        }
+
+        // One resize for the whole list, entries are decoded in place
+        const size_t start = out.size();
+        const size_t size = entry_size * data.size();
+        out.resize(start + size);
+
+        std::string_view invalid;
+        switch (entry_size)
+        {
+        case 1:
+            invalid = DecodeEntries<1>(data, out.data() + start);
+            break;
+        case 4:
+            invalid = DecodeEntries<4>(data, out.data() + start);
+            break;
+        default:
+            invalid = DecodeEntries<8>(data, out.data() + start);
+            break;
+        }
+
+        if (!invalid.empty())
+        {
+            out.resize(start);
+            throw Error("Invalid or out of range value for data type: " + std::string(data_type) + " - " + std::string(invalid));
+        }
+        return size;
+    }
+
     CompiledInstruction InstructionSet::CompileInstruction(
-        std::string mnemonic,
-        const std::vector<std::string> &operands,
+        std::string_view mnemonic,
+        OperandList operands,
+        AssemblyContext &context,
+        size_t offset,
+        uint32_t line)
+    {
+        Mnemonic id = LookupMnemonic(mnemonic);
+        if (id == Mnemonic::INVALID)
+        {
+            throw Error(mnemonic, line, "Instruction info not found");
+        }
+        return CompileInstruction(id, operands, context, offset, line);
+    }
+
+    CompiledInstruction InstructionSet::CompileInstruction(
+        Mnemonic mnemonic,
+        OperandList operands,
+        AssemblyContext &context,
+        size_t offset,
+        uint32_t line)
+    {
+        CompiledInstruction instruction;
+        instruction.bytes.resize(kMaxInstructionSize);
+        size_t first_relocation = context.relocations.size();
+        size_t size = EncodeInstruction(mnemonic, operands, context,
+                                        instruction.bytes.data(), offset, line);
+        instruction.bytes.resize(size);
+
+        // Hand the relocations to the caller instead of leaving them in the context
+        for (size_t r = first_relocation; r < context.relocations.size(); ++r)
+        {
+            instruction.relocations.push_back(context.relocations[r]);
+        }
+        context.relocations.resize(first_relocation);
+        return instruction;
+    }
+
+    size_t InstructionSet::EncodeInstruction(
+        Mnemonic mnemonic,
+        OperandList operands,
+        AssemblyContext &context,
+        uint8_t *out,
+        size_t offset,
         uint32_t line)
     {
         const InstructionInfo *info = GetInstructionInfo(mnemonic);
 
-        /**
-         * @brief Unique instruction ID for relocations.
-         * @details This is a really sketchy way to handle instruction IDs, by appending 1 for each
-         * 4-byte instruction compiled, which (should) make Linking possible.
-         */
-        static size_t instruction_id = 0;
-        std::cout << "instruction id: " << instruction_id << "\n";
+        // Relocations name the 4-byte word they patch within the section
+        const size_t first_word = offset / 4;
         try
         {
             switch (info->opcode)
             {
             case InstructionInfo::Type::R_TYPE:
-                ++instruction_id;
-                return CompileRTypeInstruction(info, operands);
+                StoreWord(out, EncodeRegisterInstruction(info, operands));
+                return 4;
             case InstructionInfo::Type::I_TYPE:
-                ++instruction_id;
-                return CompileITypeInstruction(info, operands);
-            // case InstructionInfo::Type::LOAD:
-            //     ++instruction_id;
-            //     return CompileLoadStoreInstruction(info, operands);
-            // case InstructionInfo::Type::STORE:
-            //     ++instruction_id;
-            //     return CompileLoadStoreInstruction(info, operands);
+                StoreWord(out, EncodeImmediateInstruction(info, operands));
+                return 4;
+            case InstructionInfo::Type::LOAD:
+                StoreWord(out, EncodeLoadInstruction(info, operands));
+                return 4;
+            case InstructionInfo::Type::STORE:
+                StoreWord(out, EncodeStoreInstruction(info, operands));
+                return 4;
+            case InstructionInfo::Type::BRANCH:
+                StoreWord(out, EncodeBranchInstruction(first_word, info, operands, context));
+                return 4;
+            case InstructionInfo::Type::U_TYPE:
+            case InstructionInfo::Type::AUIPC:
+                StoreWord(out, EncodeUpperInstruction(info, operands));
+                return 4;
             case InstructionInfo::Type::J_TYPE:
-                ++instruction_id;
-                return CompileJTypeInstruction(instruction_id, mnemonic, info, operands);
+                StoreWord(out, EncodeJumpInstruction(first_word, info, operands, context));
+                return 4;
+            case InstructionInfo::Type::JALR:
+                StoreWord(out, EncodeJumpRegisterInstruction(info, operands));
+                return 4;
             case InstructionInfo::Type::PSEUDO:
-                // `instruction_id` incremented by CompilePseudoInstruction
-                return CompilePseudoInstruction(instruction_id, mnemonic, info, operands);
+                return EncodePseudoInstruction(first_word, mnemonic, operands, context, out);
             default:
-                return CompiledInstruction{};
+                throw std::runtime_error("Instruction type is not supported by the encoder");
             }
         }
         catch (const std::exception &e)
         {
-            throw Error(mnemonic, line, e.what());
+            throw Error(MnemonicName(mnemonic), line, e.what());
         }
     }
 
-    CompiledInstruction InstructionSet::CompileRTypeInstruction(
-        const InstructionInfo *info,
-        const std::vector<std::string> &operands)
+    namespace
     {
-        // Expect exactly 3 operands for R-type instructions
-        if (operands.size() != 3)
+        // Encodes `info` as format `F`, see `EncodeFormat`
+        template <Format F>
+        uint32_t Encode(const InstructionInfo *info, uint8_t rd, uint8_t rs1, uint8_t rs2, int32_t imm)
         {
-            throw std::runtime_error("R-type instruction requires exactly 3 operands: ");
+            return EncodeFormat<F>(static_cast<uint8_t>(info->opcode), info->func3, info->func7, rd, rs1, rs2, imm);
         }
 
-        // Convert register operands to codes
-        uint8_t rd = GetRegisterCode(operands[0]);
-        uint8_t rs1 = GetRegisterCode(operands[1]);
-        uint8_t rs2 = GetRegisterCode(operands[2]);
-
-        // Create the instruction bytes
-        CompiledInstruction instruction;
-        instruction.bytes.resize(4);
+        void ExpectOperands(OperandList operands, size_t count, const char *syntax)
+        {
+            if (operands.size() != count)
+            {
+                throw std::runtime_error(std::string("Expected operands: ") + syntax);
+            }
+        }
 
-        uint32_t inst =
-            (static_cast<uint32_t>(info->func7) << 25) |
-            (static_cast<uint32_t>(rs2) << 20) |
-            (static_cast<uint32_t>(rs1) << 15) |
-            (static_cast<uint32_t>(info->func3) << 12) |
-            (static_cast<uint32_t>(rd) << 7) |
-            (static_cast<uint32_t>(info->opcode));
+        // Branch and jump targets are either a label or a numeric offset
+        bool IsLabel(std::string_view operand)
+        {
+            return !operand.empty() && !std::isdigit(static_cast<unsigned char>(operand[0])) &&
+                   operand[0] != '-' && operand[0] != '+';
+        }
 
-        instruction.bytes[0] = inst & 0xFF;
-        instruction.bytes[1] = (inst >> 8) & 0xFF;
-        instruction.bytes[2] = (inst >> 16) & 0xFF;
-        instruction.bytes[3] = (inst >> 24) & 0xFF;
+        int64_t ParseInteger(std::string_view value)
+        {
+            int64_t result = 0;
+            if (!DecodeInteger(value, result))
+            {
+                throw Error("Invalid immediate value: " + std::string(value));
+            }
+            return result;
+        }
 
-        return instruction;
+        /**
+         * @brief Parses an immediate for `format` and checks that it is encodable.
+         * 12-bit immediates may also be written unsigned (e.g. `0xFFF` for -1).
+         */
+        int32_t ParseImmediate(std::string_view value, Format format)
+        {
+            int64_t imm = ParseInteger(value);
+            bool unsigned_12 = (format == Format::I || format == Format::S) && imm >= 0 && imm <= 0xFFF;
+            if (!unsigned_12 && !ImmediateFits(format, imm))
+            {
+                throw std::runtime_error("Immediate out of range: " + std::string(value));
+            }
+            return static_cast<int32_t>(imm);
+        }
     }
 
-    CompiledInstruction InstructionSet::CompileITypeInstruction(
+    uint32_t InstructionSet::EncodeRegisterInstruction(
         const InstructionInfo *info,
-        const std::vector<std::string> &operands)
+        OperandList operands)
     {
-        // Expect 2 register operands and 1 immediate value
-        if (operands.size() != 3)
-        {
-            throw std::runtime_error("I-type instruction requires exactly 3 operands: ");
-        }
+        ExpectOperands(operands, 3, "rd, rs1, rs2");
+        return Encode<Format::R>(info,
+                                 GetRegisterCode(operands[0]),
+                                 GetRegisterCode(operands[1]),
+                                 GetRegisterCode(operands[2]),
+                                 0);
+    }
 
-        // Convert register operands to codes
+    uint32_t InstructionSet::EncodeImmediateInstruction(
+        const InstructionInfo *info,
+        OperandList operands)
+    {
+        ExpectOperands(operands, 3, "rd, rs1, imm");
         uint8_t rd = GetRegisterCode(operands[0]);
         uint8_t rs1 = GetRegisterCode(operands[1]);
-        // Parse the immediate value
-        int32_t imm = 0;
-        try
-        {
-            imm = std::stoi(std::string(operands[2]), nullptr, 0);
-        }
-        catch (const std::invalid_argument &)
+
+        // Shifts take a 5-bit amount, func7 lives in the upper immediate bits
+        if (info->func3 == 0b001 || info->func3 == 0b101)
         {
-            throw Error("Invalid immediate value: " + std::string(operands[2]));
+            int64_t shamt = ParseInteger(operands[2]);
+            if (shamt < 0 || shamt > 31)
+            {
+                throw std::runtime_error("Shift amount must be in range [0, 31]: " + std::string(operands[2]));
+            }
+            return Encode<Format::I>(info, rd, rs1, 0, static_cast<int32_t>(shamt | (info->func7 << 5)));
         }
+        return Encode<Format::I>(info, rd, rs1, 0, ParseImmediate(operands[2], Format::I));
+    }
 
-        // Create the instruction bytes
-        CompiledInstruction instruction;
-        instruction.bytes.resize(4);
-        uint32_t inst =
-            (static_cast<uint32_t>((imm | 0) & 0xFFF) << 20) | // Immediate
-            (static_cast<uint32_t>(rs1) << 15) |               // rs1
-            (static_cast<uint32_t>(info->func3) << 12) |       // func3
-            (static_cast<uint32_t>(rd) << 7) |                 // rd
-            (static_cast<uint32_t>(info->opcode));             // opcode
-        instruction.bytes[0] = inst & 0xFF;
-        instruction.bytes[1] = (inst >> 8) & 0xFF;
-        instruction.bytes[2] = (inst >> 16) & 0xFF;
-        instruction.bytes[3] = (inst >> 24) & 0xFF;
+    uint32_t InstructionSet::EncodeLoadInstruction(
+        const InstructionInfo *info,
+        OperandList operands)
+    {
+        // `rd, offset(rs1)`
+        ExpectOperands(operands, 3, "rd, offset(rs1)");
+        return Encode<Format::I>(info,
+                                 GetRegisterCode(operands[0]),
+                                 GetRegisterCode(operands[2]),
+                                 0,
+                                 ParseImmediate(operands[1], Format::I));
+    }
 
-        return instruction;
+    uint32_t InstructionSet::EncodeStoreInstruction(
+        const InstructionInfo *info,
+        OperandList operands)
+    {
+        // `rs2, offset(rs1)`
+        ExpectOperands(operands, 3, "rs2, offset(rs1)");
+        return Encode<Format::S>(info,
+                                 0,
+                                 GetRegisterCode(operands[2]),
+                                 GetRegisterCode(operands[0]),
+                                 ParseImmediate(operands[1], Format::S));
     }
 
-    // FIX: Doesn't work for jalr
-    CompiledInstruction InstructionSet::CompileJTypeInstruction(
-        const size_t &instruction_id,
-        const std::string mnemonic,
+    uint32_t InstructionSet::EncodeBranchInstruction(
+        size_t instruction_id,
         const InstructionInfo *info,
-        const std::vector<std::string> &operands)
+        OperandList operands,
+        AssemblyContext &context)
     {
-        if (mnemonic == "jal")
-        {
-            // Expect 2 operands: rd and label
-            if (operands.size() != 2)
-            {
-                throw std::runtime_error("J-type instruction requires exactly 2 operands: ");
-            }
+        ExpectOperands(operands, 3, "rs1, rs2, target");
+        uint8_t rs1 = GetRegisterCode(operands[0]);
+        uint8_t rs2 = GetRegisterCode(operands[1]);
 
-            // Convert register operand to code
-            uint8_t rd = GetRegisterCode(operands[0]);
-            std::string label = std::string(operands[1]);
-
-            // Create the instruction bytes
-            CompiledInstruction instruction;
-            instruction.bytes.resize(4);
-            uint32_t inst =
-                (static_cast<uint32_t>(rd) << 7) |     // rd
-                (static_cast<uint32_t>(info->opcode)); // opcode
-
-            instruction.bytes[0] = inst & 0xFF;
-            instruction.bytes[1] = (inst >> 8) & 0xFF;
-            instruction.bytes[2] = (inst >> 16) & 0xFF;
-            instruction.bytes[3] = (inst >> 24) & 0xFF;
-
-            // Add relocation entry for the label
-            instruction.relocations.push_back({
-                RelocationEntry::Type::R_RISC_V_JAL,
-                ".text", // Section must be text TODO: make sure this is checked before this point
-                instruction_id,
-                label,
-            });
-
-            return instruction;
-        }
-        else if (mnemonic == "jalr")
+        int32_t offset = 0;
+        if (IsLabel(operands[2]))
         {
-            throw std::runtime_error("jalr is not implemented yet");
+            context.AddRelocation(RelocationEntry::Type::R_RISC_V_BRANCH, instruction_id, operands[2]);
         }
         else
         {
-            throw std::runtime_error("Invalid J-type mnemonic: " + std::string(mnemonic));
+            offset = ParseImmediate(operands[2], Format::B);
         }
+        return Encode<Format::B>(info, 0, rs1, rs2, offset);
     }
 
-    CompiledInstruction InstructionSet::CompilePseudoInstruction(
-        size_t &instruction_id,
-        const std::string mnemonic,
+    uint32_t InstructionSet::EncodeUpperInstruction(
         const InstructionInfo *info,
-        const std::vector<std::string> &operands)
+        OperandList operands)
     {
-        CompiledInstruction instruction;
-        // TODO: Don't assume all pseudo-instructions are 4 bytes
-
-        if (mnemonic == "la")
+        ExpectOperands(operands, 2, "rd, imm20");
+        int64_t upper = ParseInteger(operands[1]);
+        if (upper < 0 || upper > 0xFFFFF)
         {
-            // Load address pseudo-instruction
-            if (operands.size() != 2)
-            {
-                throw std::runtime_error("la pseudo-instruction requires exactly 2 operands: ");
-            }
+            throw std::runtime_error("Upper immediate must be in range [0, 0xFFFFF]: " + std::string(operands[1]));
+        }
+        return Encode<Format::U>(info, GetRegisterCode(operands[0]), 0, 0, static_cast<int32_t>(upper << 12));
+    }
 
-            std::string reg = operands[0];
+    uint32_t InstructionSet::EncodeJumpInstruction(
+        size_t instruction_id,
+        const InstructionInfo *info,
+        OperandList operands,
+        AssemblyContext &context)
+    {
+        // `jal target` links to ra
+        if (operands.size() != 1 && operands.size() != 2)
+        {
+            throw std::runtime_error("Expected operands: [rd,] target");
+        }
+        uint8_t rd = operands.size() == 2 ? GetRegisterCode(operands[0]) : LookupRegister("ra");
+        std::string_view target = operands[operands.size() - 1];
 
-            uint8_t rd = GetRegisterCode(reg);
+        int32_t offset = 0;
+        if (IsLabel(target))
+        {
+            context.AddRelocation(RelocationEntry::Type::R_RISC_V_JAL, instruction_id, target);
+        }
+        else
+        {
+            offset = ParseImmediate(target, Format::J);
+        }
+        return Encode<Format::J>(info, rd, 0, 0, offset);
+    }
 
-            // Get the address (label) to load
-            std::string label = std::string(operands[1]);
+    uint32_t InstructionSet::EncodeJumpRegisterInstruction(
+        const InstructionInfo *info,
+        OperandList operands)
+    {
+        uint8_t rd = LookupRegister("ra");
+        uint8_t rs1 = 0;
+        int32_t offset = 0;
+        switch (operands.size())
+        {
+        case 1: // `jalr rs1`
+            rs1 = GetRegisterCode(operands[0]);
+            break;
+        case 2: // `jalr rd, rs1`
+            rd = GetRegisterCode(operands[0]);
+            rs1 = GetRegisterCode(operands[1]);
+            break;
+        case 3: // `jalr rd, rs1, offset` or `jalr rd, offset(rs1)`
+        {
+            bool register_first = IsValidRegister(operands[1]);
+            rd = GetRegisterCode(operands[0]);
+            rs1 = GetRegisterCode(operands[register_first ? 1 : 2]);
+            offset = ParseImmediate(operands[register_first ? 2 : 1], Format::I);
+            break;
+        }
+        default:
+            throw std::runtime_error("Expected operands: [rd,] rs1 [, offset]");
+        }
+        return Encode<Format::I>(info, rd, rs1, 0, offset);
+    }
 
-            // Compile as addi replacing label with 0
-            instruction = CompileITypeInstruction(GetInstructionInfo("addi"), {reg, "zero", "0"});
+    size_t InstructionSet::EncodePseudoInstruction(
+        size_t instruction_id,
+        Mnemonic mnemonic,
+        OperandList operands,
+        AssemblyContext &context,
+        uint8_t *out)
+    {
+        switch (mnemonic)
+        {
+        case Mnemonic::LA:
+        {
+            // `la rd, symbol` expands to `lui rd, %hi(symbol)` + `addi rd, rd, %lo(symbol)`
+            ExpectOperands(operands, 2, "rd, symbol");
+            uint8_t rd = GetRegisterCode(operands[0]);
 
-            // Add a relocation entry for the label
-            instruction.relocations.push_back({
-                RelocationEntry::Type::R_RISC_V_LO12_I,
-                ".text",        // Section must be text TODO: make sure this is checked before this point
-                instruction_id, // Instruction ID
-                label,
-            });
+            StoreWord(out, Encode<Format::U>(GetInstructionInfo(Mnemonic::LUI), rd, 0, 0, 0));
+            StoreWord(out + 4, Encode<Format::I>(GetInstructionInfo(Mnemonic::ADDI), rd, rd, 0, 0));
 
-            // Increment the instruction ID
-            ++instruction_id;
+            context.AddRelocation(RelocationEntry::Type::R_RISC_V_HI20, instruction_id, operands[1]);
+            context.AddRelocation(RelocationEntry::Type::R_RISC_V_LO12_I, instruction_id + 1, operands[1]);
+            return 8;
         }
-        else if (mnemonic == "j")
+        case Mnemonic::J:
         {
-            instruction = CompileJTypeInstruction(const_cast<size_t &>(instruction_id),
-                                                  "jal", GetInstructionInfo("jal"),
-                                                  std::vector<std::string>{"x0",
-                                                                           operands[0]});
-            ++instruction_id; // Don't forget to increment the instruction ID for relocations
+            // `j target` is `jal zero, target`
+            ExpectOperands(operands, 1, "target");
+            const std::array<std::string_view, 2> jal_operands = {"zero", operands[0]};
+            StoreWord(out, EncodeJumpInstruction(instruction_id, GetInstructionInfo(Mnemonic::JAL),
+                                                 jal_operands, context));
+            return 4;
         }
-        else
-        {
+        default:
             throw std::runtime_error("Unsupported pseudo-instruction");
         }
-
-        return instruction;
     }
 
     size_t InstructionSet::CalculateDataSize(std::string_view data_type,
-                                             const std::vector<std::string> &data)
+                                             OperandList data)
     {
-        auto it = kValidDataTypes.find(data_type);
-        if (it == kValidDataTypes.end())
+        size_t entry_size = DataEntrySize(LookupDirective(data_type));
+        if (entry_size == 0)
         {
             throw Error("Invalid data type: " + std::string(data_type));
         }
 
-        size_t entry_size = it->second;
         return entry_size * data.size();
     }
 
-    size_t InstructionSet::CalculateInstructionSize(std::string mnemonic,
-                                                    const std::vector<std::string> &operands)
-    {
-        return 4;
-    }
-
 }
\ No newline at end of file
@@ -1,11 +1,12 @@
 #pragma once
 
 #include "types.hpp"
+#include "assembly_context.hpp"
 #include "error.hpp"
+#include "span.hpp"
+#include "isa_tables.hpp"
 
 // std
-#include <unordered_map>
-#include <unordered_set>
 #include <string_view>
 #include <cstdint>
 #include <vector>
@@ -18,31 +19,6 @@ namespace cforge
 {
     using json = nlohmann::json;
 
-    struct InstructionInfo
-    {
-        enum class Type
-        {
-            R_TYPE = 0x33,
-            I_TYPE = 0x13,
-            LOAD = 0x03,
-            STORE = 0x23,
-            BRANCH = 0x63,
-            U_TYPE = 0x37,
-            J_TYPE = 0x6F,
-
-            // Impossible types [0x80:0xFF] (> 7 bit)
-            NONE = 0xFF,
-            PSEUDO = 0xFE,
-        };
-
-        Type opcode;
-
-        uint8_t func3;
-        uint8_t func7;
-
-        uint8_t operand_count;
-    };
-
     struct CompiledInstruction
     {
         std::vector<uint8_t> bytes;               // Compiled instruction bytes
@@ -52,23 +28,13 @@ namespace cforge
     class InstructionSet
     {
     public:
-        // Core instruction information
-        static const std::unordered_map<std::string_view, InstructionInfo> kInstructions;
-
-        // Register mappings
-        static const std::unordered_map<std::string_view, uint8_t> kRegisters;
-
-        // Valid directives
-        static const std::unordered_set<std::string_view> kDirectives;
-
-        // Valid data types / map of data type entry size (in bytes)
-        static const std::unordered_map<std::string_view, size_t> kValidDataTypes;
+        // Largest encoding of a single (pseudo-)instruction, in bytes
+        static constexpr size_t kMaxInstructionSize = 8;
 
-        // Sections where data types may be used
-        static const std::unordered_set<std::string_view> kValidDataTypeSections;
-
-        // Valid register definitions / map for converting to opcodes
-        static const std::unordered_map<std::string_view, uint8_t> kRegisterMap;
+        // Lookups through the compile-time perfect hash tables in `isa_tables.hpp`
+        static Mnemonic LookupMnemonic(std::string_view mnemonic) { return kMnemonicTable.Find(mnemonic, Mnemonic::INVALID); }
+        static Directive LookupDirective(std::string_view directive) { return kDirectiveTable.Find(directive, Directive::INVALID); }
+        static uint8_t LookupRegister(std::string_view reg) { return kRegisterTable.Find(reg, kInvalidRegister); }
 
         // Validation methods
         static bool IsValidInstruction(std::string_view mnemonic);
@@ -78,6 +44,10 @@ namespace cforge
         static bool IsValidRegister(std::string_view reg);
 
         static const InstructionInfo *GetInstructionInfo(std::string_view mnemonic);
+        static const InstructionInfo *GetInstructionInfo(Mnemonic mnemonic)
+        {
+            return &kInstructionInfo[static_cast<size_t>(mnemonic)];
+        }
 
         /**
          * @brief Get the register code for a given register name.
@@ -94,65 +64,108 @@ namespace cforge
          * @return Vector of bytes representing the data.
          */
         static std::vector<uint8_t> GetDataBytes(
-            const std::string data_type,
-            const std::vector<std::string> &data);
+            std::string_view data_type,
+            OperandList data);
+
+        /**
+         * @brief Batch variant of `GetDataBytes`, decodes straight into `out`.
+         * `out` is grown once for the whole list and no value is copied or
+         * allocated on the way. On error `out` is left as it was.
+         * @return Number of bytes appended.
+         */
+        static size_t AppendDataBytes(
+            std::string_view data_type,
+            OperandList data,
+            std::vector<uint8_t> &out);
 
         /**
          * @brief Compiles an instruction into its bytecode representation.
          * @attention This method makes some relocations for labels.
          * @param mnemonic The mnemonic of the instruction.
          * @param operands The operands for the instruction.
+         * @param context Assembly the instruction belongs to, referenced labels are added to it.
+         * @param offset Offset of the instruction in the current section of `context`.
          * @param line The line number in the source code (for error reporting).
-         * @return A vector of bytes representing the compiled instruction.
+         * @return A vector of bytes representing the compiled instruction, the
+         * relocations are returned with it instead of being added to `context`.
          * @note If the instruction requires expansion to 8 bytes, this method will
          * return 8-bytes instead of 4.
          */
         static CompiledInstruction CompileInstruction(
-            std::string mnemonic,
-            const std::vector<std::string> &operands,
+            std::string_view mnemonic,
+            OperandList operands,
+            AssemblyContext &context,
+            size_t offset,
+            uint32_t line = 0);
+
+        // Same as above for a mnemonic that has already been looked up
+        static CompiledInstruction CompileInstruction(
+            Mnemonic mnemonic,
+            OperandList operands,
+            AssemblyContext &context,
+            size_t offset,
             uint32_t line = 0);
 
         /**
-         * @brief Calculates the size of data based on type and amount of values
-         * @attention This method will return UB if data type is invalid
-         * @param data_type Type of data MUST be one of the valid data types
-         * as defined in `kValidDataTypes`.
+         * @brief Allocation-free variant of `CompileInstruction`.
+         * Encodes the instruction straight into `out` and appends its relocations
+         * to `context.relocations`. Relocations are identified by the offset of
+         * the patched word, so the encoder itself keeps no state.
+         * @param out Destination with room for at least `kMaxInstructionSize` bytes.
+         * @param offset Offset of `out` in the current section of `context`.
+         * @return Number of bytes written to `out`.
          */
-        static size_t CalculateDataSize(std::string_view data_type,
-                                        const std::vector<std::string> &data);
+        static size_t EncodeInstruction(
+            Mnemonic mnemonic,
+            OperandList operands,
+            AssemblyContext &context,
+            uint8_t *out,
+            size_t offset,
+            uint32_t line = 0);
 
         /**
-         * @brief Calculates the size of an instruction based on it's mnemonic and operands.
-         * @attention This method is def broken for expanding instructions
+         * @brief Calculates the size of data based on type and amount of values
+         * @attention This method will return UB if data type is invalid
+         * @param data_type Type of data MUST be one of the data directives
+         * (see `DataEntrySize`).
          */
-        static size_t CalculateInstructionSize(std::string mnemonic,
-                                               const std::vector<std::string> &operands);
+        static size_t CalculateDataSize(std::string_view data_type,
+                                        OperandList data);
 
     private:
-        static CompiledInstruction CompileRTypeInstruction(
+        static uint32_t EncodeRegisterInstruction(
+            const InstructionInfo *info,
+            OperandList operands);
+        static uint32_t EncodeImmediateInstruction(
             const InstructionInfo *info,
-            const std::vector<std::string> &operands);
-        static CompiledInstruction CompileITypeInstruction(
+            OperandList operands);
+        static uint32_t EncodeLoadInstruction(
             const InstructionInfo *info,
-            const std::vector<std::string> &operands);
-        static CompiledInstruction CompileLoadStoreInstruction(
+            OperandList operands);
+        static uint32_t EncodeStoreInstruction(
             const InstructionInfo *info,
-            const std::vector<std::string> &operands);
-        static CompiledInstruction CompileBranchInstruction(
+            OperandList operands);
+        static uint32_t EncodeBranchInstruction(
+            size_t instruction_id,
             const InstructionInfo *info,
-            const std::vector<std::string> &operands);
-        static CompiledInstruction CompileUTypeInstruction(
+            OperandList operands,
+            AssemblyContext &context);
+        static uint32_t EncodeUpperInstruction(
             const InstructionInfo *info,
-            const std::vector<std::string_view> &operands);
-        static CompiledInstruction CompileJTypeInstruction(
-            const size_t &instruction_id,
-            const std::string mnemonic,
+            OperandList operands);
+        static uint32_t EncodeJumpInstruction(
+            size_t instruction_id,
             const InstructionInfo *info,
-            const std::vector<std::string> &operands);
-        static CompiledInstruction CompilePseudoInstruction(
-            size_t &instruction_id,
-            const std::string mnemonic,
+            OperandList operands,
+            AssemblyContext &context);
+        static uint32_t EncodeJumpRegisterInstruction(
             const InstructionInfo *info,
-            const std::vector<std::string> &operands);
+            OperandList operands);
+        static size_t EncodePseudoInstruction(
+            size_t instruction_id,
+            Mnemonic mnemonic,
+            OperandList operands,
+            AssemblyContext &context,
+            uint8_t *out);
     };
 }
\ No newline at end of file
@@ -0,0 +1,300 @@
+#include "ir_archive.hpp"
+#include "error.hpp"
+#include "ir_serializer.hpp"
+
+// std
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+namespace cforge
+{
+    namespace
+    {
+        constexpr char kMagic[4] = {'C', 'F', 'A', 'R'};
+
+        // Header field offsets
+        constexpr size_t kVersionField = 4;
+        constexpr size_t kMemberCountField = 8;
+        constexpr size_t kSymbolCountField = 12;
+        constexpr size_t kMemberTableField = 16;
+        constexpr size_t kSymbolIndexField = 24;
+        constexpr size_t kStringTableField = 32;
+        constexpr size_t kStringTableSizeField = 40;
+
+        void Put32(std::string &out, size_t at, uint32_t value)
+        {
+            for (int i = 0; i < 4; ++i)
+            {
+                out[at + i] = static_cast<char>(value >> (i * 8));
+            }
+        }
+
+        void Put64(std::string &out, size_t at, uint64_t value)
+        {
+            Put32(out, at, static_cast<uint32_t>(value));
+            Put32(out, at + 4, static_cast<uint32_t>(value >> 32));
+        }
+
+        uint32_t Get32(std::string_view bytes, size_t at)
+        {
+            uint32_t value = 0;
+            for (int i = 0; i < 4; ++i)
+            {
+                value |= static_cast<uint32_t>(static_cast<uint8_t>(bytes[at + i])) << (i * 8);
+            }
+            return value;
+        }
+
+        uint64_t Get64(std::string_view bytes, size_t at)
+        {
+            return Get32(bytes, at) | (static_cast<uint64_t>(Get32(bytes, at + 4)) << 32);
+        }
+
+        size_t AlignUp(size_t value)
+        {
+            return (value + 7) & ~size_t{7};
+        }
+
+        // [offset, offset + size) of `bytes`, checked
+        std::string_view Range(std::string_view bytes, uint64_t offset, uint64_t size, const std::filesystem::path &path)
+        {
+            if (offset > bytes.size() || size > bytes.size() - offset)
+            {
+                throw Error("Archive is truncated: " + path.string());
+            }
+            return bytes.substr(offset, size);
+        }
+
+        // Appends `value` to `strings`, returns its offset
+        uint32_t AddString(std::string &strings, std::string_view value)
+        {
+            if (strings.size() + value.size() > std::numeric_limits<uint32_t>::max())
+            {
+                throw Error("String table too large for the archive format");
+            }
+            uint32_t offset = static_cast<uint32_t>(strings.size());
+            strings.append(value.data(), value.size());
+            return offset;
+        }
+    }
+
+    std::string IrArchive::Serialize(const std::vector<const IR *> &members,
+                                     const std::vector<std::string> &names)
+    {
+        if (members.size() != names.size())
+        {
+            throw Error("Every archive member needs a name");
+        }
+
+        // Every global definition, by name, to be looked up by binary search
+        struct IndexEntry
+        {
+            std::string_view name;
+            uint32_t member;
+        };
+        std::vector<IndexEntry> index;
+        for (uint32_t m = 0; m < members.size(); ++m)
+        {
+            const IR &ir = *members[m];
+            for (SymbolId id = 0; id < ir.symbol_table.size(); ++id)
+            {
+                if (ir.symbol_table[id].defined && ir.symbol_table[id].global)
+                {
+                    index.push_back({ir.symbol_names.Get(id), m});
+                }
+            }
+        }
+        std::sort(index.begin(), index.end(), [](const IndexEntry &a, const IndexEntry &b)
+                  { return a.name < b.name; });
+        for (size_t i = 1; i < index.size(); ++i)
+        {
+            if (index[i].name == index[i - 1].name)
+            {
+                throw Error("Global symbol defined in more than one archive member: " + std::string(index[i].name) +
+                            " (" + names[index[i - 1].member] + ", " + names[index[i].member] + ")");
+            }
+        }
+
+        std::vector<std::string> images;
+        images.reserve(members.size());
+        for (const IR *member : members)
+        {
+            images.push_back(IrSerializer::Serialize(*member));
+        }
+
+        // Lay out the tables, then the members
+        std::string strings;
+        std::vector<uint32_t> name_offsets;
+        for (const std::string &name : names)
+        {
+            name_offsets.push_back(AddString(strings, name));
+        }
+        std::vector<uint32_t> symbol_offsets;
+        for (const IndexEntry &entry : index)
+        {
+            symbol_offsets.push_back(AddString(strings, entry.name));
+        }
+
+        const size_t member_table = kHeaderSize;
+        const size_t symbol_index = member_table + members.size() * kMemberRecordSize;
+        const size_t string_table = symbol_index + index.size() * kSymbolRecordSize;
+        size_t end = AlignUp(string_table + strings.size());
+
+        std::vector<size_t> image_offsets;
+        for (const std::string &image : images)
+        {
+            image_offsets.push_back(end);
+            end = AlignUp(end + image.size());
+        }
+
+        std::string out(end, '\0');
+        std::memcpy(out.data(), kMagic, sizeof(kMagic));
+        Put32(out, kVersionField, kFormatVersion);
+        Put32(out, kMemberCountField, static_cast<uint32_t>(members.size()));
+        Put32(out, kSymbolCountField, static_cast<uint32_t>(index.size()));
+        Put64(out, kMemberTableField, member_table);
+        Put64(out, kSymbolIndexField, symbol_index);
+        Put64(out, kStringTableField, string_table);
+        Put64(out, kStringTableSizeField, strings.size());
+
+        // Member: name, image offset, image size
+        for (size_t m = 0; m < members.size(); ++m)
+        {
+            size_t at = member_table + m * kMemberRecordSize;
+            Put32(out, at, name_offsets[m]);
+            Put32(out, at + 4, static_cast<uint32_t>(names[m].size()));
+            Put64(out, at + 8, image_offsets[m]);
+            Put64(out, at + 16, images[m].size());
+            std::memcpy(out.data() + image_offsets[m], images[m].data(), images[m].size());
+        }
+
+        // Symbol: name, defining member
+        for (size_t i = 0; i < index.size(); ++i)
+        {
+            size_t at = symbol_index + i * kSymbolRecordSize;
+            Put32(out, at, symbol_offsets[i]);
+            Put32(out, at + 4, static_cast<uint32_t>(index[i].name.size()));
+            Put32(out, at + 8, index[i].member);
+        }
+
+        std::memcpy(out.data() + string_table, strings.data(), strings.size());
+        return out;
+    }
+
+    void IrArchive::WriteFile(const std::vector<const IR *> &members,
+                              const std::vector<std::string> &names,
+                              const std::filesystem::path &path)
+    {
+        std::string bytes = Serialize(members, names);
+
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+        {
+            throw Error("Failed to open file for writing: " + path.string());
+        }
+        file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        if (!file.flush())
+        {
+            throw Error("Failed to write file: " + path.string());
+        }
+    }
+
+    bool IrArchive::IsArchive(std::string_view bytes)
+    {
+        return bytes.substr(0, sizeof(kMagic)) == std::string_view(kMagic, sizeof(kMagic));
+    }
+
+    IrArchive::IrArchive(const std::filesystem::path &path)
+        : path_(path), file_(path)
+    {
+        std::string_view bytes = file_.view();
+        if (bytes.size() < kHeaderSize || !IsArchive(bytes))
+        {
+            throw Error("Not an archive: " + path.string());
+        }
+        if (Get32(bytes, kVersionField) != kFormatVersion)
+        {
+            throw Error("Archive has an unsupported format version: " + path.string());
+        }
+
+        member_count_ = Get32(bytes, kMemberCountField);
+        symbol_count_ = Get32(bytes, kSymbolCountField);
+        members_ = Get64(bytes, kMemberTableField);
+        symbols_ = Get64(bytes, kSymbolIndexField);
+        Range(bytes, members_, static_cast<uint64_t>(member_count_) * kMemberRecordSize, path);
+        Range(bytes, symbols_, static_cast<uint64_t>(symbol_count_) * kSymbolRecordSize, path);
+        strings_ = Range(bytes, Get64(bytes, kStringTableField), Get64(bytes, kStringTableSizeField), path);
+        loaded_.resize(member_count_);
+    }
+
+    std::string_view IrArchive::String(size_t at) const
+    {
+        uint32_t offset = Get32(file_.view(), at);
+        uint32_t length = Get32(file_.view(), at + 4);
+        if (offset > strings_.size() || length > strings_.size() - offset)
+        {
+            throw Error("Archive has a string outside the string table: " + path_.string());
+        }
+        return strings_.substr(offset, length);
+    }
+
+    std::string_view IrArchive::member_name(size_t member) const
+    {
+        return String(members_ + member * kMemberRecordSize);
+    }
+
+    size_t IrArchive::FindSymbol(std::string_view symbol) const
+    {
+        // Binary search straight over the mapped index
+        size_t low = 0;
+        size_t high = symbol_count_;
+        while (low < high)
+        {
+            size_t middle = low + (high - low) / 2;
+            int order = String(symbols_ + middle * kSymbolRecordSize).compare(symbol);
+            if (order == 0)
+            {
+                uint32_t member = Get32(file_.view(), symbols_ + middle * kSymbolRecordSize + 8);
+                if (member >= member_count_)
+                {
+                    throw Error("Archive indexes a symbol in an unknown member: " + path_.string());
+                }
+                return member;
+            }
+            if (order < 0)
+            {
+                low = middle + 1;
+            }
+            else
+            {
+                high = middle;
+            }
+        }
+        return kNoMember;
+    }
+
+    const IR &IrArchive::Member(size_t member)
+    {
+        if (member >= member_count_)
+        {
+            throw Error("Archive member out of range: " + path_.string());
+        }
+        if (!loaded_[member])
+        {
+            size_t at = members_ + member * kMemberRecordSize;
+            std::string_view image = Range(file_.view(), Get64(file_.view(), at + 8), Get64(file_.view(), at + 16), path_);
+            try
+            {
+                loaded_[member] = std::make_unique<IR>(IrSerializer::Deserialize(image));
+            }
+            catch (const std::exception &e)
+            {
+                throw Error(path_.string() + "(" + std::string(member_name(member)) + "): " + e.what());
+            }
+        }
+        return *loaded_[member];
+    }
+
+} // namespace cforge
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "mapped_file.hpp"
+#include "types.hpp"
+
+// std
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cforge
+{
+    /**
+     * @brief Static library of IR objects (`.cfa`), like `ar` after `ranlib`.
+     * Layout: a fixed header, a member table, an index of every global symbol
+     * sorted by name, a string table, and finally the members themselves as
+     * `.cir` images, each 8-byte aligned. Opening an archive maps it and reads
+     * the header only; symbols are found by binary search over the mapped
+     * index and a member is decoded the first time it is asked for.
+     * All integers are little-endian.
+     */
+    class IrArchive
+    {
+    public:
+        // Bumped whenever the layout below changes
+        static constexpr uint32_t kFormatVersion = 1;
+
+        static constexpr size_t kHeaderSize = 48;
+        static constexpr size_t kMemberRecordSize = 24;
+        static constexpr size_t kSymbolRecordSize = 16;
+
+        static constexpr size_t kNoMember = static_cast<size_t>(-1);
+
+        /**
+         * Bundles `members`, member `i` is called `names[i]`.
+         * @throws Error if two members define the same global symbol.
+         */
+        static std::string Serialize(const std::vector<const IR *> &members,
+                                     const std::vector<std::string> &names);
+
+        // Serializes to `path`, see `Serialize`
+        static void WriteFile(const std::vector<const IR *> &members,
+                              const std::vector<std::string> &names,
+                              const std::filesystem::path &path);
+
+        // True if `bytes` starts like an archive
+        static bool IsArchive(std::string_view bytes);
+
+        /**
+         * Maps the archive at `path`, no member is decoded yet.
+         * @throws Error if the file cannot be mapped or is not an archive of this format version.
+         */
+        explicit IrArchive(const std::filesystem::path &path);
+
+        IrArchive(IrArchive &&) = default;
+        IrArchive &operator=(IrArchive &&) = default;
+
+        size_t size() const { return member_count_; }
+        std::string_view member_name(size_t member) const;
+
+        // Member defining the global `symbol`, or `kNoMember`
+        size_t FindSymbol(std::string_view symbol) const;
+
+        /**
+         * Decodes member `member` on first use.
+         * @return The member, valid for the lifetime of the archive.
+         * @throws Error if the member is corrupt.
+         */
+        const IR &Member(size_t member);
+
+        const std::filesystem::path &path() const { return path_; }
+
+    private:
+        // String referenced at `at`, checked against the string table
+        std::string_view String(size_t at) const;
+
+        std::filesystem::path path_;
+        MappedFile file_;
+        uint32_t member_count_ = 0;
+        uint32_t symbol_count_ = 0;
+        size_t members_ = 0; // Offset of the member table
+        size_t symbols_ = 0; // Offset of the symbol index
+        std::string_view strings_;
+        std::vector<std::unique_ptr<IR>> loaded_; // By member, null until decoded
+    };
+
+} // namespace cforge
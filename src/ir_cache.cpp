@@ -0,0 +1,134 @@
+#include "ir_cache.hpp"
+#include "error.hpp"
+#include "hash.hpp"
+#include "ir_serializer.hpp"
+#include "mapped_file.hpp"
+
+// std
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+namespace cforge
+{
+    namespace
+    {
+        // Entry header: the key, repeated so a collision of file names is caught
+        constexpr size_t kHeaderSize = 3 * sizeof(uint64_t);
+
+        void AppendU64(std::string &out, uint64_t value)
+        {
+            for (int i = 0; i < 8; ++i)
+            {
+                out.push_back(static_cast<char>(value >> (i * 8)));
+            }
+        }
+
+        std::string Header(const IrCache::Key &key)
+        {
+            std::string header;
+            AppendU64(header, key.low);
+            AppendU64(header, key.high);
+            AppendU64(header, key.source_size);
+            return header;
+        }
+    }
+
+    IrCache::IrCache(std::filesystem::path directory)
+        : directory_(std::move(directory))
+    {
+        std::error_code error;
+        std::filesystem::create_directories(directory_, error);
+        if (error)
+        {
+            throw Error("Failed to create cache directory: " + directory_.string());
+        }
+    }
+
+    IrCache::Key IrCache::KeyOf(std::string_view source, std::string_view salt)
+    {
+        uint64_t salt_hash = HashBytes(salt);
+        Key key;
+        key.low = HashBytes(source, salt_hash);
+        key.high = HashBytes(source, ~salt_hash);
+        key.source_size = source.size();
+        return key;
+    }
+
+    std::filesystem::path IrCache::PathOf(const Key &key) const
+    {
+        char name[40];
+        std::snprintf(name, sizeof(name), "%016llx%016llx.ir",
+                      static_cast<unsigned long long>(key.high),
+                      static_cast<unsigned long long>(key.low));
+        return directory_ / name;
+    }
+
+    std::optional<IR> IrCache::Load(const Key &key) const
+    {
+        std::filesystem::path path = PathOf(key);
+        std::error_code error;
+        if (!std::filesystem::is_regular_file(path, error))
+        {
+            return std::nullopt;
+        }
+
+        try
+        {
+            MappedFile file(path);
+            std::string_view bytes = file.view();
+            if (bytes.size() < kHeaderSize || bytes.substr(0, kHeaderSize) != Header(key))
+            {
+                return std::nullopt;
+            }
+            return IrSerializer::Deserialize(bytes.substr(kHeaderSize));
+        }
+        catch (const std::exception &)
+        {
+            return std::nullopt;
+        }
+    }
+
+    void IrCache::Store(const Key &key, const IR &ir) const
+    {
+        // Unique across processes sharing the directory and across threads
+        static const uint64_t process_tag = (static_cast<uint64_t>(std::random_device{}()) << 32) ^ std::random_device{}();
+        static std::atomic<uint64_t> counter{0};
+
+        std::filesystem::path path = PathOf(key);
+        std::ostringstream suffix;
+        suffix << ".tmp." << std::hex << process_tag << '.' << counter.fetch_add(1, std::memory_order_relaxed);
+        std::filesystem::path temporary = path;
+        temporary += suffix.str();
+
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            if (!file)
+            {
+                return;
+            }
+            std::string header = Header(key);
+            std::string body = IrSerializer::Serialize(ir);
+            file.write(header.data(), static_cast<std::streamsize>(header.size()));
+            file.write(body.data(), static_cast<std::streamsize>(body.size()));
+            if (!file.flush())
+            {
+                file.close();
+                std::error_code error;
+                std::filesystem::remove(temporary, error);
+                return;
+            }
+        }
+
+        // Atomic on POSIX: readers see either no entry or a complete one
+        std::error_code error;
+        std::filesystem::rename(temporary, path, error);
+        if (error)
+        {
+            std::filesystem::remove(temporary, error);
+        }
+    }
+
+} // namespace cforge
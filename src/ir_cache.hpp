@@ -0,0 +1,54 @@
+#pragma once
+
+#include "types.hpp"
+
+// std
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace cforge
+{
+    /**
+     * @brief Content-addressed on-disk store of assembled modules.
+     * Entries are named after a 128-bit hash of the source bytes and a salt
+     * describing everything else the IR depends on (assembler version, IR
+     * format, flags), so a stale entry is never found rather than invalidated.
+     * Entries are written to a temporary file and renamed into place, several
+     * processes may share one directory.
+     */
+    class IrCache
+    {
+    public:
+        struct Key
+        {
+            uint64_t low = 0;
+            uint64_t high = 0;
+            uint64_t source_size = 0; // Double-checked on load, guards against hash collisions
+        };
+
+        // Creates `directory` if needed
+        explicit IrCache(std::filesystem::path directory);
+
+        static Key KeyOf(std::string_view source, std::string_view salt);
+
+        /**
+         * Maps and decodes the entry for `key`.
+         * @return Nothing on a miss, unreadable or corrupt entries count as misses.
+         */
+        std::optional<IR> Load(const Key &key) const;
+
+        // Stores `ir` under `key`, failures are ignored since the cache is only an accelerator
+        void Store(const Key &key, const IR &ir) const;
+
+        const std::filesystem::path &directory() const { return directory_; }
+
+    private:
+        std::filesystem::path PathOf(const Key &key) const;
+
+        std::filesystem::path directory_;
+    };
+
+} // namespace cforge
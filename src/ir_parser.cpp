@@ -1,72 +1,488 @@
 #include "ir_parser.hpp"
+#include "ir_serializer.hpp"
+#include "mapped_file.hpp"
 
 // std
+#include <charconv>
+#include <cstdio>
 #include <fstream>
-#include <iostream>
 #include <stdexcept>
 
 namespace cforge
 {
-    IR IrParser::Parse(std::string const &input)
+    namespace
     {
-        return IR{};
+        /**
+         * @brief Minimal JSON emitter writing through a fixed-size buffer.
+         * Commas are tracked per nesting level, so callers only open and close
+         * containers and emit values.
+         */
+        class JsonWriter
+        {
+        public:
+            explicit JsonWriter(std::ofstream &file) : file_(file) {}
+            ~JsonWriter() { Flush(); }
+
+            void BeginObject() { Open('{'); }
+            void EndObject() { Close('}'); }
+            void BeginArray() { Open('['); }
+            void EndArray() { Close(']'); }
+
+            void Key(std::string_view key)
+            {
+                Separate();
+                Quoted(key);
+                Put(':');
+                after_key_ = true;
+            }
+
+            void String(std::string_view value)
+            {
+                Separate();
+                Quoted(value);
+            }
+
+            void Unsigned(uint64_t value)
+            {
+                Separate();
+                char digits[24];
+                auto result = std::to_chars(digits, digits + sizeof(digits), value);
+                Append(digits, static_cast<size_t>(result.ptr - digits));
+            }
+
+            void Bool(bool value)
+            {
+                Separate();
+                value ? Append("true", 4) : Append("false", 5);
+            }
+
+            void Flush()
+            {
+                file_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+                buffer_.clear();
+            }
+
+        private:
+            static constexpr size_t kBufferSize = 64 * 1024;
+
+            void Open(char bracket)
+            {
+                Separate();
+                Put(bracket);
+                first_.push_back(true);
+            }
+
+            void Close(char bracket)
+            {
+                first_.pop_back();
+                Put(bracket);
+            }
+
+            // Comma between siblings, nothing between a key and its value
+            void Separate()
+            {
+                if (after_key_)
+                {
+                    after_key_ = false;
+                    return;
+                }
+                if (!first_.empty())
+                {
+                    if (!first_.back())
+                    {
+                        Put(',');
+                    }
+                    first_.back() = false;
+                }
+            }
+
+            void Quoted(std::string_view value)
+            {
+                Put('"');
+                for (char c : value)
+                {
+                    if (c == '"' || c == '\\')
+                    {
+                        Put('\\');
+                        Put(c);
+                    }
+                    else if (static_cast<unsigned char>(c) < 0x20)
+                    {
+                        char escaped[7];
+                        std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c));
+                        Append(escaped, 6);
+                    }
+                    else
+                    {
+                        Put(c);
+                    }
+                }
+                Put('"');
+            }
+
+            void Put(char c)
+            {
+                buffer_.push_back(c);
+                if (buffer_.size() >= kBufferSize)
+                {
+                    Flush();
+                }
+            }
+
+            void Append(const char *data, size_t size)
+            {
+                buffer_.append(data, size);
+                if (buffer_.size() >= kBufferSize)
+                {
+                    Flush();
+                }
+            }
+
+            std::ofstream &file_;
+            std::string buffer_;
+            std::vector<bool> first_; // Per open container: no element written yet
+            bool after_key_ = false;
+        };
+
+        /**
+         * @brief Builds an `IR` straight from the SAX events of `WriteJsonFile` output.
+         * Depth 1 is the root object, 2 its arrays, 3 their elements and 4 a
+         * section's "data" array. Unknown keys are skipped.
+         */
+        class IrSaxHandler : public nlohmann::json_sax<json>
+        {
+        public:
+            explicit IrSaxHandler(IR &ir) : ir_(ir) {}
+
+            bool null() override { return Unexpected("null"); }
+            bool boolean(bool value) override
+            {
+                if (depth_ == 3 && key_ == "defined")
+                {
+                    defined_ = value;
+                }
+                else if (depth_ == 3 && key_ == "global")
+                {
+                    global_ = value;
+                }
+                return true;
+            }
+            bool number_integer(number_integer_t value) override
+            {
+                if (value < 0)
+                {
+                    return Unexpected("negative number");
+                }
+                return number_unsigned(static_cast<number_unsigned_t>(value));
+            }
+            bool number_unsigned(number_unsigned_t value) override
+            {
+                if (depth_ == 4 && in_data_)
+                {
+                    if (value > 0xFF)
+                    {
+                        return Unexpected("section byte above 255");
+                    }
+                    data_.push_back(static_cast<uint8_t>(value));
+                }
+                else if (depth_ == 3)
+                {
+                    if (key_ == "size")
+                        size_ = value;
+                    else if (key_ == "offset")
+                        offset_ = value;
+                    else if (key_ == "instruction_id")
+                        instruction_id_ = value;
+                    else if (key_ == "type")
+                        type_ = value;
+                }
+                return true;
+            }
+            bool number_float(number_float_t, const string_t &) override { return Unexpected("fractional number"); }
+            bool string(string_t &value) override
+            {
+                if (depth_ == 1 && key_ == "version")
+                {
+                    ir_.version = std::move(value);
+                }
+                else if (depth_ == 3)
+                {
+                    if (key_ == "name")
+                        name_ = std::move(value);
+                    else if (key_ == "section")
+                        section_ = std::move(value);
+                    else if (key_ == "symbol")
+                        symbol_ = std::move(value);
+                }
+                return true;
+            }
+            bool binary(binary_t &) override { return Unexpected("binary value"); }
+
+            bool start_object(std::size_t) override
+            {
+                if (++depth_ == 3)
+                {
+                    name_.clear();
+                    section_.clear();
+                    symbol_.clear();
+                    data_.clear();
+                    has_data_ = false;
+                    size_ = offset_ = instruction_id_ = 0;
+                    type_ = kNoType;
+                    defined_ = true;
+                    global_ = false;
+                }
+                return true;
+            }
+            bool end_object() override
+            {
+                if (depth_ == 3)
+                {
+                    Commit();
+                }
+                --depth_;
+                return true;
+            }
+            bool start_array(std::size_t) override
+            {
+                ++depth_;
+                if (depth_ == 2)
+                {
+                    array_ = key_;
+                }
+                else if (depth_ == 4 && array_ == "sections" && key_ == "data")
+                {
+                    in_data_ = true;
+                    has_data_ = true;
+                }
+                return true;
+            }
+            bool end_array() override
+            {
+                if (depth_ == 4)
+                {
+                    in_data_ = false;
+                }
+                else if (depth_ == 2)
+                {
+                    array_.clear();
+                }
+                --depth_;
+                return true;
+            }
+            bool key(string_t &value) override
+            {
+                key_ = std::move(value);
+                return true;
+            }
+
+            bool parse_error(std::size_t position, const std::string &, const nlohmann::detail::exception &) override
+            {
+                throw Error("Invalid IR JSON at byte " + std::to_string(position));
+            }
+
+        private:
+            static constexpr uint64_t kNoType = ~uint64_t{0};
+
+            bool Unexpected(const char *what)
+            {
+                throw Error(std::string("Unexpected ") + what + " in IR JSON");
+            }
+
+            // Symbols are referenced by name, every name gets an entry
+            SymbolId Reference(const std::string &name)
+            {
+                SymbolId id = ir_.symbol_names.Intern(name);
+                if (id >= ir_.symbol_table.size())
+                {
+                    ir_.symbol_table.resize(id + 1);
+                }
+                return id;
+            }
+
+            void Commit()
+            {
+                if (array_ == "sections")
+                {
+                    Section &section = ir_.sections[ir_.SectionNamed(name_)];
+                    section.size = size_;
+                    if (has_data_)
+                    {
+                        section.data = std::move(data_);
+                        data_ = {};
+                    }
+                }
+                else if (array_ == "symbols")
+                {
+                    SymbolEntry &entry = ir_.symbol_table[Reference(name_)];
+                    entry.defined = defined_ && !section_.empty();
+                    entry.global = global_;
+                    if (entry.defined)
+                    {
+                        entry.location = UnLocalizedOffset(ir_.SectionNamed(section_), offset_);
+                    }
+                }
+                else if (array_ == "relocations")
+                {
+                    if (type_ > static_cast<uint64_t>(RelocationEntry::Type::R_RISC_V_BRANCH))
+                    {
+                        throw Error("IR JSON has a relocation of unknown type");
+                    }
+                    RelocationEntry reloc;
+                    reloc.type = static_cast<RelocationEntry::Type>(type_);
+                    reloc.section = ir_.SectionNamed(section_);
+                    reloc.instruction_id = instruction_id_;
+                    reloc.symbol = Reference(symbol_);
+                    ir_.relocations.push_back(reloc);
+                }
+            }
+
+            IR &ir_;
+            int depth_ = 0;
+            std::string key_;
+            std::string array_; // Key of the root array being read
+            bool in_data_ = false;
+
+            // Fields of the current element
+            std::string name_;
+            std::string section_;
+            std::string symbol_;
+            std::vector<uint8_t> data_;
+            bool has_data_ = false;
+            uint64_t size_ = 0;
+            uint64_t offset_ = 0;
+            uint64_t instruction_id_ = 0;
+            uint64_t type_ = kNoType;
+            bool defined_ = true;
+            bool global_ = false;
+        };
+    }
+
+    IR IrParser::Parse(std::string_view input)
+    {
+        // Binary objects start with their magic, anything else is taken for JSON
+        if (input.substr(0, 4) == "CFIR")
+        {
+            return IrSerializer::Deserialize(input);
+        }
+
+        IR ir;
+        IrSaxHandler handler(ir);
+        json::sax_parse(input.begin(), input.end(), &handler);
+        ir.relocations.Sort(); // Hand-written files may list them in any order
+        return ir;
     }
 
     IR IrParser::ParseFile(const std::filesystem::path &path)
     {
-        return IR{};
+        MappedFile file(path);
+        return Parse(file.view());
     }
 
     void IrParser::WriteToFile(const IR &ir, const std::filesystem::path &path)
     {
-        json j;
-        j["version"] = ir.version;
-        for (const auto &section_pair : ir.section_size_map)
+        std::string bytes = IrSerializer::Serialize(ir);
+
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
         {
-            const auto &section_name = section_pair.first;
-            const auto &section_size = section_pair.second;
+            throw Error("Failed to open file for writing: " + path.string());
+        }
 
-            // Get data
-            const std::vector<uint8_t> &section_data = ir.section_data.find(section_name) != ir.section_data.end()
-                                                           ? ir.section_data.at(section_name)
-                                                           : std::vector<uint8_t>{};
+        file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        if (!file.flush())
+        {
+            throw Error("Failed to write file: " + path.string());
+        }
+    }
 
-            j["sections"] += {
-                {"name", section_name},
-                {"size", section_size},
-                {"data", section_data}};
+    void IrParser::WriteJsonFile(const IR &ir, const std::filesystem::path &path)
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+        {
+            throw Error("Failed to open file for writing: " + path.string());
+        }
+
+        {
+            JsonWriter writer(file);
+            writer.BeginObject();
+            writer.Key("version");
+            writer.String(ir.version);
+
+            writer.Key("sections");
+            writer.BeginArray();
+            for (SectionId id = 0; id < ir.sections.size(); ++id)
+            {
+                const Section &section = ir.sections[id];
+                writer.BeginObject();
+                writer.Key("name");
+                writer.String(ir.section_names.Get(id));
+                writer.Key("size");
+                writer.Unsigned(section.size);
+                if (!section.data.empty())
+                {
+                    writer.Key("data");
+                    writer.BeginArray();
+                    for (uint8_t byte : section.data)
+                    {
+                        writer.Unsigned(byte);
+                    }
+                    writer.EndArray();
+                }
+                writer.EndObject();
+            }
+            writer.EndArray();
 
-            j["relocations"] = json::array();
-            for (const auto &reloc : ir.relocations)
+            // Undefined symbols are listed too, so `.globl` declarations survive a round trip.
+            // Symbols go before relocations, so the reader interns every name at its original id
+            writer.Key("symbols");
+            writer.BeginArray();
+            for (SymbolId id = 0; id < ir.symbol_table.size(); ++id)
             {
-                j["relocations"].push_back({
-                    {"type", static_cast<int>(reloc.type)},
-                    {"section", reloc.section},
-                    {"instruction_id", reloc.instruction_id},
-                    {"symbol", reloc.symbol},
-                });
+                const SymbolEntry &entry = ir.symbol_table[id];
+                writer.BeginObject();
+                writer.Key("name");
+                writer.String(ir.symbol_names.Get(id));
+                writer.Key("defined");
+                writer.Bool(entry.defined);
+                writer.Key("global");
+                writer.Bool(entry.global);
+                if (entry.defined)
+                {
+                    writer.Key("section");
+                    writer.String(ir.section_names.Get(entry.location.section));
+                    writer.Key("offset");
+                    writer.Unsigned(entry.location.offset);
+                }
+                writer.EndObject();
             }
+            writer.EndArray();
 
-            j["symbols"] = json::array();
-            for (const auto &symbol_pair : ir.symbol_map)
+            writer.Key("relocations");
+            writer.BeginArray();
+            for (size_t r = 0; r < ir.relocations.size(); ++r)
             {
-                j["symbols"].push_back({
-                    {"name", symbol_pair.first},
-                    {"section", symbol_pair.second.section},
-                    {"offset", symbol_pair.second.offset},
-                });
+                const RelocationEntry reloc = ir.relocations[r];
+                writer.BeginObject();
+                writer.Key("type");
+                writer.Unsigned(static_cast<uint64_t>(reloc.type));
+                writer.Key("section");
+                writer.String(ir.section_names.Get(reloc.section));
+                writer.Key("instruction_id");
+                writer.Unsigned(reloc.instruction_id);
+                writer.Key("symbol");
+                writer.String(ir.symbol_names.Get(reloc.symbol));
+                writer.EndObject();
             }
+            writer.EndArray();
+            writer.EndObject();
         }
-        std::ofstream file(path);
-        if (!file.is_open())
+
+        if (!file.flush())
         {
-            throw Error("Failed to open file for writing: " + path.string());
+            throw Error("Failed to write file: " + path.string());
         }
-
-        std::cout << "Writing IR to file: " << path << std::endl;
-
-        file << j.dump(4);
-        file.close();
     }
 
-} // namespace cforge
\ No newline at end of file
+} // namespace cforge
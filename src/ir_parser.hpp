@@ -10,6 +10,7 @@
 // std
 #include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <unordered_map>
 #include <unordered_set>
@@ -18,6 +19,12 @@
 namespace cforge
 {
 
+	/**
+	 * @brief Reads and writes `.cir` object files, see `IrSerializer` for the format.
+	 * JSON objects are supported too for tooling, both are streamed: the
+	 * writer emits every element once and the reader fills the `IR` from SAX
+	 * events, so neither holds a JSON document in memory.
+	 */
 	class IrParser
 	{
 	public:
@@ -25,14 +32,16 @@ namespace cforge
 
 		/**
 		 * Parses the input and returns an IR object.
-		 * @param input The input to parse.
+		 * @param input Contents of a `.cir` file or of a file written by `WriteJsonFile`.
 		 * @return The parsed IR object.
+		 * @throws Error if `input` is neither a valid `.cir` file nor valid IR JSON.
 		 */
-		IR Parse(const std::string &input);
+		IR Parse(std::string_view input);
 
 		/**
 		 * Parses a file and returns an IR object.
-		 * @attention This function simply opens the file and calls Parse on its contents.
+		 * @attention The file is memory-mapped and its tables are read in place,
+		 * only section bytes and names are copied into the IR.
 		 * @param path The path to the file to parse.
 		 * @return The parsed IR object.
 		 */
@@ -42,10 +51,16 @@ namespace cforge
 		 * Creates a .cir file from the IR object.
 		 * @param ir The IR object to write to file.
 		 * @param path The path to write the file to.
-		 * @return True if the file was written successfully, false otherwise.
+		 * @throws Error if the file cannot be written.
 		 */
 		static void WriteToFile(const IR &ir, const std::filesystem::path &path);
 
+		/**
+		 * Writes the IR as JSON, one section, relocation and symbol at a time.
+		 * @throws Error if the file cannot be written.
+		 */
+		static void WriteJsonFile(const IR &ir, const std::filesystem::path &path);
+
 	private:
 	};
 }
\ No newline at end of file
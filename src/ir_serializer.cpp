@@ -0,0 +1,360 @@
+#include "ir_serializer.hpp"
+#include "error.hpp"
+
+// std
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+namespace cforge
+{
+    namespace
+    {
+        constexpr char kMagic[4] = {'C', 'F', 'I', 'R'};
+
+        // Section records without data (e.g. only named by `.section`) use this offset
+        constexpr uint64_t kNoData = std::numeric_limits<uint64_t>::max();
+
+        // Header field offsets
+        constexpr size_t kVersionField = 4;
+        constexpr size_t kSectionCountField = 8;
+        constexpr size_t kSymbolCountField = 12;
+        constexpr size_t kRelocationCountField = 16;
+        constexpr size_t kIrVersionField = 20; // String reference
+        constexpr size_t kSectionTableField = 32;
+        constexpr size_t kSymbolTableField = 40;
+        constexpr size_t kRelocationTableField = 48;
+        constexpr size_t kStringTableField = 56;
+        constexpr size_t kStringTableSizeField = 64;
+        constexpr size_t kFileSizeField = 72;
+
+        void Put32(std::string &out, size_t at, uint32_t value)
+        {
+            for (int i = 0; i < 4; ++i)
+            {
+                out[at + i] = static_cast<char>(value >> (i * 8));
+            }
+        }
+
+        void Put64(std::string &out, size_t at, uint64_t value)
+        {
+            Put32(out, at, static_cast<uint32_t>(value));
+            Put32(out, at + 4, static_cast<uint32_t>(value >> 32));
+        }
+
+        uint32_t Get32(std::string_view bytes, size_t at)
+        {
+            uint32_t value = 0;
+            for (int i = 0; i < 4; ++i)
+            {
+                value |= static_cast<uint32_t>(static_cast<uint8_t>(bytes[at + i])) << (i * 8);
+            }
+            return value;
+        }
+
+        uint64_t Get64(std::string_view bytes, size_t at)
+        {
+            return Get32(bytes, at) | (static_cast<uint64_t>(Get32(bytes, at + 4)) << 32);
+        }
+
+        size_t AlignUp(size_t value)
+        {
+            return (value + 7) & ~size_t{7};
+        }
+
+        // Offset and length of a string in the string table, 8 bytes on disk
+        struct StringRef
+        {
+            uint32_t offset = 0;
+            uint32_t length = 0;
+        };
+
+        // Deduplicated string table, the IR version often matches a symbol name
+        class StringTable
+        {
+        public:
+            StringRef Add(std::string_view value)
+            {
+                if (value.size() > std::numeric_limits<uint32_t>::max())
+                {
+                    throw Error("String too long for the IR format");
+                }
+                auto it = offsets_.find(std::string(value));
+                if (it == offsets_.end())
+                {
+                    if (bytes_.size() + value.size() > std::numeric_limits<uint32_t>::max())
+                    {
+                        throw Error("String table too large for the IR format");
+                    }
+                    it = offsets_.emplace(std::string(value), static_cast<uint32_t>(bytes_.size())).first;
+                    bytes_.append(value.data(), value.size());
+                }
+                return {it->second, static_cast<uint32_t>(value.size())};
+            }
+
+            const std::string &bytes() const { return bytes_; }
+
+        private:
+            std::string bytes_;
+            std::unordered_map<std::string, uint32_t> offsets_;
+        };
+
+        void PutRef(std::string &out, size_t at, StringRef ref)
+        {
+            Put32(out, at, ref.offset);
+            Put32(out, at + 4, ref.length);
+        }
+
+        /**
+         * @brief Bounds-checked access to the tables of a serialized IR.
+         */
+        class Tables
+        {
+        public:
+            explicit Tables(std::string_view bytes) : bytes_(bytes)
+            {
+                if (bytes.size() < IrSerializer::kHeaderSize ||
+                    bytes.substr(0, sizeof(kMagic)) != std::string_view(kMagic, sizeof(kMagic)))
+                {
+                    throw Error("Not a serialized IR");
+                }
+                if (Get32(bytes, kVersionField) != IrSerializer::kFormatVersion)
+                {
+                    throw Error("Serialized IR has an unsupported format version");
+                }
+                if (Get64(bytes, kFileSizeField) != bytes.size())
+                {
+                    throw Error("Serialized IR is truncated");
+                }
+
+                section_count = Get32(bytes, kSectionCountField);
+                symbol_count = Get32(bytes, kSymbolCountField);
+                relocation_count = Get32(bytes, kRelocationCountField);
+                sections_ = Table(kSectionTableField, section_count, IrSerializer::kSectionRecordSize);
+                symbols_ = Table(kSymbolTableField, symbol_count, IrSerializer::kSymbolRecordSize);
+                relocations_ = Table(kRelocationTableField, relocation_count, IrSerializer::kRelocationRecordSize);
+                strings_ = Range(Get64(bytes, kStringTableField), Get64(bytes, kStringTableSizeField));
+            }
+
+            uint32_t section_count;
+            uint32_t symbol_count;
+            uint32_t relocation_count;
+
+            size_t Section(size_t i) const { return sections_ + i * IrSerializer::kSectionRecordSize; }
+            size_t Symbol(size_t i) const { return symbols_ + i * IrSerializer::kSymbolRecordSize; }
+            size_t Relocation(size_t i) const { return relocations_ + i * IrSerializer::kRelocationRecordSize; }
+
+            uint32_t U32(size_t at) const { return Get32(bytes_, at); }
+            uint64_t U64(size_t at) const { return Get64(bytes_, at); }
+
+            // String referenced at `at`
+            std::string_view String(size_t at) const
+            {
+                uint32_t offset = Get32(bytes_, at);
+                uint32_t length = Get32(bytes_, at + 4);
+                if (offset > strings_.size() || length > strings_.size() - offset)
+                {
+                    throw Error("Serialized IR has a string outside the string table");
+                }
+                return strings_.substr(offset, length);
+            }
+
+            // [offset, offset + size) of the file, checked
+            std::string_view Range(uint64_t offset, uint64_t size) const
+            {
+                if (offset > bytes_.size() || size > bytes_.size() - offset)
+                {
+                    throw Error("Serialized IR is truncated");
+                }
+                return bytes_.substr(offset, size);
+            }
+
+        private:
+            size_t Table(size_t field, uint32_t count, size_t record_size) const
+            {
+                uint64_t offset = Get64(bytes_, field);
+                Range(offset, static_cast<uint64_t>(count) * record_size);
+                return offset;
+            }
+
+            std::string_view bytes_;
+            std::string_view strings_;
+            size_t sections_ = 0;
+            size_t symbols_ = 0;
+            size_t relocations_ = 0;
+        };
+    }
+
+    std::string IrSerializer::Serialize(const IR &ir)
+    {
+        StringTable strings;
+        StringRef version = strings.Add(ir.version);
+
+        std::vector<StringRef> section_names;
+        for (SectionId id = 0; id < ir.sections.size(); ++id)
+        {
+            section_names.push_back(strings.Add(ir.section_names.Get(id)));
+        }
+        std::vector<StringRef> symbol_names;
+        for (SymbolId id = 0; id < ir.symbol_table.size(); ++id)
+        {
+            symbol_names.push_back(strings.Add(ir.symbol_names.Get(id)));
+        }
+
+        // Lay out the tables, then the section bytes
+        const size_t section_table = kHeaderSize;
+        const size_t symbol_table = section_table + ir.sections.size() * kSectionRecordSize;
+        const size_t relocation_table = symbol_table + ir.symbol_table.size() * kSymbolRecordSize;
+        const size_t string_table = relocation_table + ir.relocations.size() * kRelocationRecordSize;
+        size_t end = AlignUp(string_table + strings.bytes().size());
+
+        std::vector<uint64_t> data_offsets;
+        for (const Section &section : ir.sections)
+        {
+            if (section.data.empty())
+            {
+                data_offsets.push_back(kNoData);
+                continue;
+            }
+            data_offsets.push_back(end);
+            end = AlignUp(end + section.data.size());
+        }
+
+        std::string out(end, '\0');
+        std::memcpy(out.data(), kMagic, sizeof(kMagic));
+        Put32(out, kVersionField, kFormatVersion);
+        Put32(out, kSectionCountField, static_cast<uint32_t>(ir.sections.size()));
+        Put32(out, kSymbolCountField, static_cast<uint32_t>(ir.symbol_table.size()));
+        Put32(out, kRelocationCountField, static_cast<uint32_t>(ir.relocations.size()));
+        PutRef(out, kIrVersionField, version);
+        Put64(out, kSectionTableField, section_table);
+        Put64(out, kSymbolTableField, symbol_table);
+        Put64(out, kRelocationTableField, relocation_table);
+        Put64(out, kStringTableField, string_table);
+        Put64(out, kStringTableSizeField, strings.bytes().size());
+        Put64(out, kFileSizeField, end);
+
+        // Section: name, size, data offset, data size
+        for (SectionId id = 0; id < ir.sections.size(); ++id)
+        {
+            const Section &section = ir.sections[id];
+            size_t at = section_table + id * kSectionRecordSize;
+            PutRef(out, at, section_names[id]);
+            Put64(out, at + 8, section.size);
+            Put64(out, at + 16, data_offsets[id]);
+            if (data_offsets[id] != kNoData)
+            {
+                const std::vector<uint8_t> &data = section.data;
+                Put64(out, at + 24, data.size());
+                std::memcpy(out.data() + data_offsets[id], data.data(), data.size());
+            }
+        }
+
+        // Symbol: name, offset, section index, flags
+        for (SymbolId id = 0; id < ir.symbol_table.size(); ++id)
+        {
+            const SymbolEntry &entry = ir.symbol_table[id];
+            size_t at = symbol_table + id * kSymbolRecordSize;
+            PutRef(out, at, symbol_names[id]);
+            Put64(out, at + 8, entry.defined ? entry.location.offset : 0);
+            Put32(out, at + 16, entry.defined ? entry.location.section : kInvalidSection);
+            Put32(out, at + 20, (entry.defined ? 1 : 0) | (entry.global ? 2 : 0));
+        }
+
+        // Relocation: type, symbol index, section index, instruction word
+        const RelocationTable &relocations = ir.relocations;
+        for (size_t i = 0; i < relocations.size(); ++i)
+        {
+            size_t at = relocation_table + i * kRelocationRecordSize;
+            Put32(out, at, static_cast<uint32_t>(relocations.type(i)));
+            Put32(out, at + 4, relocations.symbol(i));
+            Put32(out, at + 8, relocations.section(i));
+            Put32(out, at + 12, static_cast<uint32_t>(relocations.instruction_id(i)));
+        }
+
+        std::memcpy(out.data() + string_table, strings.bytes().data(), strings.bytes().size());
+        return out;
+    }
+
+    IR IrSerializer::Deserialize(std::string_view bytes)
+    {
+        Tables tables(bytes);
+
+        IR ir;
+        ir.version = std::string(tables.String(kIrVersionField));
+
+        ir.sections.resize(tables.section_count);
+        for (SectionId id = 0; id < tables.section_count; ++id)
+        {
+            size_t at = tables.Section(id);
+            if (ir.section_names.Intern(tables.String(at)) != id)
+            {
+                throw Error("Serialized IR has duplicate section names");
+            }
+            Section &section = ir.sections[id];
+            section.size = tables.U64(at + 8);
+            uint64_t data_offset = tables.U64(at + 16);
+            if (data_offset != kNoData)
+            {
+                std::string_view data = tables.Range(data_offset, tables.U64(at + 24));
+                if (data.size() > section.size)
+                {
+                    throw Error("Serialized IR has section data beyond its size");
+                }
+                section.data.assign(data.begin(), data.end());
+            }
+        }
+
+        ir.symbol_table.resize(tables.symbol_count);
+        for (SymbolId id = 0; id < tables.symbol_count; ++id)
+        {
+            size_t at = tables.Symbol(id);
+            if (ir.symbol_names.Intern(tables.String(at)) != id)
+            {
+                throw Error("Serialized IR has duplicate symbol names");
+            }
+            SymbolEntry &entry = ir.symbol_table[id];
+            uint32_t flags = tables.U32(at + 20);
+            entry.defined = (flags & 1) != 0;
+            entry.global = (flags & 2) != 0;
+            if (entry.defined)
+            {
+                entry.location.offset = tables.U64(at + 8);
+                entry.location.section = tables.U32(at + 16);
+                if (entry.location.section >= tables.section_count)
+                {
+                    throw Error("Serialized IR has a symbol in an unknown section");
+                }
+            }
+        }
+
+        ir.relocations.reserve(tables.relocation_count);
+        for (uint32_t i = 0; i < tables.relocation_count; ++i)
+        {
+            size_t at = tables.Relocation(i);
+            RelocationEntry reloc;
+            uint32_t type = tables.U32(at);
+            if (type > static_cast<uint32_t>(RelocationEntry::Type::R_RISC_V_BRANCH))
+            {
+                throw Error("Serialized IR has an unknown relocation type");
+            }
+            reloc.type = static_cast<RelocationEntry::Type>(type);
+            reloc.symbol = tables.U32(at + 4);
+            if (reloc.symbol >= tables.symbol_count)
+            {
+                throw Error("Serialized IR has a relocation against an unknown symbol");
+            }
+            reloc.section = tables.U32(at + 8);
+            if (reloc.section >= tables.section_count)
+            {
+                throw Error("Serialized IR has a relocation in an unknown section");
+            }
+            reloc.instruction_id = tables.U32(at + 12);
+            ir.relocations.push_back(reloc);
+        }
+        ir.relocations.Sort();
+        return ir;
+    }
+
+} // namespace cforge
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "types.hpp"
+
+// std
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace cforge
+{
+    /**
+     * @brief The binary `.cir` object format, also used for cached modules.
+     * Layout: a fixed header, then fixed-size section, symbol and relocation
+     * records, a string table they all refer to, and finally the raw section
+     * bytes, each 8-byte aligned. Every table is addressed by an offset from
+     * the header, so a mapped file can be read in place without a pass over
+     * it. Sections and symbols are written in ID order and referred to by
+     * index, so a round trip keeps every `SectionId` and `SymbolId`.
+     * All integers are little-endian.
+     */
+    class IrSerializer
+    {
+    public:
+        // Bumped whenever the layout below changes
+        static constexpr uint32_t kFormatVersion = 3;
+
+        static constexpr size_t kHeaderSize = 80;
+        static constexpr size_t kSectionRecordSize = 32;
+        static constexpr size_t kSymbolRecordSize = 24;
+        static constexpr size_t kRelocationRecordSize = 16;
+
+        static std::string Serialize(const IR &ir);
+
+        /**
+         * Decodes the output of `Serialize`, section bytes are copied with one
+         * memcpy each, so `bytes` may be a mapping released afterwards.
+         * @throws Error if `bytes` is truncated or not a serialized IR of this format version.
+         */
+        static IR Deserialize(std::string_view bytes);
+    };
+
+} // namespace cforge
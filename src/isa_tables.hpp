@@ -0,0 +1,397 @@
+#pragma once
+
+#include "encoding.hpp"
+#include "perfect_hash.hpp"
+
+// std
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace cforge
+{
+    struct InstructionInfo
+    {
+        enum class Type
+        {
+            R_TYPE = 0x33,
+            I_TYPE = 0x13,
+            LOAD = 0x03,
+            STORE = 0x23,
+            BRANCH = 0x63,
+            U_TYPE = 0x37, // lui
+            AUIPC = 0x17,
+            J_TYPE = 0x6F,
+            JALR = 0x67,
+
+            // Impossible types [0x80:0xFF] (> 7 bit)
+            NONE = 0xFF,
+            PSEUDO = 0xFE,
+        };
+
+        Type opcode;
+
+        uint8_t func3;
+        uint8_t func7;
+
+        uint8_t operand_count;
+    };
+
+    // Every mnemonic the assembler knows, the order matches `kInstructionInfo`
+    enum class Mnemonic : uint8_t
+    {
+        // R-type
+        ADD,
+        SUB,
+        SLL,
+        SLT,
+        SLTU,
+        XOR,
+        SRL,
+        SRA,
+        OR,
+        AND,
+        // I-type
+        ADDI,
+        SLTI,
+        SLTIU,
+        XORI,
+        ORI,
+        ANDI,
+        SLLI,
+        SRLI,
+        SRAI,
+        // Loads
+        LB,
+        LH,
+        LW,
+        LBU,
+        LHU,
+        // Stores
+        SB,
+        SH,
+        SW,
+        // Branches
+        BEQ,
+        BNE,
+        BLT,
+        BGE,
+        BLTU,
+        BGEU,
+        // Upper immediates
+        LUI,
+        AUIPC,
+        // Jumps
+        JAL,
+        JALR,
+        // Pseudo-instructions
+        LA,
+        J,
+
+        COUNT,
+        INVALID = 0xFF,
+    };
+
+    enum class Directive : uint8_t
+    {
+        SECTION,
+        GLOBL,
+        DATA,
+        TEXT,
+        BYTE,
+        WORD,
+        DWORD,
+        ASCII,
+        ALIGN,
+        SPACE,
+        INCLUDE,
+        INCBIN,
+        REPT,
+        ENDR,
+        FILL,
+        ZERO,
+
+        INVALID = 0xFF,
+    };
+
+    constexpr uint8_t kInvalidRegister = 0xFF;
+
+    // Core instruction information, indexed by `Mnemonic`
+    inline constexpr std::array<InstructionInfo, static_cast<size_t>(Mnemonic::COUNT)> kInstructionInfo = {{
+        // R‑type arithmetic & logic (opcode = R_TYPE - 0x33)
+        {InstructionInfo::Type::R_TYPE, 0b000, 0b0000000, 3}, // add
+        {InstructionInfo::Type::R_TYPE, 0b000, 0b0100000, 3}, // sub
+        {InstructionInfo::Type::R_TYPE, 0b001, 0b0000000, 3}, // sll
+        {InstructionInfo::Type::R_TYPE, 0b010, 0b0000000, 3}, // slt
+        {InstructionInfo::Type::R_TYPE, 0b011, 0b0000000, 3}, // sltu
+        {InstructionInfo::Type::R_TYPE, 0b100, 0b0000000, 3}, // xor
+        {InstructionInfo::Type::R_TYPE, 0b101, 0b0000000, 3}, // srl
+        {InstructionInfo::Type::R_TYPE, 0b101, 0b0100000, 3}, // sra
+        {InstructionInfo::Type::R_TYPE, 0b110, 0b0000000, 3}, // or
+        {InstructionInfo::Type::R_TYPE, 0b111, 0b0000000, 3}, // and
+
+        // I‑type arithmetic / immediate (opcode = I_TYPE - 0x13)
+        {InstructionInfo::Type::I_TYPE, 0b000, /*func7 N/A*/ 0, 3}, // addi
+        {InstructionInfo::Type::I_TYPE, 0b010, 0, 3},               // slti
+        {InstructionInfo::Type::I_TYPE, 0b011, 0, 3},               // sltiu
+        {InstructionInfo::Type::I_TYPE, 0b100, 0, 3},               // xori
+        {InstructionInfo::Type::I_TYPE, 0b110, 0, 3},               // ori
+        {InstructionInfo::Type::I_TYPE, 0b111, 0, 3},               // andi
+        {InstructionInfo::Type::I_TYPE, 0b001, 0b0000000, 3},       // slli
+        {InstructionInfo::Type::I_TYPE, 0b101, 0b0000000, 3},       // srli
+        {InstructionInfo::Type::I_TYPE, 0b101, 0b0100000, 3},       // srai
+
+        // Loads (opcode = LOAD - 0x03)
+        {InstructionInfo::Type::LOAD, 0b000, 0, 2}, // lb
+        {InstructionInfo::Type::LOAD, 0b001, 0, 2}, // lh
+        {InstructionInfo::Type::LOAD, 0b010, 0, 2}, // lw
+        {InstructionInfo::Type::LOAD, 0b100, 0, 2}, // lbu
+        {InstructionInfo::Type::LOAD, 0b101, 0, 2}, // lhu
+
+        // Stores (opcode = STORE - 0x23)
+        {InstructionInfo::Type::STORE, 0b000, 0, 2}, // sb
+        {InstructionInfo::Type::STORE, 0b001, 0, 2}, // sh
+        {InstructionInfo::Type::STORE, 0b010, 0, 2}, // sw
+
+        // Branches (opcode = BRANCH - 0x63)
+        {InstructionInfo::Type::BRANCH, 0b000, 0, 3}, // beq
+        {InstructionInfo::Type::BRANCH, 0b001, 0, 3}, // bne
+        {InstructionInfo::Type::BRANCH, 0b100, 0, 3}, // blt
+        {InstructionInfo::Type::BRANCH, 0b101, 0, 3}, // bge
+        {InstructionInfo::Type::BRANCH, 0b110, 0, 3}, // bltu
+        {InstructionInfo::Type::BRANCH, 0b111, 0, 3}, // bgeu
+
+        // Upper immediates (U‑type)
+        {InstructionInfo::Type::U_TYPE, 0, 0, 2}, // lui
+        {InstructionInfo::Type::AUIPC, 0, 0, 2},  // auipc
+
+        // Jumps
+        {InstructionInfo::Type::J_TYPE, 0, 0, 2},     // jal
+        {InstructionInfo::Type::JALR, 0b000, 0, 2},   // jalr, encoded as I-type
+
+        // Pseudo-instructions
+        {InstructionInfo::Type::PSEUDO, 0, 0, 2}, // la
+        {InstructionInfo::Type::PSEUDO, 0, 0, 2}, // j
+    }};
+
+    namespace detail
+    {
+        inline constexpr PerfectHashEntry<Mnemonic> kMnemonicEntries[] = {
+            {"add", Mnemonic::ADD},
+            {"sub", Mnemonic::SUB},
+            {"sll", Mnemonic::SLL},
+            {"slt", Mnemonic::SLT},
+            {"sltu", Mnemonic::SLTU},
+            {"xor", Mnemonic::XOR},
+            {"srl", Mnemonic::SRL},
+            {"sra", Mnemonic::SRA},
+            {"or", Mnemonic::OR},
+            {"and", Mnemonic::AND},
+            {"addi", Mnemonic::ADDI},
+            {"slti", Mnemonic::SLTI},
+            {"sltiu", Mnemonic::SLTIU},
+            {"xori", Mnemonic::XORI},
+            {"ori", Mnemonic::ORI},
+            {"andi", Mnemonic::ANDI},
+            {"slli", Mnemonic::SLLI},
+            {"srli", Mnemonic::SRLI},
+            {"srai", Mnemonic::SRAI},
+            {"lb", Mnemonic::LB},
+            {"lh", Mnemonic::LH},
+            {"lw", Mnemonic::LW},
+            {"lbu", Mnemonic::LBU},
+            {"lhu", Mnemonic::LHU},
+            {"sb", Mnemonic::SB},
+            {"sh", Mnemonic::SH},
+            {"sw", Mnemonic::SW},
+            {"beq", Mnemonic::BEQ},
+            {"bne", Mnemonic::BNE},
+            {"blt", Mnemonic::BLT},
+            {"bge", Mnemonic::BGE},
+            {"bltu", Mnemonic::BLTU},
+            {"bgeu", Mnemonic::BGEU},
+            {"lui", Mnemonic::LUI},
+            {"auipc", Mnemonic::AUIPC},
+            {"jal", Mnemonic::JAL},
+            {"jalr", Mnemonic::JALR},
+            {"la", Mnemonic::LA},
+            {"j", Mnemonic::J},
+        };
+
+        inline constexpr PerfectHashEntry<uint8_t> kRegisterEntries[] = {
+            // Numeric names
+            {"x0", 0x00},
+            {"x1", 0x01},
+            {"x2", 0x02},
+            {"x3", 0x03},
+            {"x4", 0x04},
+            {"x5", 0x05},
+            {"x6", 0x06},
+            {"x7", 0x07},
+            {"x8", 0x08},
+            {"x9", 0x09},
+            {"x10", 0x0A},
+            {"x11", 0x0B},
+            {"x12", 0x0C},
+            {"x13", 0x0D},
+            {"x14", 0x0E},
+            {"x15", 0x0F},
+            {"x16", 0x10},
+            {"x17", 0x11},
+            {"x18", 0x12},
+            {"x19", 0x13},
+            {"x20", 0x14},
+            {"x21", 0x15},
+            {"x22", 0x16},
+            {"x23", 0x17},
+            {"x24", 0x18},
+            {"x25", 0x19},
+            {"x26", 0x1A},
+            {"x27", 0x1B},
+            {"x28", 0x1C},
+            {"x29", 0x1D},
+            {"x30", 0x1E},
+            {"x31", 0x1F},
+
+            // ABI names
+            {"zero", 0x00}, // Hard-wired zero
+            {"ra", 0x01},   // Return address
+            {"sp", 0x02},   // Stack pointer
+            {"gp", 0x03},   // Global pointer
+            {"tp", 0x04},   // Thread pointer
+            {"t0", 0x05},
+            {"t1", 0x06},
+            {"t2", 0x07}, // Temporaries
+            {"s0", 0x08},
+            {"fp", 0x08}, // Saved register / frame pointer
+            {"s1", 0x09}, // Saved register
+            {"a0", 0x0A},
+            {"a1", 0x0B}, // Function arguments / return values
+            {"a2", 0x0C},
+            {"a3", 0x0D},
+            {"a4", 0x0E},
+            {"a5", 0x0F}, // Function arguments
+            {"a6", 0x10},
+            {"a7", 0x11}, // Function arguments
+            {"s2", 0x12},
+            {"s3", 0x13},
+            {"s4", 0x14},
+            {"s5", 0x15}, // Saved registers
+            {"s6", 0x16},
+            {"s7", 0x17},
+            {"s8", 0x18},
+            {"s9", 0x19}, // Saved registers
+            {"s10", 0x1A},
+            {"s11", 0x1B}, // Saved registers
+            {"t3", 0x1C},
+            {"t4", 0x1D},
+            {"t5", 0x1E},
+            {"t6", 0x1F}, // Temporaries
+        };
+
+        inline constexpr PerfectHashEntry<Directive> kDirectiveEntries[] = {
+            {".section", Directive::SECTION},
+            {".globl", Directive::GLOBL},
+            {".data", Directive::DATA},
+            {".text", Directive::TEXT},
+            {".byte", Directive::BYTE},
+            {".word", Directive::WORD},
+            {".dword", Directive::DWORD},
+            {".ascii", Directive::ASCII},
+            {".align", Directive::ALIGN},
+            {".space", Directive::SPACE},
+            {".include", Directive::INCLUDE},
+            {".incbin", Directive::INCBIN},
+            {".rept", Directive::REPT},
+            {".endr", Directive::ENDR},
+            {".fill", Directive::FILL},
+            {".zero", Directive::ZERO},
+        };
+
+        // Every key must map back to its own value
+        template <typename Table, typename Value, size_t N>
+        constexpr bool FindsAllEntries(const Table &table, const PerfectHashEntry<Value> (&entries)[N], Value missing)
+        {
+            for (size_t i = 0; i < N; ++i)
+            {
+                if (table.Find(entries[i].key, missing) != entries[i].value)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+    }
+
+    inline constexpr auto kMnemonicTable = MakePerfectHashTable(detail::kMnemonicEntries);
+    inline constexpr auto kRegisterTable = MakePerfectHashTable(detail::kRegisterEntries);
+    inline constexpr auto kDirectiveTable = MakePerfectHashTable(detail::kDirectiveEntries);
+
+    static_assert(detail::FindsAllEntries(kMnemonicTable, detail::kMnemonicEntries, Mnemonic::INVALID));
+    static_assert(detail::FindsAllEntries(kRegisterTable, detail::kRegisterEntries, kInvalidRegister));
+    static_assert(detail::FindsAllEntries(kDirectiveTable, detail::kDirectiveEntries, Directive::INVALID));
+    static_assert(kMnemonicTable.size() == static_cast<size_t>(Mnemonic::COUNT), "Every mnemonic needs a table entry");
+
+    // Encoding format of every real opcode, pseudo-instructions have none
+    constexpr Format FormatOf(InstructionInfo::Type opcode)
+    {
+        switch (opcode)
+        {
+        case InstructionInfo::Type::R_TYPE:
+            return Format::R;
+        case InstructionInfo::Type::I_TYPE:
+        case InstructionInfo::Type::LOAD:
+        case InstructionInfo::Type::JALR:
+            return Format::I;
+        case InstructionInfo::Type::STORE:
+            return Format::S;
+        case InstructionInfo::Type::BRANCH:
+            return Format::B;
+        case InstructionInfo::Type::U_TYPE:
+        case InstructionInfo::Type::AUIPC:
+            return Format::U;
+        case InstructionInfo::Type::J_TYPE:
+            return Format::J;
+        default:
+            return Format::COUNT;
+        }
+    }
+
+    // Encoded size in bytes, `la` expands to lui + addi
+    constexpr size_t InstructionSize(Mnemonic mnemonic)
+    {
+        return mnemonic == Mnemonic::LA ? 8 : 4;
+    }
+
+    // Source spelling of `mnemonic`, the entries are listed in enum order
+    constexpr std::string_view MnemonicName(Mnemonic mnemonic)
+    {
+        return mnemonic < Mnemonic::COUNT ? detail::kMnemonicEntries[static_cast<size_t>(mnemonic)].key : "";
+    }
+
+    static_assert(MnemonicName(Mnemonic::J) == "j", "Mnemonic entries must follow enum order");
+
+    /**
+     * @brief Size in bytes of one entry of a data directive, 0 for non-data directives.
+     */
+    constexpr size_t DataEntrySize(Directive directive)
+    {
+        switch (directive)
+        {
+        case Directive::BYTE:
+        case Directive::ASCII:
+            return 1;
+        case Directive::WORD:
+            return 4;
+        case Directive::DWORD:
+            return 8;
+        default:
+            return 0;
+        }
+    }
+
+    // Sections where data types may be used
+    inline constexpr std::string_view kValidDataTypeSections[] = {".data", ".bss", ".rodata"};
+
+} // namespace cforge
@@ -1,177 +1,565 @@
 #include "linker.hpp"
 
 // std
+#include <algorithm>
 #include <iostream>
+#include <unordered_set>
 #include <vector>
-#include <bitset>
 
 namespace cforge
 {
 
     std::vector<uint8_t> Linker::Link(const IR &ir)
     {
-        std::vector<uint8_t> output;                    // Should write to file instead
-        output.reserve(ir.section_size_map.size() * 4); // Reserve space for the output
-
-        // Create absolute section map
-        CreateAbsoluteSectionMap(ir);
+        const IR *modules[] = {&ir};
+        return Link(modules, 1);
+    }
 
-        // Resolve absolute symbols
-        CreateAbsoluteSymbolMap(ir);
-        std::cout << "Symbol address map:\n";
-        for (const auto &symbol : absolute_symbol_map_)
+    std::vector<uint8_t> Linker::Link(const std::vector<IR> &modules)
+    {
+        std::vector<const IR *> pointers;
+        pointers.reserve(modules.size());
+        for (const IR &ir : modules)
         {
-            std::cout << "Symbol: " << symbol.first << " Address: " << std::hex << symbol.second << "\n";
+            pointers.push_back(&ir);
         }
+        return Link(pointers.data(), pointers.size());
+    }
 
-        // Iterate over sections and write data
-        for (const auto &section : ir.section_data)
-        {
-            const auto &section_name = section.first;
-            const auto &section_data = section.second;
+    std::vector<uint8_t> Linker::Link(const std::vector<const IR *> &modules)
+    {
+        return Link(modules.data(), modules.size());
+    }
+
+    std::vector<uint8_t> Linker::Link(const std::vector<const IR *> &modules,
+                                      const std::vector<IrArchive *> &archives)
+    {
+        std::vector<const IR *> linked = modules;
+        LoadArchiveMembers(linked, archives);
+        return Link(linked.data(), linked.size());
+    }
 
-            std::cout << "\nSection: " << section_name << " Data: ";
-            for (const auto &byte : section_data)
+    void Linker::LoadArchiveMembers(std::vector<const IR *> &modules,
+                                    const std::vector<IrArchive *> &archives) const
+    {
+        std::unordered_set<std::string_view> globals; // Defined by `modules`, views into their IR
+        auto add_globals = [&globals](const IR &ir)
+        {
+            for (SymbolId id = 0; id < ir.symbol_table.size(); ++id)
             {
-                std::cout << std::hex << static_cast<int>(byte) << " ";
+                if (ir.symbol_table[id].defined && ir.symbol_table[id].global)
+                {
+                    globals.insert(ir.symbol_names.Get(id));
+                }
             }
-            output.insert(output.end(), section_data.begin(), section_data.end());
+        };
+        for (const IR *ir : modules)
+        {
+            add_globals(*ir);
         }
 
-        // Resolve relocations
-        for (const auto &reloc : ir.relocations)
+        // Loaded members are appended and scanned in turn, until nothing new is needed
+        std::vector<std::vector<bool>> loaded(archives.size());
+        for (size_t a = 0; a < archives.size(); ++a)
         {
-            // Get instruction [instruction_id*4:instruction_id*4 + 3]
-            size_t offset = reloc.instruction_id * 4;
-            std::vector<uint8_t> instruction_copy = Extract4ByteCopy(ir.section_data.at(reloc.section), offset);
-
-            std::cout << "Old instruction bytes: ";
-            for (const auto &byte : instruction_copy)
+            loaded[a].assign(archives[a]->size(), false);
+        }
+        for (size_t m = 0; m < modules.size(); ++m)
+        {
+            const IR &ir = *modules[m];
+            for (SymbolId id = 0; id < ir.symbol_table.size(); ++id)
             {
-                std::cout << std::hex << static_cast<int>(byte) << " ";
+                std::string_view name = ir.symbol_names.Get(id);
+                if (ir.symbol_table[id].defined || globals.count(name) != 0)
+                {
+                    continue;
+                }
+                for (size_t a = 0; a < archives.size(); ++a)
+                {
+                    size_t member = archives[a]->FindSymbol(name);
+                    if (member == IrArchive::kNoMember)
+                    {
+                        continue;
+                    }
+                    if (!loaded[a][member])
+                    {
+                        loaded[a][member] = true;
+                        const IR &loaded_member = archives[a]->Member(member);
+                        add_globals(loaded_member);
+                        modules.push_back(&loaded_member);
+                        if (verbose_)
+                        {
+                            std::cout << "Loading " << archives[a]->path().string() << "("
+                                      << archives[a]->member_name(member) << ") for " << name << "\n";
+                        }
+                    }
+                    break;
+                }
             }
-            std::cout << std::endl;
-            // instruction_copy = is technically unnecessary, but it makes the code more readable
-            instruction_copy = ResolveRelocation(ir, reloc, instruction_copy);
+        }
+    }
+
+    std::vector<uint8_t> Linker::Link(const IR *const *modules, size_t count)
+    {
+        std::vector<uint8_t> output(Layout(modules, count), 0);
+        WriteImage(modules, count, output.data(), output.size());
+        return output;
+    }
+
+    void Linker::LinkToFile(const std::vector<const IR *> &modules,
+                            const std::vector<IrArchive *> &archives,
+                            const std::filesystem::path &path)
+    {
+        std::vector<const IR *> linked = modules;
+        LoadArchiveMembers(linked, archives);
+
+        // The size is known before anything is written, the image is built in the mapping
+        size_t size = Layout(linked.data(), linked.size());
+        MappedOutputFile output(path, size);
+        WriteImage(linked.data(), linked.size(), output.data(), output.size());
+        output.Commit();
+    }
+
+    void Linker::set_section_order(std::vector<std::string> order)
+    {
+        section_order_ = std::move(order);
+    }
+
+    void Linker::set_section_alignment(const std::string &section, size_t alignment)
+    {
+        if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+        {
+            throw Error("Section alignment must be a power of two: " + section);
+        }
+        section_alignments_[section] = alignment;
+    }
+
+    size_t Linker::Layout(const IR *const *modules, size_t count)
+    {
+        // Create absolute section map
+        size_t total_size = CreateAbsoluteSectionMap(modules, count);
 
-            std::cout << "\nNew instruction bytes: ";
-            for (const auto &byte : instruction_copy)
+        // Resolve absolute symbols
+        CreateAbsoluteSymbolMap(modules, count);
+        external_references_.clear();
+        if (incremental_)
+        {
+            for (size_t m = 0; m < count; ++m)
             {
-                std::cout << std::hex << static_cast<int>(byte) << " ";
+                IndexExternalReferences(*modules[m], m);
             }
-
-            // Write the modified instruction back to the output
-            auto output_offset = absolute_section_map_.at(reloc.section) + offset;
-            for (size_t i = 0; i < 4; ++i)
+        }
+        if (verbose_)
+        {
+            std::cout << "Symbol address map:\n";
+            for (size_t m = 0; m < count; ++m)
             {
-                if (output_offset + i < output.size())
+                for (SymbolId id = 0; id < absolute_symbol_map_[m].size(); ++id)
                 {
-                    output[output_offset + i] = instruction_copy[i];
+                    if (absolute_symbol_map_[m][id] != kUnresolved)
+                    {
+                        std::cout << "Symbol: " << modules[m]->symbol_names.Get(id) << " Address: " << std::hex << absolute_symbol_map_[m][id] << "\n";
+                    }
                 }
-                else
+            }
+        }
+        return total_size;
+    }
+
+    void Linker::WriteImage(const IR *const *modules, size_t count, uint8_t *image, size_t size)
+    {
+        // Place every module's part of each section
+        for (size_t m = 0; m < count; ++m)
+        {
+            const IR &ir = *modules[m];
+            if (verbose_)
+            {
+                for (SectionId id = 0; id < ir.sections.size(); ++id)
                 {
-                    throw Error("Offset out of bounds while writing modified instruction");
+                    std::cout << "\nSection: " << ir.section_names.Get(id) << " Data: ";
+                    for (const auto &byte : ir.sections[id].data)
+                    {
+                        std::cout << std::hex << static_cast<int>(byte) << " ";
+                    }
                 }
             }
+            CopySections(ir, m, image, size);
         }
 
-        return output;
+        // Resolve relocations, in section and word order within every module
+        for (size_t m = 0; m < count; ++m)
+        {
+            const IR &ir = *modules[m];
+            for (size_t r = 0; r < ir.relocations.size(); ++r)
+            {
+                PatchImage(ir, m, ir.relocations[r], image, size);
+            }
+        }
     }
 
-    std::vector<uint8_t> Linker::Extract4ByteCopy(
-        const std::vector<uint8_t> &input,
-        size_t offset)
+    void Linker::CopySections(const IR &ir, size_t module, uint8_t *image, size_t size) const
     {
-        if (offset + 4 > input.size())
+        for (SectionId id = 0; id < ir.sections.size(); ++id)
         {
-            throw Error("Offset out of bounds for 4-byte copy extraction, likely a bug in the linker");
+            const auto &section_data = ir.sections[id].data;
+            size_t base = module_section_map_[module].at(id);
+            if (section_data.size() > ir.sections[id].size || base + section_data.size() > size)
+            {
+                throw Error("Section data exceeds its size: " + std::string(ir.section_names.Get(id)));
+            }
+            std::copy(section_data.begin(), section_data.end(), image + base);
         }
-        return std::vector<uint8_t>(input.begin() + offset, input.begin() + offset + 4);
     }
 
-    void Linker::CreateAbsoluteSectionMap(
-        const IR &ir)
+    size_t Linker::CreateAbsoluteSectionMap(
+        const IR *const *modules,
+        size_t count)
     {
+        std::vector<std::string> section_order;
+        std::unordered_set<std::string> seen;
+        for (size_t m = 0; m < count; ++m)
+        {
+            const IR &ir = *modules[m];
+            for (SectionId id = 0; id < ir.sections.size(); ++id)
+            {
+                auto inserted = seen.emplace(ir.section_names.Get(id));
+                if (inserted.second)
+                {
+                    section_order.push_back(*inserted.first);
+                }
+            }
+        }
+
+        // Section IDs follow first use in each source, so sections are laid
+        // out in the configured order instead, unlisted sections by name
+        auto rank = [this](const std::string &section)
+        {
+            auto it = std::find(section_order_.begin(), section_order_.end(), section);
+            return static_cast<size_t>(it - section_order_.begin());
+        };
+        std::sort(section_order.begin(), section_order.end(),
+                  [&rank](const std::string &a, const std::string &b)
+                  {
+                      size_t rank_a = rank(a);
+                      size_t rank_b = rank(b);
+                      return rank_a != rank_b ? rank_a < rank_b : a < b;
+                  });
+
+        // Modules are concatenated in order within every section, each part
+        // starting at the section's alignment
         absolute_section_map_.clear();
+        module_section_map_.assign(count, {});
+        for (size_t m = 0; m < count; ++m)
+        {
+            module_section_map_[m].resize(modules[m]->sections.size());
+        }
         size_t current_offset = 0;
-        for (const auto &section_pair : ir.section_size_map)
+        for (const std::string &section_name : section_order)
         {
-            const auto &section_name = section_pair.first;
-            const auto &section_size = section_pair.second;
+            auto alignment_it = section_alignments_.find(section_name);
+            const size_t alignment = alignment_it != section_alignments_.end() ? alignment_it->second : 1;
+            current_offset = (current_offset + alignment - 1) & ~(alignment - 1);
             absolute_section_map_[section_name] = current_offset;
-            current_offset += section_size;
+            for (size_t m = 0; m < count; ++m)
+            {
+                SectionId id = modules[m]->section_names.Find(section_name);
+                if (id == kInvalidSection)
+                {
+                    continue;
+                }
+                current_offset = (current_offset + alignment - 1) & ~(alignment - 1);
+                module_section_map_[m][id] = current_offset;
+                current_offset += modules[m]->sections[id].size;
+            }
         }
+        return current_offset;
     }
 
     void Linker::CreateAbsoluteSymbolMap(
-        const IR &ir)
+        const IR *const *modules,
+        size_t count)
     {
-        absolute_symbol_map_.clear();
-        for (const auto &symbol_pair : ir.symbol_map)
+        absolute_symbol_map_.assign(count, {});
+        global_symbol_map_.clear();
+        for (size_t m = 0; m < count; ++m)
+        {
+            DefineModuleSymbols(*modules[m], m);
+        }
+
+        // References to symbols a module doesn't define go to the global definitions
+        for (size_t m = 0; m < count; ++m)
         {
-            // Get symbol, section and offset
-            const auto &symbol = symbol_pair.first;
+            ResolveModuleReferences(*modules[m], m);
+        }
+    }
+
+    void Linker::DefineModuleSymbols(const IR &ir, size_t module)
+    {
+        absolute_symbol_map_[module].assign(ir.symbol_table.size(), kUnresolved);
+        for (SymbolId id = 0; id < ir.symbol_table.size(); ++id)
+        {
+            const SymbolEntry &entry = ir.symbol_table[id];
+            if (!entry.defined)
+            {
+                continue;
+            }
 
-            const auto &section = symbol_pair.second.section;
-            const auto &offset_local = symbol_pair.second.offset;
+            // Get section and offset
+            SectionId section = entry.location.section;
+            const auto &offset_local = entry.location.offset;
 
-            // Get the absolute section offset
-            auto section_it = absolute_section_map_.find(section);
-            if (section_it == absolute_section_map_.end())
+            // Get the absolute offset of this module's part of the section
+            if (section >= module_section_map_[module].size())
             {
-                throw Error("Section not found in absolute section map: " + section);
+                throw Error("Symbol defined in an unknown section: " + std::string(ir.symbol_names.Get(id)));
             }
-            size_t section_offset = section_it->second;
 
             // Calculate the absolute offset
-            size_t absolute_offset = section_offset + offset_local;
-            absolute_symbol_map_[symbol] = absolute_offset;
+            size_t absolute_offset = module_section_map_[module][section] + offset_local;
+            absolute_symbol_map_[module][id] = absolute_offset;
+
+            if (entry.global &&
+                !global_symbol_map_.emplace(ir.symbol_names.Get(id), absolute_offset).second)
+            {
+                throw Error("Global symbol defined in more than one module: " + std::string(ir.symbol_names.Get(id)));
+            }
         }
     }
 
-    std::vector<uint8_t> &Linker::ResolveRelocation(
-        const IR &ir,
-        const RelocationEntry &reloc,
-        std::vector<uint8_t> &input)
+    void Linker::ResolveModuleReferences(const IR &ir, size_t module)
     {
-        switch (reloc.type)
+        for (SymbolId id = 0; id < ir.symbol_table.size(); ++id)
         {
-        // case RelocationEntry::Type::R_RISC_V_HI20:
-        case RelocationEntry::Type::R_RISC_V_LO12_I:
-            return input;
-            // case RelocationEntry::Type::R_RISC_V_LO12_S:
+            if (ir.symbol_table[id].defined)
+            {
+                continue;
+            }
+            auto global_it = global_symbol_map_.find(ir.symbol_names.Get(id));
+            absolute_symbol_map_[module][id] = global_it != global_symbol_map_.end() ? global_it->second : kUnresolved;
+        }
+    }
 
-        case RelocationEntry::Type::R_RISC_V_JAL:
+    void Linker::IndexExternalReferences(const IR &ir, size_t module)
+    {
+        for (size_t r = 0; r < ir.relocations.size(); ++r)
+        {
+            SymbolId symbol = ir.relocations.symbol(r);
+            if (!ir.symbol_table[symbol].defined)
+            {
+                external_references_[std::string(ir.symbol_names.Get(symbol))].push_back({module, r});
+            }
+        }
+    }
+
+    void Linker::UnindexExternalReferences(const IR &ir, size_t module)
+    {
+        for (size_t r = 0; r < ir.relocations.size(); ++r)
+        {
+            SymbolId symbol = ir.relocations.symbol(r);
+            if (ir.symbol_table[symbol].defined)
+            {
+                continue;
+            }
+            auto it = external_references_.find(std::string(ir.symbol_names.Get(symbol)));
+            if (it == external_references_.end())
+            {
+                continue;
+            }
+            auto &references = it->second;
+            references.erase(std::remove_if(references.begin(), references.end(),
+                                            [module](const ExternalReference &reference)
+                                            { return reference.module == module; }),
+                             references.end());
+        }
+    }
+
+    void Linker::PatchImage(const IR &ir, size_t module, const RelocationEntry &reloc, uint8_t *image, size_t size)
+    {
+        // Instruction [instruction_id*4:instruction_id*4 + 3] of the relocation's section
+        size_t output_offset = module_section_map_[module].at(reloc.section) + reloc.instruction_id * 4;
+        if (output_offset + 4 > size)
+        {
+            throw Error("Relocation outside of the image, likely a bug in the linker");
+        }
+
+        uint32_t word = LoadWord(image + output_offset);
+        uint32_t patched = ResolveRelocation(ir, module, reloc, word);
+        if (verbose_)
+        {
+            std::cout << "Patched instruction at " << std::hex << output_offset << ": "
+                      << word << " -> " << patched << "\n";
+        }
+        StoreWord(image + output_offset, patched);
+    }
+
+    bool Linker::Relink(const std::vector<const IR *> &modules,
+                        const std::vector<const IR *> &previous,
+                        std::vector<uint8_t> &image)
+    {
+        const size_t count = modules.size();
+        if (!incremental_ || previous.size() != count || absolute_symbol_map_.size() != count)
+        {
+            image = Link(modules);
+            return false;
+        }
+
+        // Anything that moves a section invalidates every address
+        auto previous_sections = std::move(absolute_section_map_);
+        auto previous_module_sections = std::move(module_section_map_);
+        size_t total_size = CreateAbsoluteSectionMap(modules.data(), count);
+        if (total_size != image.size() ||
+            absolute_section_map_ != previous_sections ||
+            module_section_map_ != previous_module_sections)
+        {
+            image = Link(modules);
+            return false;
+        }
+
+        try
+        {
+            RelinkChanged(modules, previous, image);
+        }
+        catch (...)
+        {
+            // The bookkeeping is half updated, the next relink starts over
+            absolute_symbol_map_.clear();
+            throw;
+        }
+        return true;
+    }
+
+    void Linker::RelinkChanged(const std::vector<const IR *> &modules,
+                               const std::vector<const IR *> &previous,
+                               std::vector<uint8_t> &image)
+    {
+        std::vector<size_t> changed;
+        for (size_t m = 0; m < modules.size(); ++m)
         {
-            // Get the symbol address
-            auto symbol_it = absolute_symbol_map_.find(reloc.symbol);
-            if (symbol_it == absolute_symbol_map_.end())
+            if (modules[m] != previous[m])
             {
-                throw Error("Symbol not found in absolute symbol map: " + reloc.symbol);
+                changed.push_back(m);
             }
-            size_t symbol_address = symbol_it->second;
+        }
 
-            size_t instruction_address = reloc.instruction_id * 4 + absolute_section_map_.at(reloc.section);
+        // Retract the globals and references of the old versions, their
+        // globals may have moved or disappeared
+        std::unordered_set<std::string> touched_globals;
+        for (size_t m : changed)
+        {
+            const IR &ir = *previous[m];
+            for (SymbolId id = 0; id < ir.symbol_table.size(); ++id)
+            {
+                if (ir.symbol_table[id].defined && ir.symbol_table[id].global)
+                {
+                    global_symbol_map_.erase(ir.symbol_names.Get(id));
+                    touched_globals.emplace(ir.symbol_names.Get(id));
+                }
+            }
+            UnindexExternalReferences(ir, m);
+        }
 
-            size_t offset = symbol_address - instruction_address;
+        for (size_t m : changed)
+        {
+            const IR &ir = *modules[m];
+            DefineModuleSymbols(ir, m);
+            for (SymbolId id = 0; id < ir.symbol_table.size(); ++id)
+            {
+                if (ir.symbol_table[id].defined && ir.symbol_table[id].global)
+                {
+                    touched_globals.emplace(ir.symbol_names.Get(id));
+                }
+            }
+        }
 
-            // FIX: Make sure address is not larger than 20 bits?
-            offset <<= 12; // Shift left by 12 bits to get the JAL offset
+        // Copy and patch the changed modules
+        for (size_t m : changed)
+        {
+            const IR &ir = *modules[m];
+            ResolveModuleReferences(ir, m);
+            IndexExternalReferences(ir, m);
+            CopySections(ir, m, image.data(), image.size());
+            for (size_t r = 0; r < ir.relocations.size(); ++r)
+            {
+                PatchImage(ir, m, ir.relocations[r], image.data(), image.size());
+            }
+        }
 
-            // Write the symbol address into the instruction
-            for (size_t i = 0; i < 4; ++i)
+        // Patch the other modules' references to globals that may have moved
+        for (const std::string &name : touched_globals)
+        {
+            auto references_it = external_references_.find(name);
+            if (references_it == external_references_.end())
+            {
+                continue;
+            }
+            auto global_it = global_symbol_map_.find(name);
+            size_t address = global_it != global_symbol_map_.end() ? global_it->second : kUnresolved;
+            for (const ExternalReference &reference : references_it->second)
             {
-                uint8_t &byte = input[i];
-                byte |= (offset >> (i * 8)) & 0xFF;
+                if (modules[reference.module] != previous[reference.module])
+                {
+                    continue; // Already patched above
+                }
+                const IR &ir = *modules[reference.module];
+                const RelocationEntry reloc = ir.relocations[reference.relocation];
+                absolute_symbol_map_[reference.module][reloc.symbol] = address;
+                PatchImage(ir, reference.module, reloc, image.data(), image.size());
             }
+        }
+    }
 
-            return input;
+    uint32_t Linker::ResolveRelocation(
+        const IR &ir,
+        size_t module,
+        const RelocationEntry &reloc,
+        uint32_t word) const
+    {
+        // Get the symbol address
+        const std::vector<size_t> &symbol_map = absolute_symbol_map_[module];
+        if (reloc.symbol >= symbol_map.size() ||
+            symbol_map[reloc.symbol] == kUnresolved)
+        {
+            throw Error("Symbol not found in absolute symbol map: " + std::string(ir.symbol_names.Get(reloc.symbol)));
         }
+        int64_t symbol_address = static_cast<int64_t>(symbol_map[reloc.symbol]);
+        int64_t instruction_address = static_cast<int64_t>(reloc.instruction_id * 4 + module_section_map_[module].at(reloc.section));
+        int64_t offset = symbol_address - instruction_address;
+
+        // %hi is rounded so that adding the sign-extended %lo gives the address back
+        int32_t hi = static_cast<int32_t>((symbol_address + 0x800) & ~int64_t(0xFFF));
+        int32_t lo = static_cast<int32_t>(symbol_address - hi);
 
+        switch (reloc.type)
+        {
+        case RelocationEntry::Type::R_RISC_V_HI20:
+            word = PatchImmediate<Format::U>(word, hi);
+            break;
+        case RelocationEntry::Type::R_RISC_V_LO12_I:
+            word = PatchImmediate<Format::I>(word, lo);
+            break;
+        case RelocationEntry::Type::R_RISC_V_LO12_S:
+            word = PatchImmediate<Format::S>(word, lo);
+            break;
+        case RelocationEntry::Type::R_RISC_V_JAL:
+            if (!ImmediateFits(Format::J, offset))
+            {
+                throw Error("Jump target out of range: " + std::string(ir.symbol_names.Get(reloc.symbol)));
+            }
+            word = PatchImmediate<Format::J>(word, static_cast<int32_t>(offset));
+            break;
+        case RelocationEntry::Type::R_RISC_V_BRANCH:
+            if (!ImmediateFits(Format::B, offset))
+            {
+                throw Error("Branch target out of range: " + std::string(ir.symbol_names.Get(reloc.symbol)));
+            }
+            word = PatchImmediate<Format::B>(word, static_cast<int32_t>(offset));
+            break;
         default:
             throw Error("Unsupported relocation symbol: " +
-                        reloc.symbol +
+                        std::string(ir.symbol_names.Get(reloc.symbol)) +
                         " NOTE: This is likely a bug in the linker");
         }
+
+        return word;
     }
 }
@@ -2,7 +2,15 @@
 
 #include "error.hpp"
 #include "instruction_set.hpp"
+#include "ir_archive.hpp"
 #include "ir_parser.hpp"
+#include "mapped_file.hpp"
+
+// std
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace cforge
 {
@@ -14,37 +22,152 @@ namespace cforge
         Link(
             const cforge::IR &ir);
 
+        /**
+         * @brief Links several modules into one image.
+         * Sections of the same name are concatenated in module order, sections
+         * are placed as set by `set_section_order` and `set_section_alignment`,
+         * so the layout only depends on the modules and the settings. Symbols
+         * declared with .globl resolve references from every module, all other
+         * symbols are only visible inside the module that defines them.
+         */
+        std::vector<uint8_t> Link(const std::vector<IR> &modules);
+
+        // Same as above for modules owned elsewhere
+        std::vector<uint8_t> Link(const std::vector<const IR *> &modules);
+
+        /**
+         * @brief Links `modules` and the archive members they need.
+         * Every symbol the linked modules reference but no module defines is
+         * looked up in the archives in order, the first member defining it is
+         * loaded and linked after the modules. Members pull in further members
+         * the same way, members nothing refers to are never decoded.
+         */
+        std::vector<uint8_t> Link(const std::vector<const IR *> &modules,
+                                  const std::vector<IrArchive *> &archives);
+
+        /**
+         * @brief Links like `Link`, straight into the file at `path`.
+         * The image size is computed first, then the file is created at that
+         * size, mapped, and the sections and patched words are written into
+         * the mapping. No copy of the image is held in memory.
+         * @throws Error if the file cannot be created or linking fails.
+         */
+        void LinkToFile(const std::vector<const IR *> &modules,
+                        const std::vector<IrArchive *> &archives,
+                        const std::filesystem::path &path);
+
+        /**
+         * @brief Updates `image` after some modules were reassembled.
+         * `image` must be the result of the last link over `previous`, whose
+         * modules must still be alive; `modules[i] != previous[i]` marks module
+         * `i` as changed. Only the changed modules are copied and patched again,
+         * together with the relocations of other modules that refer to their
+         * globals. Falls back to a full link if the section layout changed or
+         * incremental linking is disabled.
+         * @return True if the image was updated in place.
+         */
+        bool Relink(const std::vector<const IR *> &modules,
+                    const std::vector<const IR *> &previous,
+                    std::vector<uint8_t> &image);
+
+        // Keep the reference index `Relink` needs (default: false)
+        void set_incremental(bool incremental) { incremental_ = incremental; }
+
+        // Print the symbol map and every patched instruction (default: true)
+        void set_verbose(bool verbose) { verbose_ = verbose; }
+
+        // Sections listed come first, in this order, the others follow by name (default: .text, .rodata, .data, .bss)
+        void set_section_order(std::vector<std::string> order);
+
+        /**
+         * Starts `section`, and every module's part of it, at a multiple of `alignment` bytes (default: 1).
+         * @throws Error if `alignment` is not a power of two.
+         */
+        void set_section_alignment(const std::string &section, size_t alignment);
+
     private:
+        std::vector<uint8_t> Link(const IR *const *modules, size_t count);
+
+        // Appends the archive members `modules` depend on to `modules`
+        void LoadArchiveMembers(std::vector<const IR *> &modules,
+                                const std::vector<IrArchive *> &archives) const;
+
         /**
-         * @brief Extracts a 4-byte copy from the input data at the specified offset.
-         * @param input The input data to extract from.
-         * @param offset The offset to start extracting from.
-         * @return A vector containing the 4-byte copy.
+         * @brief Assigns every section and symbol its address.
+         * @return Size of the linked image in bytes.
          */
-        static std::vector<uint8_t> Extract4ByteCopy(
-            const std::vector<uint8_t> &input,
-            size_t offset);
+        size_t Layout(const IR *const *modules, size_t count);
 
-        void CreateAbsoluteSectionMap(
-            const IR &ir);
+        // Fills the zeroed `image` of `Layout`'s size with the sections and patches every relocation
+        void WriteImage(const IR *const *modules, size_t count, uint8_t *image, size_t size);
+
+        // Copies the section data of module `module` into its place in `image`
+        void CopySections(const IR &ir, size_t module, uint8_t *image, size_t size) const;
+
+        /**
+         * @brief Lays out the sections of all modules.
+         * @return Size of the linked image in bytes.
+         */
+        size_t CreateAbsoluteSectionMap(
+            const IR *const *modules,
+            size_t count);
 
         void CreateAbsoluteSymbolMap(
-            const IR &ir);
+            const IR *const *modules,
+            size_t count);
+
+        // Addresses of the symbols module `module` defines, registers its globals
+        void DefineModuleSymbols(const IR &ir, size_t module);
+
+        // Resolves the symbols module `module` references but doesn't define
+        void ResolveModuleReferences(const IR &ir, size_t module);
+
+        // Adds (or removes) the relocations of `ir` against symbols it doesn't define
+        void IndexExternalReferences(const IR &ir, size_t module);
+        void UnindexExternalReferences(const IR &ir, size_t module);
+
+        // Incremental part of `Relink`, once the layout is known to be unchanged
+        void RelinkChanged(const std::vector<const IR *> &modules,
+                           const std::vector<const IR *> &previous,
+                           std::vector<uint8_t> &image);
+
+        // Patches the word `reloc` refers to in the linked `image`
+        void PatchImage(const IR &ir, size_t module, const RelocationEntry &reloc, uint8_t *image, size_t size);
 
         /**
-         * @brief Resolves a relocation entry in the input data.
+         * @brief Resolves a relocation entry.
          * @param ir The IR containing the relocation entries.
+         * @param module Index of `ir` in the linked modules.
          * @param reloc The relocation entry to resolve.
-         * @param input The input data to modify.
-         * @return same reference as `input`, can thus be omitted.
+         * @param word The instruction word the relocation applies to.
+         * @return `word` with the symbol's address or offset filled in.
          */
-        std::vector<uint8_t> &ResolveRelocation(
+        uint32_t ResolveRelocation(
             const IR &ir,
+            size_t module,
             const RelocationEntry &reloc,
-            std::vector<uint8_t> &input);
+            uint32_t word) const;
+
+        std::unordered_map<std::string, size_t> absolute_section_map_;            // Maps to section positions after sorting / offsetting
+        std::vector<std::vector<size_t>> module_section_map_;                     // Per module, indexed by `SectionId`, start of its part of the section
+        std::vector<std::vector<size_t>> absolute_symbol_map_;                    // Per module, indexed by `SymbolId`, kUnresolved if undefined
+        std::unordered_map<std::string_view, size_t> global_symbol_map_;          // .globl symbols of all modules, views into their IR
+        std::vector<std::string> section_order_ = {".text", ".rodata", ".data", ".bss"};
+        std::unordered_map<std::string, size_t> section_alignments_; // Power of two, by section name
+        bool verbose_ = true;
+
+        // Relocation `relocation` of module `module`
+        struct ExternalReference
+        {
+            size_t module;
+            size_t relocation;
+        };
+
+        // Incremental linking only: relocations against symbols defined in other modules, by name
+        std::unordered_map<std::string, std::vector<ExternalReference>> external_references_;
+        bool incremental_ = false;
 
-        std::unordered_map<std::string, size_t> absolute_section_map_; // Maps to section positions after sorting / offsetting
-        std::unordered_map<std::string, size_t> absolute_symbol_map_;
+        static constexpr size_t kUnresolved = static_cast<size_t>(-1);
     };
 
 }
\ No newline at end of file
@@ -0,0 +1,62 @@
+#pragma once
+
+// std
+#include <charconv>
+#include <cstdint>
+#include <limits>
+#include <string_view>
+
+namespace cforge
+{
+    /**
+     * @brief Decodes an unsigned integer literal without allocating.
+     * Accepts the forms `Lexer::LexNumber` produces: decimal, `0x`/`0X` hex
+     * and `0b`/`0B` binary. Leading zeros are decimal, there is no octal.
+     * @return False if `text` is not entirely a literal or exceeds 64 bits.
+     */
+    inline bool DecodeUnsigned(std::string_view text, uint64_t &value)
+    {
+        int base = 10;
+        if (text.size() > 2 && text[0] == '0')
+        {
+            if (text[1] == 'x' || text[1] == 'X')
+            {
+                base = 16;
+                text.remove_prefix(2);
+            }
+            else if (text[1] == 'b' || text[1] == 'B')
+            {
+                base = 2;
+                text.remove_prefix(2);
+            }
+        }
+
+        const char *end = text.data() + text.size();
+        auto result = std::from_chars(text.data(), end, value, base);
+        return !text.empty() && result.ec == std::errc() && result.ptr == end;
+    }
+
+    // Signed counterpart of `DecodeUnsigned`, with an optional leading '+' or '-'
+    inline bool DecodeInteger(std::string_view text, int64_t &value)
+    {
+        bool negative = !text.empty() && text[0] == '-';
+        if (!text.empty() && (text[0] == '-' || text[0] == '+'))
+        {
+            text.remove_prefix(1);
+        }
+
+        uint64_t magnitude = 0;
+        if (!DecodeUnsigned(text, magnitude))
+        {
+            return false;
+        }
+        constexpr uint64_t kMaxMagnitude = static_cast<uint64_t>(std::numeric_limits<int64_t>::max());
+        if (magnitude > kMaxMagnitude + (negative ? 1 : 0))
+        {
+            return false;
+        }
+        value = negative ? static_cast<int64_t>(0 - magnitude) : static_cast<int64_t>(magnitude);
+        return true;
+    }
+
+} // namespace cforge
@@ -1,66 +1,72 @@
-#include "assembler.hpp"
-#include "linker.hpp"
+#include "cli.hpp"
+#include "server.hpp"
 
 // std
 #include <iostream>
-#include <filesystem>
-#include <fstream>
 #include <string>
+#include <vector>
 
 using namespace cforge;
 
-std::filesystem::path GetSourceFolder()
+int main(int argc, char **argv)
 {
-    // Assuming the source files are in the "src" directory relative to the executable
-    return std::filesystem::path(__FILE__).parent_path();
-}
-
-int main()
-{
-    // Read prog.s into a string
-    std::string source_file = (GetSourceFolder() / "prog.s").string();
-
-    // Read the contents of the source file
-    std::ifstream file(source_file);
-    if (!file)
+    CommandLine command;
+    try
+    {
+        command = ParseCommandLine(Driver::ExpandResponseFiles(std::vector<std::string>(argv + 1, argv + argc)));
+    }
+    catch (const std::exception &e)
     {
-        std::cerr << "Error opening file: " << source_file << std::endl;
+        std::cerr << e.what() << std::endl;
         return 1;
     }
 
-    std::string file_contents((std::istreambuf_iterator<char>(file)),
-                              std::istreambuf_iterator<char>());
-    file.close();
-
-    try
+    if (command.help)
     {
+        PrintUsage(std::cout);
+        return 0;
+    }
 
-        cforge::Lexer lexer;
-        lexer.set_source(file_contents);
-
-        lexer.Analyze();
-
-        Parser parser;
-        auto tokens = lexer.get_tokens();
+    if (command.server)
+    {
+        try
+        {
+            std::string socket_path = command.socket_path.empty() ? Server::DefaultSocketPath() : command.socket_path;
+            Server server(socket_path, command.options.jobs);
+            std::cout << "Listening on " << server.socket_path() << std::endl;
+            server.Run();
+            return 0;
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+    }
 
-        IR ir = parser.Parse(tokens);
-        std::cout << "Parsed IR version: " << ir.version << std::endl;
+    if (command.inputs.empty())
+    {
+        PrintUsage(std::cout);
+        return 1;
+    }
 
-        // link
-        Linker linker;
-        std::vector<uint8_t> linked_output = linker.Link(ir);
-        std::cout << "Linked output size: " << linked_output.size() << " bytes" << std::endl;
-        // Write liked output
-        for (const auto &byte : linked_output)
+    try
+    {
+        ThreadPool pool(Driver::ThreadCount(command.options));
+        Driver driver(command.options, pool);
+        if (command.watch)
         {
-            std::cout << std::hex << static_cast<int>(byte) << " ";
+            return RunWatch(driver, command.inputs, command.output, std::cout, std::cerr);
         }
-
-        return 0;
+        if (!command.archive_output.empty())
+        {
+            return RunArchive(driver, command.inputs, command.archive_output, std::cout, std::cerr);
+        }
+        return RunCommand(driver, command.inputs, command.output, std::cout, std::cerr);
     }
     catch (const std::exception &e)
     {
         std::cerr << e.what() << std::endl;
         return 1;
     }
-}
\ No newline at end of file
+}
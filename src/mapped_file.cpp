@@ -0,0 +1,370 @@
+#include "mapped_file.hpp"
+
+// std
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace cforge
+{
+    namespace
+    {
+        /**
+         * File an output written to `path` ends up in. Symlinks are followed, so
+         * the final rename replaces the file they point to and not the link, and
+         * anything but a regular file is refused rather than swallowed by the rename.
+         */
+        std::filesystem::path ResolveOutput(const std::filesystem::path &path)
+        {
+            std::filesystem::path resolved = path;
+            for (int hops = 0;; ++hops)
+            {
+                std::error_code error;
+                std::filesystem::file_status status = std::filesystem::symlink_status(resolved, error);
+                if (!std::filesystem::is_symlink(status))
+                {
+                    if (std::filesystem::exists(status) && !std::filesystem::is_regular_file(status))
+                    {
+                        throw Error("Output is not a regular file: " + path.string());
+                    }
+                    return resolved;
+                }
+                if (hops == 40)
+                {
+                    throw Error("Too many levels of symbolic links: " + path.string());
+                }
+
+                std::filesystem::path target = std::filesystem::read_symlink(resolved, error);
+                if (error)
+                {
+                    throw Error("Failed to read symbolic link: " + resolved.string());
+                }
+                // Relative targets are relative to the directory holding the link
+                resolved = target.is_absolute() ? target : resolved.parent_path() / target;
+            }
+        }
+
+        // Temporary file beside `path`, unique within the process by counter and across processes by id
+        std::filesystem::path TempPathFor(const std::filesystem::path &path, unsigned long process)
+        {
+            static std::atomic<unsigned> counter{0};
+            std::filesystem::path temp = path;
+            temp += "." + std::to_string(process) + "-" + std::to_string(counter++) + ".tmp";
+            return temp;
+        }
+    }
+
+#if defined(_WIN32)
+    MappedFile::MappedFile(const std::filesystem::path &path)
+    {
+        HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                  OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            throw Error("Failed to open file: " + path.string());
+        }
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size))
+        {
+            CloseHandle(file);
+            throw Error("Failed to query file size: " + path.string());
+        }
+
+        file_handle_ = file;
+        size_ = static_cast<size_t>(size.QuadPart);
+        if (size_ == 0)
+        {
+            return;
+        }
+
+        HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping == nullptr)
+        {
+            Unmap();
+            throw Error("Failed to map file: " + path.string());
+        }
+        mapping_handle_ = mapping;
+
+        data_ = static_cast<const char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        if (data_ == nullptr)
+        {
+            Unmap();
+            throw Error("Failed to map file: " + path.string());
+        }
+    }
+
+    void MappedFile::Unmap() noexcept
+    {
+        if (data_ != nullptr)
+            UnmapViewOfFile(data_);
+        if (mapping_handle_ != nullptr)
+            CloseHandle(mapping_handle_);
+        if (file_handle_ != nullptr)
+            CloseHandle(file_handle_);
+        data_ = nullptr;
+        size_ = 0;
+        mapping_handle_ = nullptr;
+        file_handle_ = nullptr;
+    }
+
+    MappedOutputFile::MappedOutputFile(const std::filesystem::path &path, size_t size)
+        : path_(path), size_(size)
+    {
+        path_ = ResolveOutput(path);
+        temp_path_ = TempPathFor(path_, GetCurrentProcessId());
+
+        HANDLE file = CreateFileW(temp_path_.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr,
+                                  CREATE_NEW, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            temp_path_.clear();
+            throw Error("Failed to create file: " + path.string());
+        }
+        file_handle_ = file;
+        if (size_ == 0)
+        {
+            return;
+        }
+
+        // Setting the end of file allocates the whole range
+        LARGE_INTEGER end;
+        end.QuadPart = static_cast<LONGLONG>(size_);
+        if (!SetFilePointerEx(file, end, nullptr, FILE_BEGIN) || !SetEndOfFile(file))
+        {
+            Discard();
+            throw Error("Failed to allocate file: " + path.string());
+        }
+
+        HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READWRITE, 0, 0, nullptr);
+        if (mapping == nullptr)
+        {
+            Discard();
+            throw Error("Failed to map file: " + path.string());
+        }
+        mapping_handle_ = mapping;
+
+        data_ = static_cast<uint8_t *>(MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0));
+        if (data_ == nullptr)
+        {
+            Discard();
+            throw Error("Failed to map file: " + path.string());
+        }
+    }
+
+    bool MappedOutputFile::Unmap(bool flush) noexcept
+    {
+        bool ok = true;
+        if (data_ != nullptr && flush)
+            ok = FlushViewOfFile(data_, 0) && ok;
+        if (data_ != nullptr)
+            ok = UnmapViewOfFile(data_) && ok;
+        if (mapping_handle_ != nullptr)
+            CloseHandle(mapping_handle_);
+        if (file_handle_ != nullptr && flush)
+            ok = FlushFileBuffers(file_handle_) && ok;
+        if (file_handle_ != nullptr)
+            ok = CloseHandle(file_handle_) && ok;
+        data_ = nullptr;
+        mapping_handle_ = nullptr;
+        file_handle_ = nullptr;
+        return ok;
+    }
+#else
+    MappedFile::MappedFile(const std::filesystem::path &path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            throw Error("Failed to open file: " + path.string());
+        }
+
+        struct stat st;
+        if (::fstat(fd, &st) != 0)
+        {
+            ::close(fd);
+            throw Error("Failed to query file size: " + path.string());
+        }
+
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ == 0)
+        {
+            ::close(fd);
+            return;
+        }
+
+        void *addr = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        // The mapping keeps its own reference to the file
+        ::close(fd);
+        if (addr == MAP_FAILED)
+        {
+            size_ = 0;
+            throw Error("Failed to map file: " + path.string());
+        }
+
+        // The lexer reads front to back exactly once
+        ::madvise(addr, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const char *>(addr);
+    }
+
+    void MappedFile::Unmap() noexcept
+    {
+        if (data_ != nullptr)
+        {
+            ::munmap(const_cast<char *>(data_), size_);
+        }
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+    MappedOutputFile::MappedOutputFile(const std::filesystem::path &path, size_t size)
+        : path_(path), size_(size)
+    {
+        path_ = ResolveOutput(path);
+
+        // Same directory as the target, so the final rename cannot cross file systems.
+        // Created like any new file, so the umask applies
+        int fd = -1;
+        for (int attempt = 0; fd < 0 && attempt < 16; ++attempt)
+        {
+            temp_path_ = TempPathFor(path_, static_cast<unsigned long>(::getpid()));
+            fd = ::open(temp_path_.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+            if (fd < 0 && errno != EEXIST)
+            {
+                break;
+            }
+        }
+        if (fd < 0)
+        {
+            temp_path_.clear();
+            throw Error("Failed to create file: " + path.string());
+        }
+
+        // A replaced file keeps its permissions
+        struct stat target;
+        if (::stat(path_.c_str(), &target) == 0 && ::fchmod(fd, target.st_mode & 07777) != 0)
+        {
+            ::close(fd);
+            Discard();
+            throw Error("Failed to set the permissions of file: " + path.string());
+        }
+        if (size_ == 0)
+        {
+            ::close(fd);
+            return;
+        }
+
+        // Allocate every block now, a sparse file would raise SIGBUS on a full disk
+        int error = ::posix_fallocate(fd, 0, static_cast<off_t>(size_));
+        if (error != 0)
+        {
+            ::close(fd);
+            Discard();
+            throw Error("Failed to allocate file: " + path.string() + ": " + std::strerror(error));
+        }
+
+        void *addr = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (addr == MAP_FAILED)
+        {
+            Discard();
+            throw Error("Failed to map file: " + path.string());
+        }
+
+        // Sections are copied front to back
+        ::madvise(addr, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<uint8_t *>(addr);
+    }
+
+    bool MappedOutputFile::Unmap(bool flush) noexcept
+    {
+        bool ok = true;
+        if (data_ != nullptr)
+        {
+            if (flush)
+            {
+                ok = ::msync(data_, size_, MS_SYNC) == 0;
+            }
+            ok = ::munmap(data_, size_) == 0 && ok;
+        }
+        data_ = nullptr;
+        return ok;
+    }
+#endif
+
+    MappedFile::~MappedFile()
+    {
+        Unmap();
+    }
+
+    MappedFile::MappedFile(MappedFile &&other) noexcept
+    {
+        *this = std::move(other);
+    }
+
+    MappedFile &MappedFile::operator=(MappedFile &&other) noexcept
+    {
+        if (this != &other)
+        {
+            Unmap();
+            data_ = std::exchange(other.data_, nullptr);
+            size_ = std::exchange(other.size_, 0);
+#if defined(_WIN32)
+            file_handle_ = std::exchange(other.file_handle_, nullptr);
+            mapping_handle_ = std::exchange(other.mapping_handle_, nullptr);
+#endif
+        }
+        return *this;
+    }
+
+    MappedOutputFile::~MappedOutputFile()
+    {
+        Discard();
+    }
+
+    void MappedOutputFile::Commit()
+    {
+        if (!Unmap(true))
+        {
+            Discard();
+            throw Error("Failed to write file: " + path_.string());
+        }
+
+        // Replaces the target in one step, readers see the old or the new image
+        std::error_code error;
+        std::filesystem::rename(temp_path_, path_, error);
+        if (error)
+        {
+            Discard();
+            throw Error("Failed to replace file: " + path_.string() + ": " + error.message());
+        }
+        temp_path_.clear();
+    }
+
+    void MappedOutputFile::Discard() noexcept
+    {
+        Unmap(false);
+        if (!temp_path_.empty())
+        {
+            std::error_code error;
+            std::filesystem::remove(temp_path_, error);
+            temp_path_.clear();
+        }
+    }
+
+} // namespace cforge
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "error.hpp"
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <filesystem>
+
+namespace cforge
+{
+
+	/**
+	 * @brief Read-only memory mapping of a whole file.
+	 * The mapping stays valid for the lifetime of the object, so views handed
+	 * out by `view()` (and every token that points into them) must not outlive it.
+	 * @note Empty files are represented by an empty view without a mapping.
+	 */
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+
+		/**
+		 * Maps the file at `path` into memory.
+		 * @throws Error if the file cannot be opened or mapped.
+		 */
+		explicit MappedFile(const std::filesystem::path &path);
+		~MappedFile();
+
+		MappedFile(const MappedFile &) = delete;
+		MappedFile &operator=(const MappedFile &) = delete;
+		MappedFile(MappedFile &&other) noexcept;
+		MappedFile &operator=(MappedFile &&other) noexcept;
+
+		const char *data() const { return data_; }
+		size_t size() const { return size_; }
+		bool empty() const { return size_ == 0; }
+
+		std::string_view view() const { return std::string_view(data_, size_); }
+
+	private:
+		void Unmap() noexcept;
+
+		const char *data_ = nullptr;
+		size_t size_ = 0;
+
+#if defined(_WIN32)
+		void *file_handle_ = nullptr;
+		void *mapping_handle_ = nullptr;
+#endif
+	};
+
+	/**
+	 * @brief Writable memory mapping of a file created at a fixed size.
+	 * The contents are built in a temporary file next to `path`, fully allocated
+	 * up front so running out of space fails here rather than as a fault while
+	 * writing. `Commit` flushes it and renames it over `path`; until then `path`
+	 * is untouched, and a mapping destroyed without a commit removes the temporary.
+	 * A symlinked `path` replaces the file it points to, a replaced file keeps its
+	 * permissions and a new one gets the default ones under the umask.
+	 */
+	class MappedOutputFile
+	{
+	public:
+		/**
+		 * Creates a zero-filled temporary file of `size` bytes beside `path` and maps it.
+		 * @throws Error if the file cannot be created, allocated or mapped.
+		 */
+		MappedOutputFile(const std::filesystem::path &path, size_t size);
+		~MappedOutputFile();
+
+		MappedOutputFile(const MappedOutputFile &) = delete;
+		MappedOutputFile &operator=(const MappedOutputFile &) = delete;
+
+		uint8_t *data() { return data_; }
+		size_t size() const { return size_; }
+
+		/**
+		 * Writes the contents back and replaces `path` with them.
+		 * @throws Error if the contents could not be written or the file not replaced,
+		 * the temporary file is removed either way.
+		 */
+		void Commit();
+
+	private:
+		// Unmaps the file, writing the contents back first if `flush`
+		bool Unmap(bool flush) noexcept;
+
+		// Unmaps and removes the temporary file
+		void Discard() noexcept;
+
+		std::filesystem::path path_;
+		std::filesystem::path temp_path_; // Empty once committed or discarded
+		uint8_t *data_ = nullptr;
+		size_t size_ = 0;
+
+#if defined(_WIN32)
+		void *file_handle_ = nullptr;
+		void *mapping_handle_ = nullptr;
+#endif
+	};
+
+} // cforge
@@ -0,0 +1,84 @@
+#include "module_cache.hpp"
+#include "error.hpp"
+
+namespace cforge
+{
+    ModuleCache::Stamp ModuleCache::StampOf(const std::filesystem::path &path)
+    {
+        std::error_code error;
+        Stamp stamp;
+        stamp.modified = std::filesystem::last_write_time(path, error);
+        if (!error)
+        {
+            stamp.size = std::filesystem::file_size(path, error);
+        }
+        if (error)
+        {
+            throw Error("Failed to stat file: " + path.string());
+        }
+        return stamp;
+    }
+
+    std::string ModuleCache::KeyOf(const std::string &path, const std::string &options)
+    {
+        // Paths never contain a NUL, so the split is unambiguous
+        std::string key = path;
+        key += '\0';
+        key += options;
+        return key;
+    }
+
+    ModuleCache::Module ModuleCache::Find(const std::string &path, const std::string &options, const Stamp &stamp) const
+    {
+        const std::string key = KeyOf(path, options);
+        Entry entry;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = entries_.find(key);
+            if (it == entries_.end() || !(it->second.stamp == stamp))
+            {
+                return nullptr;
+            }
+            entry = it->second;
+        }
+
+        // Stat the includes outside the lock, other lookups need not wait for the disk
+        for (const auto &dependency : *entry.dependencies)
+        {
+            try
+            {
+                if (!(StampOf(dependency.first) == dependency.second))
+                {
+                    return nullptr;
+                }
+            }
+            catch (const std::exception &)
+            {
+                return nullptr;
+            }
+        }
+        return entry.module;
+    }
+
+    void ModuleCache::Store(const std::string &path, const std::string &options, const Stamp &stamp,
+                            Module module, Dependencies dependencies)
+    {
+        auto shared = std::make_shared<const Dependencies>(std::move(dependencies));
+        std::string key = KeyOf(path, options);
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_[std::move(key)] = Entry{stamp, std::move(module), std::move(shared)};
+    }
+
+    size_t ModuleCache::size() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return entries_.size();
+    }
+
+    void ModuleCache::clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_.clear();
+    }
+
+} // namespace cforge
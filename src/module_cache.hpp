@@ -0,0 +1,80 @@
+#pragma once
+
+#include "types.hpp"
+
+// std
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace cforge
+{
+    /**
+     * @brief Assembled modules kept in memory across driver runs.
+     * Entries are keyed by path and by the assembler options that shape the
+     * IR (see `Driver`), and remember the size and modification time
+     * of the file they were assembled from and of every file it includes,
+     * a change to any of them misses the cache.
+     * Safe to use from several threads at once.
+     */
+    class ModuleCache
+    {
+    public:
+        using Module = std::shared_ptr<const IR>;
+
+        // Identifies one version of a file
+        struct Stamp
+        {
+            std::filesystem::file_time_type modified{};
+            uintmax_t size = 0;
+
+            bool operator==(const Stamp &other) const
+            {
+                return modified == other.modified && size == other.size;
+            }
+        };
+
+        // Included files a module was assembled from, with their versions at the time
+        using Dependencies = std::vector<std::pair<std::string, Stamp>>;
+
+        /**
+         * Stamps the file at `path` as it is now. Take the stamp before reading
+         * the file, so a concurrent edit is picked up by the next lookup.
+         * @throws Error if the file does not exist.
+         */
+        static Stamp StampOf(const std::filesystem::path &path);
+
+        /**
+         * Module assembled from `path` with `options` at version `stamp` and
+         * unchanged dependencies, or null. `options` is opaque to the cache,
+         * modules assembled with different options never match.
+         */
+        Module Find(const std::string &path, const std::string &options, const Stamp &stamp) const;
+
+        void Store(const std::string &path, const std::string &options, const Stamp &stamp,
+                   Module module, Dependencies dependencies = {});
+
+        size_t size() const;
+        void clear();
+
+    private:
+        struct Entry
+        {
+            Stamp stamp;
+            Module module;
+            std::shared_ptr<const Dependencies> dependencies;
+        };
+
+        // Entry key of `path` assembled with `options`
+        static std::string KeyOf(const std::string &path, const std::string &options);
+
+        mutable std::mutex mutex_;
+        std::unordered_map<std::string, Entry> entries_;
+    };
+
+} // namespace cforge
@@ -0,0 +1,166 @@
+#pragma once
+
+// std
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+
+namespace cforge
+{
+
+	/**
+	 * @brief Hash keyed on the length and a few characters of `key`: the first
+	 * two, the middle and the last two. Cheap enough to inline into every lookup,
+	 * table construction fails at compile time if two keys share a signature.
+	 */
+	constexpr uint32_t PerfectHash(std::string_view key, uint32_t seed)
+	{
+		uint32_t h = (seed * 0x9E3779B1u) ^ static_cast<uint32_t>(key.size());
+		if (!key.empty())
+		{
+			const size_t last = key.size() - 1;
+			const unsigned char chars[5] = {
+				static_cast<unsigned char>(key[0]),
+				static_cast<unsigned char>(key[last > 0 ? 1 : 0]),
+				static_cast<unsigned char>(key[key.size() / 2]),
+				static_cast<unsigned char>(key[last > 0 ? last - 1 : 0]),
+				static_cast<unsigned char>(key[last]),
+			};
+			for (unsigned char c : chars)
+			{
+				h = (h ^ c) * 0x01000193u;
+			}
+		}
+		h ^= h >> 16;
+		h *= 0x85EBCA6Bu;
+		h ^= h >> 13;
+		return h;
+	}
+
+	template <typename Value>
+	struct PerfectHashEntry
+	{
+		std::string_view key;
+		Value value;
+	};
+
+	/**
+	 * @brief Minimal perfect hash table built entirely at compile time.
+	 * Keys are first split into buckets, then every bucket (largest first) gets
+	 * the first seed that places all of its keys into free slots, so the N keys
+	 * occupy exactly N slots. A lookup is two hashes, one seed load and a single
+	 * key comparison, with no heap use and no static initialisation.
+	 */
+	template <typename Value, size_t N>
+	class PerfectHashTable
+	{
+	public:
+		static constexpr size_t kBuckets = N / 2 + 1;
+
+		constexpr PerfectHashTable(const PerfectHashEntry<Value> (&entries)[N])
+			: seeds_{}, slots_{}
+		{
+			Build(entries);
+		}
+
+		/**
+		 * @return The value stored for `key`, or `missing` if there is none.
+		 */
+		constexpr Value Find(std::string_view key, Value missing) const
+		{
+			uint32_t seed = seeds_[PerfectHash(key, 0) % kBuckets];
+			const PerfectHashEntry<Value> &entry = slots_[PerfectHash(key, seed) % N];
+			return entry.key == key ? entry.value : missing;
+		}
+
+		constexpr size_t size() const { return N; }
+
+	private:
+		constexpr void Build(const PerfectHashEntry<Value> (&entries)[N])
+		{
+			std::array<size_t, N> bucket_of{};
+			std::array<size_t, kBuckets> bucket_size{};
+			for (size_t i = 0; i < N; ++i)
+			{
+				bucket_of[i] = PerfectHash(entries[i].key, 0) % kBuckets;
+				++bucket_size[bucket_of[i]];
+			}
+
+			std::array<bool, N> used{};
+			std::array<bool, kBuckets> done{};
+			for (size_t round = 0; round < kBuckets; ++round)
+			{
+				// Place the largest remaining bucket first
+				size_t bucket = kBuckets;
+				for (size_t b = 0; b < kBuckets; ++b)
+				{
+					if (!done[b] && (bucket == kBuckets || bucket_size[b] > bucket_size[bucket]))
+					{
+						bucket = b;
+					}
+				}
+				done[bucket] = true;
+				if (bucket_size[bucket] == 0)
+				{
+					continue;
+				}
+
+				for (uint32_t seed = 1;; ++seed)
+				{
+					if (seed > 0xFFFF)
+					{
+						throw std::logic_error("No perfect hash seed found, keys share a hash signature");
+					}
+
+					std::array<size_t, N> members{};
+					std::array<size_t, N> member_slots{};
+					size_t count = 0;
+					bool fits = true;
+					for (size_t i = 0; i < N && fits; ++i)
+					{
+						if (bucket_of[i] != bucket)
+						{
+							continue;
+						}
+						size_t slot = PerfectHash(entries[i].key, seed) % N;
+						fits = !used[slot];
+						for (size_t k = 0; k < count && fits; ++k)
+						{
+							fits = member_slots[k] != slot;
+						}
+						members[count] = i;
+						member_slots[count] = slot;
+						++count;
+					}
+					if (!fits)
+					{
+						continue;
+					}
+
+					for (size_t k = 0; k < count; ++k)
+					{
+						used[member_slots[k]] = true;
+						slots_[member_slots[k]] = entries[members[k]];
+					}
+					seeds_[bucket] = static_cast<uint16_t>(seed);
+					break;
+				}
+			}
+		}
+
+		std::array<uint16_t, kBuckets> seeds_;
+		std::array<PerfectHashEntry<Value>, N> slots_;
+	};
+
+	/**
+	 * @brief Builds a `PerfectHashTable` from a braced list of entries, deducing N.
+	 */
+	template <typename Value, size_t N>
+	constexpr PerfectHashTable<Value, N> MakePerfectHashTable(const PerfectHashEntry<Value> (&entries)[N])
+	{
+		return PerfectHashTable<Value, N>(entries);
+	}
+
+} // cforge
@@ -0,0 +1,508 @@
+#include "server.hpp"
+
+// std
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <sstream>
+#include <thread>
+
+#if !defined(_WIN32)
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace cforge
+{
+#if defined(_WIN32)
+    Server::Server(const std::string &socket_path, size_t jobs)
+        : socket_path_(socket_path), pool_(1)
+    {
+        throw Error("Server mode requires Unix domain sockets, which this platform lacks");
+    }
+
+    Server::~Server() = default;
+    void Server::Run() {}
+    void Server::Stop() {}
+    void Server::Serve(int) {}
+
+    int Server::Execute(const std::string &, const std::vector<std::string> &, std::ostream &, std::ostream &err)
+    {
+        err << "Server mode is not supported on this platform" << std::endl;
+        return 1;
+    }
+
+    std::string Server::DefaultSocketPath()
+    {
+        return {};
+    }
+
+    int SendRequest(const std::string &, const std::string &, const std::vector<std::string> &,
+                    std::ostream &, std::ostream &)
+    {
+        throw Error("Server mode requires Unix domain sockets, which this platform lacks");
+    }
+#else
+    namespace
+    {
+        // Requests larger than this are rejected instead of buffered
+        constexpr uint32_t kMaxMessageSize = 64u << 20;
+
+        // Write end of the self-pipe of the running server, for the signal handler
+        std::atomic<int> g_wake_fd{-1};
+
+        void OnSignal(int)
+        {
+            int fd = g_wake_fd.load();
+            if (fd >= 0)
+            {
+                char byte = 1;
+                (void)!write(fd, &byte, 1);
+            }
+        }
+
+        class FileDescriptor
+        {
+        public:
+            explicit FileDescriptor(int fd) : fd_(fd) {}
+            ~FileDescriptor()
+            {
+                if (fd_ >= 0)
+                {
+                    close(fd_);
+                }
+            }
+            FileDescriptor(const FileDescriptor &) = delete;
+            FileDescriptor &operator=(const FileDescriptor &) = delete;
+
+            int get() const { return fd_; }
+
+        private:
+            int fd_;
+        };
+
+        sockaddr_un SocketAddress(const std::string &path)
+        {
+            sockaddr_un address{};
+            address.sun_family = AF_UNIX;
+            if (path.size() >= sizeof(address.sun_path))
+            {
+                throw Error("Socket path is too long: " + path);
+            }
+            std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+            return address;
+        }
+
+        // Default socket directory when there is no $XDG_RUNTIME_DIR
+        std::string FallbackSocketDirectory()
+        {
+            return "/tmp/cforge-" + std::to_string(getuid());
+        }
+
+        /**
+         * Creates the fallback directory, or checks the existing one is ours and
+         * closed to everybody else: /tmp is shared, another user could have made it first.
+         */
+        void PreparePrivateDirectory(const std::string &directory)
+        {
+            if (mkdir(directory.c_str(), 0700) != 0 && errno != EEXIST)
+            {
+                throw Error("Failed to create socket directory " + directory + ": " + std::strerror(errno));
+            }
+            struct stat info;
+            if (lstat(directory.c_str(), &info) != 0 || !S_ISDIR(info.st_mode) ||
+                info.st_uid != getuid() || (info.st_mode & 077) != 0)
+            {
+                throw Error("Socket directory is not private to the current user: " + directory);
+            }
+        }
+
+        // True if the process at the other end of `fd` runs as the current user
+        bool PeerIsCurrentUser(int fd)
+        {
+#if defined(SO_PEERCRED)
+            ucred credentials{};
+            socklen_t size = sizeof(credentials);
+            return getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &size) == 0 &&
+                   credentials.uid == getuid();
+#else
+            uid_t uid;
+            gid_t gid;
+            return getpeereid(fd, &uid, &gid) == 0 && uid == getuid();
+#endif
+        }
+
+        // Connected socket to `path`, or -1
+        int Connect(const std::string &path)
+        {
+            sockaddr_un address = SocketAddress(path);
+            int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if (fd < 0)
+            {
+                return -1;
+            }
+            if (connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0)
+            {
+                close(fd);
+                return -1;
+            }
+            return fd;
+        }
+
+        void WriteAll(int fd, const void *data, size_t size)
+        {
+            const char *bytes = static_cast<const char *>(data);
+            while (size > 0)
+            {
+                ssize_t written = send(fd, bytes, size, MSG_NOSIGNAL);
+                if (written < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (written <= 0)
+                {
+                    throw Error("Failed to write to socket");
+                }
+                bytes += written;
+                size -= static_cast<size_t>(written);
+            }
+        }
+
+        void ReadAll(int fd, void *data, size_t size)
+        {
+            char *bytes = static_cast<char *>(data);
+            while (size > 0)
+            {
+                ssize_t count = recv(fd, bytes, size, 0);
+                if (count < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (count <= 0)
+                {
+                    throw Error("Connection closed unexpectedly");
+                }
+                bytes += count;
+                size -= static_cast<size_t>(count);
+            }
+        }
+
+        void AppendU32(std::string &message, uint32_t value)
+        {
+            message.append(reinterpret_cast<const char *>(&value), sizeof(value));
+        }
+
+        void AppendString(std::string &message, const std::string &value)
+        {
+            AppendU32(message, static_cast<uint32_t>(value.size()));
+            message += value;
+        }
+
+        uint32_t ReadU32(int fd)
+        {
+            uint32_t value;
+            ReadAll(fd, &value, sizeof(value));
+            return value;
+        }
+
+        std::string ReadString(int fd)
+        {
+            uint32_t size = ReadU32(fd);
+            if (size > kMaxMessageSize)
+            {
+                throw Error("Message exceeds the size limit");
+            }
+            std::string value(size, '\0');
+            ReadAll(fd, value.data(), size);
+            return value;
+        }
+    }
+
+    std::string Server::DefaultSocketPath()
+    {
+        if (const char *path = std::getenv("CFORGE_SOCKET"))
+        {
+            if (*path != '\0')
+            {
+                return path;
+            }
+        }
+        if (const char *runtime = std::getenv("XDG_RUNTIME_DIR"))
+        {
+            if (*runtime != '\0')
+            {
+                return std::string(runtime) + "/cforge.sock";
+            }
+        }
+        return FallbackSocketDirectory() + "/cforge.sock";
+    }
+
+    Server::Server(const std::string &socket_path, size_t jobs)
+        : socket_path_(socket_path), pool_(jobs)
+    {
+        if (std::filesystem::path(socket_path_).parent_path() == FallbackSocketDirectory())
+        {
+            PreparePrivateDirectory(FallbackSocketDirectory());
+        }
+
+        // A socket nobody answers on was left behind by a crashed server
+        int existing = Connect(socket_path_);
+        if (existing >= 0)
+        {
+            close(existing);
+            throw Error("A server is already listening on " + socket_path_);
+        }
+        unlink(socket_path_.c_str());
+
+        sockaddr_un address = SocketAddress(socket_path_);
+        listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listen_fd_ < 0 ||
+            bind(listen_fd_, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+            chmod(socket_path_.c_str(), 0600) != 0 ||
+            listen(listen_fd_, SOMAXCONN) != 0 ||
+            pipe(wake_fds_) != 0)
+        {
+            int error = errno;
+            if (listen_fd_ >= 0)
+            {
+                close(listen_fd_);
+            }
+            throw Error("Failed to listen on " + socket_path_ + ": " + std::strerror(error));
+        }
+    }
+
+    Server::~Server()
+    {
+        close(listen_fd_);
+        close(wake_fds_[0]);
+        close(wake_fds_[1]);
+        unlink(socket_path_.c_str());
+    }
+
+    void Server::Stop()
+    {
+        char byte = 1;
+        (void)!write(wake_fds_[1], &byte, 1);
+    }
+
+    void Server::Run()
+    {
+        g_wake_fd = wake_fds_[1];
+        struct sigaction action{};
+        action.sa_handler = OnSignal;
+        sigemptyset(&action.sa_mask);
+        struct sigaction old_int, old_term;
+        sigaction(SIGINT, &action, &old_int);
+        sigaction(SIGTERM, &action, &old_term);
+
+        pollfd fds[2] = {{listen_fd_, POLLIN, 0}, {wake_fds_[0], POLLIN, 0}};
+        while (true)
+        {
+            if (poll(fds, 2, -1) < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                break;
+            }
+            if (fds[1].revents != 0)
+            {
+                break;
+            }
+            if ((fds[0].revents & POLLIN) == 0)
+            {
+                continue;
+            }
+
+            int connection = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+            if (connection < 0)
+            {
+                continue;
+            }
+            // Requests run as the server's user, nobody else may make them
+            if (!PeerIsCurrentUser(connection))
+            {
+                close(connection);
+                continue;
+            }
+            {
+                std::lock_guard<std::mutex> lock(connections_mutex_);
+                ++connections_;
+            }
+            std::thread([this, connection]()
+                        { Serve(connection); })
+                .detach();
+        }
+
+        sigaction(SIGINT, &old_int, nullptr);
+        sigaction(SIGTERM, &old_term, nullptr);
+        g_wake_fd = -1;
+
+        // Drain the wake-up bytes, so the server could run again
+        char buffer[64];
+        while (poll(&fds[1], 1, 0) > 0 && read(wake_fds_[0], buffer, sizeof(buffer)) > 0)
+        {
+        }
+
+        std::unique_lock<std::mutex> lock(connections_mutex_);
+        connections_done_.wait(lock, [this]()
+                               { return connections_ == 0; });
+    }
+
+    void Server::Serve(int connection)
+    {
+        FileDescriptor socket(connection);
+        try
+        {
+            uint32_t count = ReadU32(socket.get());
+            if (count == 0 || count > kMaxMessageSize)
+            {
+                throw Error("Malformed request");
+            }
+            std::string cwd = ReadString(socket.get());
+            std::vector<std::string> args(count - 1);
+            for (std::string &arg : args)
+            {
+                arg = ReadString(socket.get());
+            }
+
+            std::ostringstream out;
+            std::ostringstream err;
+            int exit_code = Execute(cwd, args, out, err);
+
+            std::string response;
+            AppendU32(response, static_cast<uint32_t>(exit_code));
+            AppendString(response, out.str());
+            AppendString(response, err.str());
+            WriteAll(socket.get(), response.data(), response.size());
+        }
+        catch (const std::exception &)
+        {
+            // The client went away or spoke garbage, nothing to answer
+        }
+
+        std::lock_guard<std::mutex> lock(connections_mutex_);
+        if (--connections_ == 0)
+        {
+            connections_done_.notify_all();
+        }
+    }
+
+    int Server::Execute(const std::string &cwd, const std::vector<std::string> &args,
+                        std::ostream &out, std::ostream &err)
+    {
+        CommandLine command;
+        try
+        {
+            command = ParseCommandLine(args);
+        }
+        catch (const std::exception &e)
+        {
+            err << e.what() << std::endl;
+            return 1;
+        }
+
+        if (command.help)
+        {
+            PrintUsage(out);
+            return 0;
+        }
+        if (command.server)
+        {
+            err << Error("The server cannot start another server").what() << std::endl;
+            return 1;
+        }
+        if (command.watch)
+        {
+            err << Error("--watch is not available through the server, run CForge directly").what() << std::endl;
+            return 1;
+        }
+        if (command.options.verbose)
+        {
+            // The dumps go to the server's own stdout and would interleave
+            err << Error("--verbose is not available through the server, run CForge directly").what() << std::endl;
+            return 1;
+        }
+        if (command.inputs.empty())
+        {
+            PrintUsage(out);
+            return 1;
+        }
+
+        // Cache entries are keyed by absolute path, independent of the client's directory
+        std::vector<std::string> inputs;
+        inputs.reserve(command.inputs.size());
+        for (const std::string &input : command.inputs)
+        {
+            inputs.push_back((std::filesystem::path(cwd) / input).lexically_normal().string());
+        }
+        if (!command.options.cache_directory.empty())
+        {
+            command.options.cache_directory = (std::filesystem::path(cwd) / command.options.cache_directory).string();
+        }
+        for (std::string &directory : command.options.include_directories)
+        {
+            directory = (std::filesystem::path(cwd) / directory).lexically_normal().string();
+        }
+
+        try
+        {
+            Driver driver(command.options, pool_, &cache_);
+            if (!command.archive_output.empty())
+            {
+                std::string output = (std::filesystem::path(cwd) / command.archive_output).lexically_normal().string();
+                return RunArchive(driver, inputs, output, out, err);
+            }
+            std::string output;
+            if (!command.output.empty())
+            {
+                output = (std::filesystem::path(cwd) / command.output).lexically_normal().string();
+            }
+            return RunCommand(driver, inputs, output, out, err);
+        }
+        catch (const std::exception &e)
+        {
+            err << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    int SendRequest(const std::string &socket_path, const std::string &cwd,
+                    const std::vector<std::string> &args,
+                    std::ostream &out, std::ostream &err)
+    {
+        FileDescriptor socket(Connect(socket_path));
+        if (socket.get() < 0)
+        {
+            throw Error("No CForge server is listening on " + socket_path + " (start one with CForge --server)");
+        }
+        // The request carries our arguments and we trust the answer, so only talk to our own server
+        if (!PeerIsCurrentUser(socket.get()))
+        {
+            throw Error("The server on " + socket_path + " belongs to another user");
+        }
+
+        std::string request;
+        AppendU32(request, static_cast<uint32_t>(args.size() + 1));
+        AppendString(request, cwd);
+        for (const std::string &arg : args)
+        {
+            AppendString(request, arg);
+        }
+        WriteAll(socket.get(), request.data(), request.size());
+
+        int exit_code = static_cast<int>(ReadU32(socket.get()));
+        out << ReadString(socket.get());
+        err << ReadString(socket.get());
+        return exit_code;
+    }
+#endif
+
+} // namespace cforge
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "cli.hpp"
+#include "module_cache.hpp"
+#include "thread_pool.hpp"
+
+// std
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace cforge
+{
+    /**
+     * @brief Resident assembler serving `CForge` command lines over a Unix socket.
+     * The thread pool and the module cache outlive single requests, so a
+     * request for unchanged files skips lexing and parsing entirely and only
+     * relinks. Every connection carries one request and is served on its own
+     * thread, the heavy lifting runs on the shared pool.
+     *
+     * Wire format, host byte order (both ends live on the same machine):
+     * - request:  u32 count, then `count` strings: working directory, arguments...
+     * - response: i32 exit code, stdout string, stderr string
+     * where every string is a u32 length followed by its bytes.
+     */
+    class Server
+    {
+    public:
+        /**
+         * Binds `socket_path`, replacing a stale socket left by a crashed server.
+         * @throws Error if the socket cannot be bound or another server is already listening.
+         */
+        Server(const std::string &socket_path, size_t jobs);
+        ~Server();
+
+        Server(const Server &) = delete;
+        Server &operator=(const Server &) = delete;
+
+        /**
+         * Serves requests until `Stop` is called or the process receives
+         * SIGINT/SIGTERM, then waits for the requests in flight.
+         */
+        void Run();
+
+        // Makes `Run` return, may be called from any thread
+        void Stop();
+
+        /**
+         * Runs one command line as if `CForge` had been started in `cwd`.
+         * @return The exit code, output and diagnostics go to `out` and `err`.
+         */
+        int Execute(const std::string &cwd, const std::vector<std::string> &args,
+                    std::ostream &out, std::ostream &err);
+
+        const std::string &socket_path() const { return socket_path_; }
+        const ModuleCache &cache() const { return cache_; }
+
+        // $CFORGE_SOCKET, else a socket in $XDG_RUNTIME_DIR, else one in a private per-user directory in /tmp
+        static std::string DefaultSocketPath();
+
+    private:
+        void Serve(int connection);
+
+        std::string socket_path_;
+        int listen_fd_ = -1;
+        int wake_fds_[2] = {-1, -1}; // Self-pipe, written to stop `Run`
+
+        ThreadPool pool_;
+        ModuleCache cache_;
+
+        // Connections being served, `Run` drains them before returning
+        std::mutex connections_mutex_;
+        std::condition_variable connections_done_;
+        size_t connections_ = 0;
+    };
+
+    /**
+     * Forwards a command line to the server at `socket_path` and copies its
+     * output to `out` and `err`.
+     * @return The exit code of the command.
+     * @throws Error if the server cannot be reached.
+     */
+    int SendRequest(const std::string &socket_path, const std::string &cwd,
+                    const std::vector<std::string> &args,
+                    std::ostream &out, std::ostream &err);
+
+} // namespace cforge
@@ -0,0 +1,255 @@
+#pragma once
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <array>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define CFORGE_SIMD_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CFORGE_SIMD_SSE2 1
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace cforge::simd
+{
+    /**
+     * @brief Character classes recognised by the lexer.
+     * @note A character may belong to several classes, e.g. 'b' is both
+     * an identifier and a number character.
+     */
+    enum CharClass : uint8_t
+    {
+        kBlank = 1 << 0,   // ' ', '\t'
+        kNewline = 1 << 1, // '\n'
+        kComma = 1 << 2,   // ','
+        kComment = 1 << 3, // '#'
+        kDigit = 1 << 4,   // [0-9]
+        kIdent = 1 << 5,   // [0-9A-Za-z_]
+        kNumber = 1 << 6,  // [0-9a-fA-FxX] (covers the 'b'/'B' prefix)
+        kAlpha = 1 << 7,   // [A-Za-z_], may start an identifier
+    };
+
+    constexpr std::array<uint8_t, 256> MakeCharClassTable()
+    {
+        std::array<uint8_t, 256> table{};
+        table[' '] |= kBlank;
+        table['\t'] |= kBlank;
+        table['\n'] |= kNewline;
+        table[','] |= kComma;
+        table['#'] |= kComment;
+        table['_'] |= kIdent | kAlpha;
+        for (int c = '0'; c <= '9'; ++c)
+            table[c] |= kDigit | kIdent | kNumber;
+        for (int c = 'a'; c <= 'z'; ++c)
+            table[c] |= kIdent | kAlpha;
+        for (int c = 'A'; c <= 'Z'; ++c)
+            table[c] |= kIdent | kAlpha;
+        for (int c = 'a'; c <= 'f'; ++c)
+            table[c] |= kNumber;
+        for (int c = 'A'; c <= 'F'; ++c)
+            table[c] |= kNumber;
+        table['x'] |= kNumber;
+        table['X'] |= kNumber;
+        return table;
+    }
+
+    inline constexpr std::array<uint8_t, 256> kCharClass = MakeCharClassTable();
+
+    inline uint8_t ClassOf(char c)
+    {
+        return kCharClass[static_cast<unsigned char>(c)];
+    }
+
+    /**
+     * @brief Returns true if the vectorized scanners are compiled in.
+     */
+    constexpr bool IsVectorized()
+    {
+#if defined(CFORGE_SIMD_AVX2) || defined(CFORGE_SIMD_SSE2)
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    constexpr const char *InstructionSetName()
+    {
+#if defined(CFORGE_SIMD_AVX2)
+        return "AVX2";
+#elif defined(CFORGE_SIMD_SSE2)
+        return "SSE2";
+#else
+        return "scalar";
+#endif
+    }
+
+    inline unsigned CountTrailingZeros(uint32_t mask)
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return static_cast<unsigned>(index);
+#else
+        return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+    }
+
+    namespace detail
+    {
+        // Scalar tail / fallback: advance while the class bit is set
+        inline size_t SkipClassScalar(const char *src, size_t pos, size_t end, uint8_t cls)
+        {
+            while (pos < end && (ClassOf(src[pos]) & cls))
+            {
+                ++pos;
+            }
+            return pos;
+        }
+
+#if defined(CFORGE_SIMD_AVX2)
+        using Vec = __m256i;
+        constexpr size_t kWidth = 32;
+
+        inline Vec Load(const char *p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)); }
+        inline Vec Splat(char c) { return _mm256_set1_epi8(c); }
+        inline Vec Eq(Vec a, Vec b) { return _mm256_cmpeq_epi8(a, b); }
+        inline Vec Or(Vec a, Vec b) { return _mm256_or_si256(a, b); }
+        inline Vec And(Vec a, Vec b) { return _mm256_and_si256(a, b); }
+        inline Vec Gt(Vec a, Vec b) { return _mm256_cmpgt_epi8(a, b); }
+        inline uint32_t Mask(Vec v) { return static_cast<uint32_t>(_mm256_movemask_epi8(v)); }
+        constexpr uint32_t kFullMask = 0xFFFFFFFFu;
+#elif defined(CFORGE_SIMD_SSE2)
+        using Vec = __m128i;
+        constexpr size_t kWidth = 16;
+
+        inline Vec Load(const char *p) { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)); }
+        inline Vec Splat(char c) { return _mm_set1_epi8(c); }
+        inline Vec Eq(Vec a, Vec b) { return _mm_cmpeq_epi8(a, b); }
+        inline Vec Or(Vec a, Vec b) { return _mm_or_si128(a, b); }
+        inline Vec And(Vec a, Vec b) { return _mm_and_si128(a, b); }
+        inline Vec Gt(Vec a, Vec b) { return _mm_cmpgt_epi8(a, b); }
+        inline uint32_t Mask(Vec v) { return static_cast<uint32_t>(_mm_movemask_epi8(v)); }
+        constexpr uint32_t kFullMask = 0xFFFFu;
+#endif
+
+#if defined(CFORGE_SIMD_AVX2) || defined(CFORGE_SIMD_SSE2)
+        // Lanes with lo <= c <= hi. Only valid for ASCII bounds, bytes >= 0x80
+        // compare as negative and therefore never match.
+        inline Vec InRange(Vec v, char lo, char hi)
+        {
+            return And(Gt(v, Splat(static_cast<char>(lo - 1))),
+                       Gt(Splat(static_cast<char>(hi + 1)), v));
+        }
+
+        inline Vec BlankLanes(Vec v)
+        {
+            return Or(Eq(v, Splat(' ')), Eq(v, Splat('\t')));
+        }
+
+        inline Vec NewlineLanes(Vec v)
+        {
+            return Eq(v, Splat('\n'));
+        }
+
+        inline Vec IdentLanes(Vec v)
+        {
+            // Folding to lower case maps [A-Z] onto [a-z] and keeps digits in place
+            Vec lower = Or(v, Splat(0x20));
+            return Or(Or(InRange(lower, 'a', 'z'), InRange(v, '0', '9')),
+                      Eq(v, Splat('_')));
+        }
+
+        inline Vec NumberLanes(Vec v)
+        {
+            Vec lower = Or(v, Splat(0x20));
+            return Or(Or(InRange(lower, 'a', 'f'), InRange(v, '0', '9')),
+                      Eq(lower, Splat('x')));
+        }
+
+        // Advances while `lanes` classifies a byte as part of the run
+        template <typename Classifier>
+        inline size_t SkipRun(const char *src, size_t pos, size_t end, Classifier &&lanes, uint8_t cls)
+        {
+            while (pos + kWidth <= end)
+            {
+                uint32_t stop = ~Mask(lanes(Load(src + pos))) & kFullMask;
+                if (stop != 0)
+                {
+                    return pos + CountTrailingZeros(stop);
+                }
+                pos += kWidth;
+            }
+            return SkipClassScalar(src, pos, end, cls);
+        }
+#endif
+    }
+
+    /**
+     * @brief Returns the position of the first character at or after `pos`
+     * that is not a space or tab.
+     */
+    inline size_t SkipBlanks(const char *src, size_t pos, size_t end)
+    {
+#if defined(CFORGE_SIMD_AVX2) || defined(CFORGE_SIMD_SSE2)
+        return detail::SkipRun(src, pos, end, detail::BlankLanes, kBlank);
+#else
+        return detail::SkipClassScalar(src, pos, end, kBlank);
+#endif
+    }
+
+    /**
+     * @brief Returns the position of the next '\n' at or after `pos`, or `end`.
+     */
+    inline size_t FindNewline(const char *src, size_t pos, size_t end)
+    {
+#if defined(CFORGE_SIMD_AVX2) || defined(CFORGE_SIMD_SSE2)
+        while (pos + detail::kWidth <= end)
+        {
+            uint32_t hit = detail::Mask(detail::NewlineLanes(detail::Load(src + pos)));
+            if (hit != 0)
+            {
+                return pos + CountTrailingZeros(hit);
+            }
+            pos += detail::kWidth;
+        }
+#endif
+        while (pos < end && src[pos] != '\n')
+        {
+            ++pos;
+        }
+        return pos;
+    }
+
+    /**
+     * @brief Returns the end of the run of [0-9A-Za-z_] starting at `pos`.
+     */
+    inline size_t SkipIdentifier(const char *src, size_t pos, size_t end)
+    {
+#if defined(CFORGE_SIMD_AVX2) || defined(CFORGE_SIMD_SSE2)
+        return detail::SkipRun(src, pos, end, detail::IdentLanes, kIdent);
+#else
+        return detail::SkipClassScalar(src, pos, end, kIdent);
+#endif
+    }
+
+    /**
+     * @brief Returns the end of the run of number characters starting at `pos`.
+     * @note Accepts the same set as `Lexer::LexNumber`: digits, hex digits and the x/b prefixes.
+     */
+    inline size_t SkipNumber(const char *src, size_t pos, size_t end)
+    {
+#if defined(CFORGE_SIMD_AVX2) || defined(CFORGE_SIMD_SSE2)
+        return detail::SkipRun(src, pos, end, detail::NumberLanes, kNumber);
+#else
+        return detail::SkipClassScalar(src, pos, end, kNumber);
+#endif
+    }
+
+} // namespace cforge::simd
@@ -0,0 +1,46 @@
+#pragma once
+
+// std
+#include <array>
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+namespace cforge
+{
+
+	/**
+	 * @brief Non-owning view of a contiguous, read-only array (a minimal C++17 `std::span`).
+	 */
+	template <typename T>
+	class Span
+	{
+	public:
+		constexpr Span() = default;
+		constexpr Span(const T *data, size_t size) : data_(data), size_(size) {}
+
+		template <size_t N>
+		constexpr Span(const std::array<T, N> &array) : data_(array.data()), size_(N) {}
+
+		Span(const std::vector<T> &vector) : data_(vector.data()), size_(vector.size()) {}
+
+		constexpr const T *data() const { return data_; }
+		constexpr size_t size() const { return size_; }
+		constexpr bool empty() const { return size_ == 0; }
+
+		constexpr const T &operator[](size_t i) const { return data_[i]; }
+		constexpr const T *begin() const { return data_; }
+		constexpr const T *end() const { return data_ + size_; }
+
+	private:
+		const T *data_ = nullptr;
+		size_t size_ = 0;
+	};
+
+	/**
+	 * @brief Operands of an instruction or arguments of a directive.
+	 * The views point into the source text.
+	 */
+	using OperandList = Span<std::string_view>;
+
+} // cforge
@@ -0,0 +1,99 @@
+#include "string_interner.hpp"
+#include "hash.hpp"
+
+namespace cforge
+{
+    StringInterner::StringInterner(const StringInterner &other)
+    {
+        *this = other;
+    }
+
+    StringInterner &StringInterner::operator=(const StringInterner &other)
+    {
+        if (this != &other)
+        {
+            clear();
+            // Re-interning in ID order reproduces the same IDs
+            for (std::string_view name : other.names_)
+            {
+                Intern(name);
+            }
+        }
+        return *this;
+    }
+
+    void StringInterner::clear()
+    {
+        arena_.Reset();
+        names_.clear();
+        hashes_.clear();
+        slots_.clear();
+    }
+
+    size_t StringInterner::FindSlot(std::string_view name, uint32_t hash) const
+    {
+        // Linear probing, the table is a power of two and at most half full
+        size_t mask = slots_.size() - 1;
+        size_t slot = hash & mask;
+        while (slots_[slot] != 0)
+        {
+            SymbolId id = slots_[slot] - 1;
+            if (hashes_[id] == hash && names_[id] == name)
+            {
+                break;
+            }
+            slot = (slot + 1) & mask;
+        }
+        return slot;
+    }
+
+    SymbolId StringInterner::Find(std::string_view name) const
+    {
+        if (slots_.empty())
+        {
+            return kInvalidSymbol;
+        }
+        uint32_t hash = static_cast<uint32_t>(HashBytes(name));
+        size_t slot = FindSlot(name, hash);
+        return slots_[slot] != 0 ? slots_[slot] - 1 : kInvalidSymbol;
+    }
+
+    SymbolId StringInterner::Intern(std::string_view name)
+    {
+        if ((names_.size() + 1) * 2 > slots_.size())
+        {
+            Grow();
+        }
+
+        uint32_t hash = static_cast<uint32_t>(HashBytes(name));
+        size_t slot = FindSlot(name, hash);
+        if (slots_[slot] != 0)
+        {
+            return slots_[slot] - 1;
+        }
+
+        SymbolId id = static_cast<SymbolId>(names_.size());
+        names_.push_back(arena_.CopyString(name));
+        hashes_.push_back(hash);
+        slots_[slot] = id + 1;
+        return id;
+    }
+
+    void StringInterner::Grow()
+    {
+        size_t capacity = slots_.empty() ? 64 : slots_.size() * 2;
+        slots_.assign(capacity, 0);
+
+        size_t mask = capacity - 1;
+        for (SymbolId id = 0; id < names_.size(); ++id)
+        {
+            size_t slot = hashes_[id] & mask;
+            while (slots_[slot] != 0)
+            {
+                slot = (slot + 1) & mask;
+            }
+            slots_[slot] = id + 1;
+        }
+    }
+
+} // namespace cforge
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "arena.hpp"
+
+// std
+#include <cstdint>
+#include <limits>
+#include <string_view>
+#include <vector>
+
+namespace cforge
+{
+	/**
+	 * @brief Dense identifier of an interned name.
+	 * IDs are assigned in first-seen order starting at 0, so per-symbol data
+	 * can be stored in plain vectors indexed by ID.
+	 */
+	using SymbolId = uint32_t;
+
+	constexpr SymbolId kInvalidSymbol = std::numeric_limits<SymbolId>::max();
+
+	/**
+	 * @brief Arena-backed string table mapping names to dense `SymbolId`s.
+	 * Every distinct name is copied exactly once; looking up a name that is
+	 * already known hashes it but never allocates.
+	 */
+	class StringInterner
+	{
+	public:
+		StringInterner() = default;
+		StringInterner(const StringInterner &other);
+		StringInterner &operator=(const StringInterner &other);
+		StringInterner(StringInterner &&) = default;
+		StringInterner &operator=(StringInterner &&) = default;
+
+		/**
+		 * Returns the ID of `name`, adding it if it is not yet interned.
+		 */
+		SymbolId Intern(std::string_view name);
+
+		/**
+		 * Returns the ID of `name`, or `kInvalidSymbol` if it was never interned.
+		 */
+		SymbolId Find(std::string_view name) const;
+
+		// Name of an interned ID, valid for the lifetime of the interner
+		std::string_view Get(SymbolId id) const { return names_[id]; }
+
+		size_t size() const { return names_.size(); }
+		bool empty() const { return names_.empty(); }
+
+		void clear();
+
+	private:
+		void Grow();
+		size_t FindSlot(std::string_view name, uint32_t hash) const;
+
+		Arena arena_;
+		std::vector<std::string_view> names_; // ID -> name (points into `arena_`)
+		std::vector<uint32_t> hashes_;		  // ID -> cached hash
+		std::vector<uint32_t> slots_;		  // Open addressing table of ID + 1, 0 = empty
+	};
+
+} // cforge
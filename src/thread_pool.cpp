@@ -0,0 +1,184 @@
+#include "thread_pool.hpp"
+
+namespace cforge
+{
+    namespace
+    {
+        // Pool and worker index of the current thread, null outside of a pool
+        thread_local const ThreadPool *tls_pool = nullptr;
+        thread_local size_t tls_worker = 0;
+    }
+
+    size_t ThreadPool::DefaultThreadCount()
+    {
+        size_t count = std::thread::hardware_concurrency();
+        return count == 0 ? 1 : count;
+    }
+
+    ThreadPool::ThreadPool(size_t threads)
+    {
+        if (threads == 0)
+        {
+            threads = DefaultThreadCount();
+        }
+
+        queues_.reserve(threads);
+        for (size_t i = 0; i < threads; ++i)
+        {
+            queues_.push_back(std::make_unique<Queue>());
+        }
+        workers_.reserve(threads);
+        for (size_t i = 0; i < threads; ++i)
+        {
+            workers_.emplace_back([this, i]()
+                                  { WorkerLoop(i); });
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(state_mutex_);
+            stopping_ = true;
+        }
+        work_available_.notify_all();
+        for (std::thread &worker : workers_)
+        {
+            worker.join();
+        }
+    }
+
+    void ThreadPool::Submit(Task task)
+    {
+        // Nested submissions stay on the worker's own queue
+        size_t index = tls_pool == this
+                           ? tls_worker
+                           : next_queue_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+        {
+            std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+            queues_[index]->tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> lock(state_mutex_);
+            ++queued_;
+            ++pending_;
+        }
+        work_available_.notify_one();
+    }
+
+    void ThreadPool::Wait()
+    {
+        std::unique_lock<std::mutex> lock(state_mutex_);
+        task_finished_.wait(lock, [this]()
+                            { return pending_ == 0; });
+
+        if (first_error_)
+        {
+            std::exception_ptr error = first_error_;
+            first_error_ = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+
+    bool ThreadPool::TryPop(size_t index, Task &task)
+    {
+        Queue &queue = *queues_[index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty())
+        {
+            return false;
+        }
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+        return true;
+    }
+
+    bool ThreadPool::TrySteal(size_t thief, Task &task)
+    {
+        for (size_t i = 1; i < queues_.size(); ++i)
+        {
+            Queue &victim = *queues_[(thief + i) % queues_.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty())
+            {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void ThreadPool::RunClaimedTask(size_t index)
+    {
+        // Claims never exceed the queued tasks, so this finds one
+        Task task;
+        while (!TryPop(index, task) && !TrySteal(index, task))
+        {
+            std::this_thread::yield();
+        }
+
+        try
+        {
+            task();
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(state_mutex_);
+            if (!first_error_)
+            {
+                first_error_ = std::current_exception();
+            }
+        }
+        task = nullptr; // Release captures before `Wait` can return
+
+        {
+            std::lock_guard<std::mutex> lock(state_mutex_);
+            --pending_;
+        }
+        task_finished_.notify_all();
+    }
+
+    void ThreadPool::HelpUntil(const std::function<bool()> &done)
+    {
+        // Only workers help, outside threads leave the work to the pool
+        bool worker = tls_pool == this;
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(state_mutex_);
+                task_finished_.wait(lock, [&]()
+                                    { return (worker && queued_ > 0) || done(); });
+                if (done())
+                {
+                    return;
+                }
+                --queued_;
+            }
+            RunClaimedTask(tls_worker);
+        }
+    }
+
+    void ThreadPool::WorkerLoop(size_t index)
+    {
+        tls_pool = this;
+        tls_worker = index;
+
+        while (true)
+        {
+            {
+                // Claim one of the queued tasks before looking for it
+                std::unique_lock<std::mutex> lock(state_mutex_);
+                work_available_.wait(lock, [this]()
+                                     { return stopping_ || queued_ > 0; });
+                if (queued_ == 0)
+                {
+                    return;
+                }
+                --queued_;
+            }
+            RunClaimedTask(index);
+        }
+    }
+
+} // namespace cforge
@@ -0,0 +1,119 @@
+#pragma once
+
+// std
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cforge
+{
+    /**
+     * @brief Fixed-size work-stealing thread pool.
+     * Every worker owns a task queue: it pops its own work from the back and,
+     * once that runs dry, steals from the front of the other queues. Tasks
+     * submitted from inside a task go to the submitting worker's queue, so
+     * nested work stays local until another worker is idle.
+     */
+    class ThreadPool
+    {
+    public:
+        using Task = std::function<void()>;
+
+        // `threads == 0` uses one worker per hardware thread
+        explicit ThreadPool(size_t threads = 0);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        void Submit(Task task);
+
+        /**
+         * Blocks until every submitted task has finished.
+         * If any task threw, the first exception is rethrown here.
+         */
+        void Wait();
+
+        /**
+         * Runs `body(i)` for every `i` in [0, count) on the pool and waits for
+         * all of them. A worker calling this runs queued tasks while it waits, so
+         * loops may be nested inside tasks. The first exception thrown by
+         * `body` is rethrown once every iteration has finished.
+         */
+        template <typename Body>
+        void ParallelFor(size_t count, Body &&body)
+        {
+            std::atomic<size_t> remaining{count};
+            std::mutex error_mutex;
+            std::exception_ptr error;
+            for (size_t i = 0; i < count; ++i)
+            {
+                Submit([&, i]()
+                       {
+                           try
+                           {
+                               body(i);
+                           }
+                           catch (...)
+                           {
+                               std::lock_guard<std::mutex> lock(error_mutex);
+                               if (!error)
+                               {
+                                   error = std::current_exception();
+                               }
+                           }
+                           remaining.fetch_sub(1, std::memory_order_release); });
+            }
+
+            HelpUntil([&remaining]()
+                      { return remaining.load(std::memory_order_acquire) == 0; });
+            if (error)
+            {
+                std::rethrow_exception(error);
+            }
+        }
+
+        size_t size() const { return workers_.size(); }
+
+        static size_t DefaultThreadCount();
+
+    private:
+        struct Queue
+        {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+
+        void WorkerLoop(size_t index);
+        bool TryPop(size_t index, Task &task);
+        bool TrySteal(size_t thief, Task &task);
+
+        // Takes the task claimed by the caller out of the queues and runs it
+        void RunClaimedTask(size_t index);
+
+        // Blocks until `done()` holds, workers run queued tasks meanwhile
+        void HelpUntil(const std::function<bool()> &done);
+
+        std::vector<std::unique_ptr<Queue>> queues_;
+        std::vector<std::thread> workers_;
+
+        // Tasks submitted but not finished, guards sleeping and `Wait`
+        std::mutex state_mutex_;
+        std::condition_variable work_available_;
+        std::condition_variable task_finished_;
+        size_t queued_ = 0;
+        size_t pending_ = 0;
+        bool stopping_ = false;
+
+        std::atomic<size_t> next_queue_{0};
+        std::exception_ptr first_error_;
+    };
+
+} // namespace cforge
@@ -0,0 +1,165 @@
+#pragma once
+
+#include "error.hpp"
+
+// std
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <string_view>
+#include <vector>
+
+namespace cforge
+{
+    /**
+     * @brief Unpacked view of a single token.
+     * Tokens are stored packed in a `TokenBuffer`, this is what accessors hand out.
+     */
+    struct Token
+    {
+        enum class Type : uint8_t
+        {
+            IDENTIFIER,
+            DIRECTIVE,
+            LABEL,
+            NUMBER,
+            NEWLINE,
+            COMMA,
+            STRING, // Double-quoted, the value excludes the quotes
+        } type;
+
+        std::string_view value;
+    };
+
+    /**
+     * @brief Maps source offsets to 1-based line numbers.
+     * The newline index is only built on the first query, so sources that
+     * never produce a diagnostic never pay for it.
+     */
+    class LineTable
+    {
+    public:
+        void set_source(std::string_view source)
+        {
+            source_ = source;
+            newlines_.clear();
+            built_ = false;
+        }
+
+        // Line containing the character at `offset`
+        size_t LineOf(size_t offset) const
+        {
+            if (!built_)
+            {
+                Build();
+            }
+            auto it = std::lower_bound(newlines_.begin(), newlines_.end(), offset);
+            return static_cast<size_t>(it - newlines_.begin()) + 1;
+        }
+
+    private:
+        void Build() const
+        {
+            newlines_.clear();
+            for (size_t pos = source_.find('\n'); pos != std::string_view::npos;
+                 pos = source_.find('\n', pos + 1))
+            {
+                newlines_.push_back(static_cast<uint32_t>(pos));
+            }
+            built_ = true;
+        }
+
+        std::string_view source_;
+        mutable std::vector<uint32_t> newlines_; // Offsets of every '\n'
+        mutable bool built_ = false;
+    };
+
+    /**
+     * @brief Packed structure-of-arrays token storage.
+     * Each token costs 7 bytes: a 32-bit source offset, a 16-bit length and an
+     * 8-bit type. Values are recovered as views into the source, line numbers
+     * through a lazily built `LineTable`.
+     */
+    class TokenBuffer
+    {
+    public:
+        static constexpr size_t kMaxSourceSize = std::numeric_limits<uint32_t>::max();
+        static constexpr size_t kMaxTokenLength = std::numeric_limits<uint16_t>::max();
+
+        void set_source(std::string_view source)
+        {
+            if (source.size() > kMaxSourceSize)
+            {
+                throw Error("Source exceeds the 4 GiB limit of the token format");
+            }
+            source_ = source;
+            lines_.set_source(source);
+        }
+        std::string_view source() const { return source_; }
+
+        void clear()
+        {
+            offsets_.clear();
+            lengths_.clear();
+            types_.clear();
+        }
+
+        void reserve(size_t count)
+        {
+            offsets_.reserve(count);
+            lengths_.reserve(count);
+            types_.reserve(count);
+        }
+
+        void push_back(Token::Type type, size_t offset, size_t length)
+        {
+            if (length > kMaxTokenLength)
+            {
+                throw Error(source_.substr(offset, 32), LineOf(offset), "Token exceeds 65535 characters");
+            }
+            offsets_.push_back(static_cast<uint32_t>(offset));
+            lengths_.push_back(static_cast<uint16_t>(length));
+            types_.push_back(type);
+        }
+
+        // Appends all tokens of `other`, which must share the same source
+        void append(const TokenBuffer &other)
+        {
+            offsets_.insert(offsets_.end(), other.offsets_.begin(), other.offsets_.end());
+            lengths_.insert(lengths_.end(), other.lengths_.begin(), other.lengths_.end());
+            types_.insert(types_.end(), other.types_.begin(), other.types_.end());
+        }
+
+        size_t size() const { return types_.size(); }
+        bool empty() const { return types_.empty(); }
+
+        Token::Type type(size_t i) const { return types_[i]; }
+        size_t offset(size_t i) const { return offsets_[i]; }
+        std::string_view value(size_t i) const { return source_.substr(offsets_[i], lengths_[i]); }
+        size_t line(size_t i) const { return LineOf(offsets_[i]); }
+
+        Token operator[](size_t i) const { return Token{types_[i], value(i)}; }
+
+        size_t LineOf(size_t offset) const { return lines_.LineOf(offset); }
+
+        // Raw columns, used by the parser's cursor
+        const uint32_t *offsets() const { return offsets_.data(); }
+        const uint16_t *lengths() const { return lengths_.data(); }
+        const Token::Type *types() const { return types_.data(); }
+
+        // Bytes used by the token columns (excluding spare capacity)
+        size_t memory_usage() const
+        {
+            return size() * (sizeof(uint32_t) + sizeof(uint16_t) + sizeof(Token::Type));
+        }
+
+    private:
+        std::string_view source_;
+        std::vector<uint32_t> offsets_;
+        std::vector<uint16_t> lengths_;
+        std::vector<Token::Type> types_;
+
+        LineTable lines_;
+    };
+
+} // namespace cforge
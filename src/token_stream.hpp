@@ -0,0 +1,223 @@
+#pragma once
+
+#include "error.hpp"
+#include "token.hpp"
+
+// std
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+namespace cforge
+{
+    /**
+     * @brief Lock-free single-producer / single-consumer ring of `Capacity` slots.
+     * Slots are filled and drained in place, so no element is ever copied:
+     * the producer acquires a free slot, fills it and commits it, the consumer
+     * acquires the oldest committed slot, reads it and releases it.
+     */
+    template <typename T, size_t Capacity>
+    class SpscRing
+    {
+        static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+    public:
+        // Producer side, returns nullptr while the ring is full
+        T *TryAcquireWrite()
+        {
+            size_t tail = tail_.load(std::memory_order_relaxed);
+            if (tail - head_.load(std::memory_order_acquire) == Capacity)
+            {
+                return nullptr;
+            }
+            return &slots_[tail & (Capacity - 1)];
+        }
+
+        void CommitWrite()
+        {
+            tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        // Consumer side, returns nullptr while the ring is empty
+        T *TryAcquireRead()
+        {
+            size_t head = head_.load(std::memory_order_relaxed);
+            if (head == tail_.load(std::memory_order_acquire))
+            {
+                return nullptr;
+            }
+            return &slots_[head & (Capacity - 1)];
+        }
+
+        void ReleaseRead()
+        {
+            head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+    private:
+        std::array<T, Capacity> slots_;
+
+        // Separate cache lines so producer and consumer don't false-share
+        alignas(64) std::atomic<size_t> head_{0};
+        alignas(64) std::atomic<size_t> tail_{0};
+    };
+
+    /**
+     * @brief Bounded channel of token batches between a lexer thread and the parser.
+     * Batches use the same packed layout as `TokenBuffer`, memory use is fixed
+     * at `kSlots * Batch::kCapacity` tokens regardless of the size of the source.
+     * A side that has to wait yields for `kSpinLimit` rounds, then sleeps until
+     * the other side publishes, releases, closes or cancels.
+     */
+    class TokenStream
+    {
+    public:
+        struct Batch
+        {
+            static constexpr size_t kCapacity = 4096;
+
+            std::array<uint32_t, kCapacity> offsets;
+            std::array<uint16_t, kCapacity> lengths;
+            std::array<Token::Type, kCapacity> types;
+            size_t count = 0;
+        };
+
+        static constexpr size_t kSlots = 8;
+        static constexpr int kSpinLimit = 64;
+
+        // Source the token offsets refer to, set by the producer before publishing
+        void set_source(std::string_view source) { source_ = source; }
+        std::string_view source() const { return source_; }
+
+        ///////////////////////////////////////////////////////////////////////
+        /// Producer
+        ///////////////////////////////////////////////////////////////////////
+
+        /**
+         * Blocks until a batch slot is free.
+         * @throws Error if the consumer cancelled the stream.
+         */
+        Batch &AcquireWriteBatch()
+        {
+            Batch *batch = nullptr;
+            Await([&]
+                  { return (batch = ring_.TryAcquireWrite()) != nullptr || cancelled(); });
+            if (batch == nullptr)
+            {
+                throw Error("Token stream cancelled by the consumer");
+            }
+            batch->count = 0;
+            return *batch;
+        }
+
+        void PublishBatch()
+        {
+            ring_.CommitWrite();
+            Notify();
+        }
+
+        // Marks the end of the stream, optionally carrying the producer's failure
+        void Close(std::exception_ptr error = nullptr)
+        {
+            error_ = error;
+            closed_.store(true, std::memory_order_release);
+            Notify();
+        }
+
+        bool cancelled() const { return cancelled_.load(std::memory_order_acquire); }
+
+        ///////////////////////////////////////////////////////////////////////
+        /// Consumer
+        ///////////////////////////////////////////////////////////////////////
+
+        /**
+         * Blocks until the next batch is available.
+         * @return The batch, or nullptr once the stream is closed and drained.
+         * @throws Whatever the producer failed with.
+         */
+        const Batch *AcquireReadBatch()
+        {
+            const Batch *batch = nullptr;
+            Await([&]
+                  { return (batch = ring_.TryAcquireRead()) != nullptr || closed_.load(std::memory_order_acquire); });
+            if (batch != nullptr)
+            {
+                return batch;
+            }
+
+            // Batches published before Close() are visible now
+            if ((batch = ring_.TryAcquireRead()) != nullptr)
+            {
+                return batch;
+            }
+            if (error_)
+            {
+                std::rethrow_exception(error_);
+            }
+            return nullptr;
+        }
+
+        void ReleaseReadBatch()
+        {
+            ring_.ReleaseRead();
+            Notify();
+        }
+
+        // Tells the producer to stop, e.g. after a parse error
+        void Cancel()
+        {
+            cancelled_.store(true, std::memory_order_release);
+            Notify();
+        }
+
+    private:
+        // Returns once `ready` holds, spinning briefly before going to sleep
+        template <typename Ready>
+        void Await(Ready &&ready)
+        {
+            for (int spin = 0; spin < kSpinLimit; ++spin)
+            {
+                if (ready())
+                {
+                    return;
+                }
+                std::this_thread::yield();
+            }
+
+            std::unique_lock<std::mutex> lock(mutex_);
+            waiters_.fetch_add(1, std::memory_order_relaxed);
+            // Pairs with the fence in Notify: either it sees the waiter or `ready` sees its change
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            wake_.wait(lock, ready);
+            waiters_.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        // Wakes the other side if it went to sleep, the uncontended path takes no lock
+        void Notify()
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (waiters_.load(std::memory_order_relaxed) > 0)
+            {
+                // Taking the lock orders the wakeup after the waiter's last check of `ready`
+                std::lock_guard<std::mutex> lock(mutex_);
+                wake_.notify_all();
+            }
+        }
+
+        SpscRing<Batch, kSlots> ring_;
+        std::string_view source_;
+
+        std::atomic<bool> closed_{false};
+        std::atomic<bool> cancelled_{false};
+        std::exception_ptr error_;
+
+        std::mutex mutex_;
+        std::condition_variable wake_;
+        std::atomic<int> waiters_{0};
+    };
+
+} // namespace cforge
@@ -1,6 +1,12 @@
 #pragma once
 
+#include "error.hpp"
+#include "string_interner.hpp"
+
 // std
+#include <algorithm>
+#include <cstdint>
+#include <limits>
 #include <string>
 #include <vector>
 #include <string_view>
@@ -9,46 +15,184 @@
 namespace cforge
 {
 
+	/**
+	 * @brief Dense identifier of a section within one IR, see `IR::section_names`.
+	 */
+	using SectionId = uint32_t;
+
+	constexpr SectionId kInvalidSection = std::numeric_limits<SectionId>::max();
+
 	/**
 	 * @brief Represents a "unlocalized" offset by storing both section in-section-offset.
 	 * @note Primarily used for linking and relocation purposes.
 	 */
 	struct UnLocalizedOffset
 	{
-		std::string section; // Section name
-		size_t offset;		 // Offset in the section
-		UnLocalizedOffset(std::string sec, size_t off)
+		SectionId section = kInvalidSection; // Section of the owning IR
+		size_t offset = 0;					 // Offset in the section
+		UnLocalizedOffset(SectionId sec, size_t off)
 			: section(sec), offset(off) {}
 		UnLocalizedOffset() = default;
 	};
 
 	/**
-	 * @brief Represents a relocation entry for linking.
+	 * @brief Unpacked view of one relocation.
 	 * This entry contains information about how to resolve a symbol
 	 * @param type The type of relocation (e.g., R_RISC_V_HI20, R_RISC_V_LO12_I, etc.)
-	 * @param section The section name where the relocation is applied
-	 * @param instruction_id The ID of the instruction that requires relocation
-	 * @param symbol The symbol to resolve
+	 * @param section The section the relocation is applied to
+	 * @param instruction_id Index of the 4-byte word to patch within the section
+	 * @param symbol ID of the symbol to resolve, see `IR::symbol_names`
 	 */
 	struct RelocationEntry
 	{
-		enum class Type
+		enum class Type : uint8_t
 		{
 			R_RISC_V_HI20,	 // High 20-bit for "lui", "auipc"
 			R_RISC_V_LO12_I, // Low 12-bit for "addi"
 			R_RISC_V_LO12_S, // Low 12-bit for "sw", "sh", "sb"
 			R_RISC_V_JAL,	 // JAL label relocation
+			R_RISC_V_BRANCH, // Conditional branch label relocation
 		} type;
 
-		std::string section; // Section name
+		SectionId section;
 		size_t instruction_id;
 
-		std::string symbol; // Symbol to resolve
+		SymbolId symbol; // Symbol to resolve
+	};
+
+	/**
+	 * @brief Packed structure-of-arrays relocation storage.
+	 * Each relocation costs 13 bytes: an 8-bit type and 32-bit section, word
+	 * and symbol indices. `Sort` orders them by section and word, so the
+	 * linker patches every section front to back.
+	 */
+	class RelocationTable
+	{
+	public:
+		static constexpr size_t kMaxWord = std::numeric_limits<uint32_t>::max();
+
+		void push_back(const RelocationEntry &entry)
+		{
+			if (entry.instruction_id > kMaxWord)
+			{
+				throw Error("Relocation beyond the 16 GiB limit of the relocation format");
+			}
+			types_.push_back(entry.type);
+			sections_.push_back(entry.section);
+			words_.push_back(static_cast<uint32_t>(entry.instruction_id));
+			symbols_.push_back(entry.symbol);
+		}
+
+		void reserve(size_t count)
+		{
+			types_.reserve(count);
+			sections_.reserve(count);
+			words_.reserve(count);
+			symbols_.reserve(count);
+		}
+
+		// Drops every relocation from `count` on
+		void resize(size_t count)
+		{
+			types_.resize(count);
+			sections_.resize(count);
+			words_.resize(count);
+			symbols_.resize(count);
+		}
+
+		void clear() { resize(0); }
+
+		size_t size() const { return types_.size(); }
+		bool empty() const { return types_.empty(); }
+
+		RelocationEntry::Type type(size_t i) const { return types_[i]; }
+		SectionId section(size_t i) const { return sections_[i]; }
+		size_t instruction_id(size_t i) const { return words_[i]; }
+		SymbolId symbol(size_t i) const { return symbols_[i]; }
+		void set_symbol(size_t i, SymbolId symbol) { symbols_[i] = symbol; }
+
+		RelocationEntry operator[](size_t i) const { return {types_[i], sections_[i], words_[i], symbols_[i]}; }
+
+		// Orders by section, then word, keeping the order of relocations on the same word
+		void Sort()
+		{
+			auto less = [this](size_t a, size_t b)
+			{
+				return sections_[a] != sections_[b] ? sections_[a] < sections_[b] : words_[a] < words_[b];
+			};
+
+			// The assembler emits them in order already, only merged input needs sorting
+			bool in_order = true;
+			for (size_t i = 1; i < size() && in_order; ++i)
+			{
+				in_order = !less(i, i - 1);
+			}
+			if (in_order)
+			{
+				return;
+			}
+
+			std::vector<size_t> order(size());
+			for (size_t i = 0; i < order.size(); ++i)
+			{
+				order[i] = i;
+			}
+			std::stable_sort(order.begin(), order.end(), less);
+
+			RelocationTable sorted;
+			sorted.reserve(size());
+			for (size_t i : order)
+			{
+				sorted.push_back((*this)[i]);
+			}
+			*this = std::move(sorted);
+		}
+
+		// Bytes used by the relocation columns (excluding spare capacity)
+		size_t memory_usage() const
+		{
+			return size() * (sizeof(RelocationEntry::Type) + sizeof(SectionId) + sizeof(uint32_t) + sizeof(SymbolId));
+		}
+
+		bool operator==(const RelocationTable &other) const
+		{
+			return types_ == other.types_ && sections_ == other.sections_ &&
+				   words_ == other.words_ && symbols_ == other.symbols_;
+		}
+
+	private:
+		std::vector<RelocationEntry::Type> types_;
+		std::vector<SectionId> sections_;
+		std::vector<uint32_t> words_;
+		std::vector<SymbolId> symbols_;
+	};
+
+	/**
+	 * @brief Symbol table entry, indexed by `SymbolId`.
+	 * Referenced symbols get an entry too, with `defined` left false.
+	 */
+	struct SymbolEntry
+	{
+		UnLocalizedOffset location; // Only meaningful if `defined`
+		bool defined = false;
+		bool global = false; // Declared with .globl
+	};
+
+	/**
+	 * @brief Size and contents of one section, indexed by `SectionId`.
+	 */
+	struct Section
+	{
+		size_t size = 0;
+		std::vector<uint8_t> data; // "Compiled" data, at most `size` bytes
+
+		bool operator==(const Section &other) const { return size == other.size && data == other.data; }
 	};
 
 	/**
 	 * @brief Represents the Intermediate Representation (IR) of the program.
 	 * This structure contains all the necessary information for linking and final code generation.
+	 * Sections and symbols are referred to by dense IDs into their name tables.
 	 */
 	struct IR
 	{
@@ -58,23 +202,40 @@ namespace cforge
 		std::string version;
 
 		/**
-		 * Sections in the IR
+		 * Names of every section in the IR, indexed by `SectionId`.
 		 */
-		std::unordered_map<std::string, size_t> section_size_map;
+		StringInterner section_names;
 
 		/**
-		 * Data in each section in the IR
+		 * Sections in the IR, indexed by `SectionId`
 		 */
-		std::unordered_map<std::string, std::vector<uint8_t>> section_data;
+		std::vector<Section> sections;
 
 		/**
-		 * Symbol map for linking.
+		 * Names of every symbol defined or referenced in the IR.
 		 */
-		std::unordered_map<std::string, UnLocalizedOffset> symbol_map;
+		StringInterner symbol_names;
+
 		/**
-		 * Relocation entries for linking
+		 * Symbol table for linking, indexed by `SymbolId`.
 		 */
-		std::vector<RelocationEntry> relocations;
+		std::vector<SymbolEntry> symbol_table;
+
+		/**
+		 * Relocation entries for linking, sorted by section and word
+		 */
+		RelocationTable relocations;
+
+		// ID of section `name`, adding an empty section if it is new
+		SectionId SectionNamed(std::string_view name)
+		{
+			SectionId id = section_names.Intern(name);
+			if (id >= sections.size())
+			{
+				sections.resize(section_names.size());
+			}
+			return id;
+		}
 	};
 
 } // cforge
@@ -0,0 +1,14 @@
+#pragma once
+
+// std
+#include <string_view>
+
+namespace cforge
+{
+    /**
+     * Version of the assembler. Bump it whenever the same source may assemble
+     * to a different IR, cached modules of other versions are then ignored.
+     */
+    inline constexpr std::string_view kAssemblerVersion = "0.2.0";
+
+} // namespace cforge
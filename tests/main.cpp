@@ -0,0 +1,369 @@
+#include "assembler.hpp"
+#include "include_cache.hpp"
+#include "ir_archive.hpp"
+#include "ir_parser.hpp"
+#include "ir_serializer.hpp"
+#include "linker.hpp"
+
+// std
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+using namespace cforge;
+
+namespace
+{
+    struct Case
+    {
+        const char *name;
+        std::string source;
+        std::vector<uint8_t> expected;
+    };
+
+    // A check that throws on failure, given a scratch directory of its own
+    struct Check
+    {
+        const char *name;
+        void (*run)(const std::filesystem::path &directory);
+    };
+
+    void Expect(bool condition, const std::string &message)
+    {
+        if (!condition)
+        {
+            throw std::runtime_error(message);
+        }
+    }
+
+    // Lexes with `mode` and parses `source` as one module
+    IR AssembleModule(const std::string &source, Lexer::ScanMode mode = Lexer::ScanMode::VECTORIZED)
+    {
+        Lexer lexer;
+        lexer.set_verbose(false);
+        lexer.set_scan_mode(mode);
+        lexer.set_source(source);
+        lexer.Analyze();
+
+        Parser parser;
+        parser.set_verbose(false);
+        return parser.Parse(lexer.get_tokens());
+    }
+
+    std::vector<uint8_t> LinkModules(const std::vector<const IR *> &modules)
+    {
+        Linker linker;
+        linker.set_verbose(false);
+        return linker.Link(modules);
+    }
+
+    // Lexes with `mode`, parses and links `source` as a single module
+    std::vector<uint8_t> Assemble(const std::string &source, Lexer::ScanMode mode)
+    {
+        IR module = AssembleModule(source, mode);
+        return LinkModules({&module});
+    }
+
+    std::string Hex(const std::vector<uint8_t> &bytes)
+    {
+        static const char digits[] = "0123456789abcdef";
+        std::string out;
+        for (uint8_t byte : bytes)
+        {
+            out += digits[byte >> 4];
+            out += digits[byte & 0xf];
+            out += ' ';
+        }
+        return out;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// IR files
+    ///////////////////////////////////////////////////////////////////////////
+
+    // Relocations of every kind, an undefined global and a data symbol
+    const char *const kCaller =
+        ".section .text\n"
+        ".globl main\n"
+        ".globl ext\n"
+        "main:\n"
+        "    jal ra, ext\n"
+        "    la a0, value\n"
+        "    beq a0, a1, main\n"
+        "    jalr x0, 0(ra)\n"
+        ".section .data\n"
+        "value:\n"
+        "    .word 0x12345678\n";
+
+    const char *const kCallee =
+        ".section .text\n"
+        ".globl ext\n"
+        "ext:\n"
+        "    addi a0, a0, 1\n";
+
+    // Writes the caller with `write`, reads it back and links both versions against the callee
+    void CheckRoundTrip(const std::filesystem::path &path, void (*write)(const IR &, const std::filesystem::path &))
+    {
+        IR caller = AssembleModule(kCaller);
+        IR callee = AssembleModule(kCallee);
+        write(caller, path);
+
+        IrParser parser;
+        IR read = parser.ParseFile(path);
+        Expect(IrSerializer::Serialize(read) == IrSerializer::Serialize(caller),
+               "module changed in the round trip through " + path.filename().string());
+        Expect(LinkModules({&read, &callee}) == LinkModules({&caller, &callee}),
+               "linked image changed in the round trip through " + path.filename().string());
+    }
+
+    void CheckCirRoundTrip(const std::filesystem::path &directory)
+    {
+        CheckRoundTrip(directory / "caller.cir", IrParser::WriteToFile);
+    }
+
+    void CheckJsonRoundTrip(const std::filesystem::path &directory)
+    {
+        CheckRoundTrip(directory / "caller.json", IrParser::WriteJsonFile);
+    }
+
+    void CheckMalformedJson(const std::filesystem::path &)
+    {
+        const char *const inputs[] = {
+            R"({"version": "1.1", "sections": [{"name": ".text", "size": 4)",
+            R"({"sections": [{"name": ".data", "size": 1, "data": [256]}]})",
+        };
+        for (const char *input : inputs)
+        {
+            bool thrown = false;
+            try
+            {
+                IrParser().Parse(input);
+            }
+            catch (const Error &)
+            {
+                thrown = true;
+            }
+            Expect(thrown, std::string("no Error for malformed JSON: ") + input);
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// Archives
+    ///////////////////////////////////////////////////////////////////////////
+
+    // Only members that resolve an undefined symbol are linked in
+    void CheckArchiveMembers(const std::filesystem::path &directory)
+    {
+        IR used = AssembleModule(".section .text\n.globl used\nused:\n    addi a0, a0, 1\n");
+        IR unused = AssembleModule(".section .text\n.globl unused\nunused:\n    addi a0, a0, 2\n");
+        IR main = AssembleModule(".section .text\n.globl used\nmain:\n    jal ra, used\n");
+
+        const std::filesystem::path path = directory / "lib.cfa";
+        IrArchive::WriteFile({&used, &unused}, {"used.cir", "unused.cir"}, path);
+        IrArchive archive(path);
+        Expect(archive.size() == 2, "archive should have two members");
+
+        Linker linker;
+        linker.set_verbose(false);
+        std::vector<uint8_t> image = linker.Link({&main}, {&archive});
+
+        // jal ra, used -> 0x004000ef, then used's addi a0, a0, 1 -> 0x00150513
+        const std::vector<uint8_t> expected = {0xef, 0x00, 0x40, 0x00, 0x13, 0x05, 0x15, 0x00};
+        Expect(image == expected, "got " + Hex(image) + "expected " + Hex(expected));
+        Expect(image == LinkModules({&main, &used}), "image differs from linking the used member directly");
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// Includes
+    ///////////////////////////////////////////////////////////////////////////
+
+    void WriteFile(const std::filesystem::path &path, std::string_view contents)
+    {
+        std::filesystem::create_directories(path.parent_path());
+        std::ofstream out(path, std::ios::binary);
+        out.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+        Expect(static_cast<bool>(out), "cannot write " + path.string());
+    }
+
+    // Assembles `source` as if it was read from `path`, resolving includes through `cache`
+    std::vector<uint8_t> AssembleAt(const std::filesystem::path &path, const std::string &source, IncludeCache &cache)
+    {
+        Lexer lexer;
+        lexer.set_verbose(false);
+        lexer.set_source(source);
+        lexer.Analyze();
+
+        Parser parser;
+        parser.set_verbose(false);
+        parser.set_include_cache(&cache);
+        parser.set_source_path(path.string());
+        IR module = parser.Parse(lexer.get_tokens());
+        return LinkModules({&module});
+    }
+
+    // The including file's directory wins, then the search directories in order
+    void CheckIncludeSearchOrder(const std::filesystem::path &directory)
+    {
+        WriteFile(directory / "src" / "a.inc", ".word 1\n");
+        WriteFile(directory / "first" / "a.inc", ".word 2\n");
+        WriteFile(directory / "first" / "b.inc", ".word 3\n");
+        WriteFile(directory / "second" / "b.inc", ".word 4\n");
+        WriteFile(directory / "second" / "c.inc", ".word 5\n");
+
+        IncludeCache cache({(directory / "first").string(), (directory / "second").string()});
+        std::vector<uint8_t> image = AssembleAt(directory / "src" / "main.s",
+                                                ".section .data\n.include \"a.inc\"\n.include \"b.inc\"\n.include \"c.inc\"\n",
+                                                cache);
+        const std::vector<uint8_t> expected = {1, 0, 0, 0, 3, 0, 0, 0, 5, 0, 0, 0};
+        Expect(image == expected, "got " + Hex(image) + "expected " + Hex(expected));
+    }
+
+    // A file included twice is assembled once, and parsers sharing a cache share its tokens
+    void CheckIncludeOnce(const std::filesystem::path &directory)
+    {
+        WriteFile(directory / "common.inc", ".word 0x11\n");
+        WriteFile(directory / "wrapper.inc", ".include \"common.inc\"\n.word 0x22\n");
+
+        IncludeCache cache;
+        const std::string source = ".section .data\n.include \"common.inc\"\n.include \"wrapper.inc\"\n.include \"common.inc\"\n";
+        std::vector<uint8_t> image = AssembleAt(directory / "main.s", source, cache);
+        const std::vector<uint8_t> expected = {0x11, 0, 0, 0, 0x22, 0, 0, 0};
+        Expect(image == expected, "got " + Hex(image) + "expected " + Hex(expected));
+
+        std::vector<IncludeCache::FilePtr> files[2];
+        for (auto &included : files)
+        {
+            Lexer lexer;
+            lexer.set_verbose(false);
+            lexer.set_source(source);
+            lexer.Analyze();
+
+            Parser parser;
+            parser.set_verbose(false);
+            parser.set_include_cache(&cache);
+            parser.set_source_path((directory / "main.s").string());
+            parser.Parse(lexer.get_tokens());
+            included = parser.get_included_files();
+        }
+        Expect(files[0].size() == 2 && files[1].size() == 2, "each parse should include two files");
+        Expect(files[0][0] == files[1][0] && files[0][1] == files[1][1], "parsers sharing a cache lexed an include twice");
+        Expect(cache.Get(cache.Resolve((directory / "main.s").string(), "common.inc")) == files[0][0],
+               "cache returned another copy of common.inc");
+    }
+
+    void CheckIncbinRange(const std::filesystem::path &directory)
+    {
+        WriteFile(directory / "blob.bin", std::string_view("\x00\x01\x02\x03\x04\x05\x06\x07\x08\x09", 10));
+        IncludeCache cache;
+        const std::filesystem::path path = directory / "main.s";
+
+        std::vector<uint8_t> image = AssembleAt(path,
+                                                ".section .data\n.incbin \"blob.bin\", 2, 3\n.incbin \"blob.bin\", 8\n"
+                                                ".incbin \"blob.bin\", 10\n.incbin \"blob.bin\"\n",
+                                                cache);
+        const std::vector<uint8_t> expected = {2, 3, 4, 8, 9, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+        Expect(image == expected, "got " + Hex(image) + "expected " + Hex(expected));
+
+        for (const char *range : {"11", "4, 7", "10, 1"})
+        {
+            std::string message;
+            try
+            {
+                AssembleAt(path, std::string(".section .data\n.incbin \"blob.bin\", ") + range + "\n", cache);
+            }
+            catch (const Error &e)
+            {
+                message = e.what();
+            }
+            Expect(message.find("Range is past the end of the file") != std::string::npos,
+                   std::string("no range error for .incbin offset/length ") + range);
+        }
+    }
+}
+
+int main()
+{
+    const std::vector<Case> cases = {
+        // addi x1, x0, -1 -> 0xfff00093
+        {"negative I-type immediate", ".section .text\naddi x1, x0, -1\n", {0x93, 0x00, 0xf0, 0xff}},
+        // lw a0, -4(sp) -> 0xffc12503
+        {"negative load offset", ".section .text\nlw a0, -4(sp)\n", {0x03, 0x25, 0xc1, 0xff}},
+        {"negative data word", ".section .data\n.word -5\n", {0xfb, 0xff, 0xff, 0xff}},
+        // Each copy is jal ra, tgt (offsets 0, -12, -24) and la a0, d -> lui a0, 0; addi a0, a0, 0x24
+        {".rept over relocations",
+         ".section .text\ntgt:\n.rept 3\njal ra, tgt\nla a0, d\n.endr\n.section .data\nd:\n.word 7\n",
+         {0xef, 0x00, 0x00, 0x00, 0x37, 0x05, 0x00, 0x00, 0x13, 0x05, 0x45, 0x02,
+          0xef, 0xf0, 0x5f, 0xff, 0x37, 0x05, 0x00, 0x00, 0x13, 0x05, 0x45, 0x02,
+          0xef, 0xf0, 0x9f, 0xfe, 0x37, 0x05, 0x00, 0x00, 0x13, 0x05, 0x45, 0x02,
+          0x07, 0x00, 0x00, 0x00}},
+        {".fill with a halfword value", ".section .data\n.fill 3, 2, 0x1234\n", {0x34, 0x12, 0x34, 0x12, 0x34, 0x12}},
+    };
+
+    const std::vector<Check> checks = {
+        {".cir round trip", CheckCirRoundTrip},
+        {"JSON round trip", CheckJsonRoundTrip},
+        {"malformed JSON", CheckMalformedJson},
+        {"archive links only used members", CheckArchiveMembers},
+        {"include search order", CheckIncludeSearchOrder},
+        {"include once", CheckIncludeOnce},
+        {"incbin range", CheckIncbinRange},
+    };
+
+    int failures = 0;
+    for (const Case &test : cases)
+    {
+        for (Lexer::ScanMode mode : {Lexer::ScanMode::SCALAR, Lexer::ScanMode::VECTORIZED})
+        {
+            const char *mode_name = mode == Lexer::ScanMode::SCALAR ? "scalar" : "vectorized";
+            try
+            {
+                std::vector<uint8_t> image = Assemble(test.source, mode);
+                if (image != test.expected)
+                {
+                    std::cerr << "FAIL " << test.name << " (" << mode_name << "): got " << Hex(image)
+                              << "expected " << Hex(test.expected) << "\n";
+                    ++failures;
+                }
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "FAIL " << test.name << " (" << mode_name << "): " << e.what() << "\n";
+                ++failures;
+            }
+        }
+    }
+
+    // Every check gets an empty directory for its files
+    const std::filesystem::path scratch = std::filesystem::temp_directory_path() / "cforge-tests";
+    for (size_t i = 0; i < checks.size(); ++i)
+    {
+        std::filesystem::path directory = scratch / std::to_string(i);
+        std::error_code error;
+        std::filesystem::remove_all(directory, error);
+        std::filesystem::create_directories(directory);
+        try
+        {
+            checks[i].run(directory);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "FAIL " << checks[i].name << ": " << e.what() << "\n";
+            ++failures;
+        }
+    }
+    std::error_code error;
+    std::filesystem::remove_all(scratch, error);
+
+    if (failures == 0)
+    {
+        std::cout << "All " << cases.size() + checks.size() << " cases passed\n";
+    }
+    return failures == 0 ? 0 : 1;
+}